@@ -1,14 +1,46 @@
 #include <iostream>
 #include <fstream>
 #include <string>
+#include <string_view>
+#include <charconv>
 #include <vector>
 #include <map>
+#include <deque>
+#include <unordered_map>
+#include <unordered_set>
 #include <sstream>
 #include <iomanip>
 #include <ctime>
 #include <limits>
 #include <algorithm>
-#include <cmath>
+#include <cstdio>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <atomic>
+#include <random>
+#include <functional>
+#include <array>
+#include <memory>
+#include <filesystem>
+#include <cstdint>
+#include <cstring>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <poll.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <csignal>
+#include <cerrno>
+#endif
 
 using namespace std;
 
@@ -16,27 +48,429 @@ const int MAX_LOGIN_ATTEMPTS = 3;
 const int ACCOUNT_NUMBER_LENGTH = 19;
 const int ID_CARD_LENGTH = 18;
 const int PASSWORD_LENGTH = 6;
-const double INITIAL_BALANCE = 10000.0;
+
+// 金额：以分为单位的 64 位整数，运算带溢出检查，解析和格式化不分配内存
+class Money {
+private:
+    int64_t fen;
+    
+    constexpr explicit Money(int64_t f) : fen(f) {}
+    
+public:
+    // 格式化结果的最大长度："-92233720368547758.08"
+    static const int MAX_TEXT_LENGTH = 24;
+    
+    constexpr Money() : fen(0) {}
+    
+    static constexpr Money fromFen(int64_t f) { return Money(f); }
+    static constexpr Money fromYuan(int64_t yuan) { return Money(yuan * 100); }
+    
+    constexpr int64_t toFen() const { return fen; }
+    constexpr bool isPositive() const { return fen > 0; }
+    
+    // 溢出时返回 false，result 不变
+    bool checkedAdd(Money other, Money& result) const {
+        int64_t sum;
+        if (__builtin_add_overflow(fen, other.fen, &sum)) {
+            return false;
+        }
+        result.fen = sum;
+        return true;
+    }
+    
+    bool checkedSub(Money other, Money& result) const {
+        int64_t diff;
+        if (__builtin_sub_overflow(fen, other.fen, &diff)) {
+            return false;
+        }
+        result.fen = diff;
+        return true;
+    }
+    
+    // 解析 "123"、"123.4"、"-123.45"，最多两位小数，整个字符串都必须是金额
+    static bool parse(string_view text, Money& out) {
+        const char* first = text.data();
+        const char* last = first + text.size();
+        bool negative = false;
+        if (first != last && *first == '-') {
+            negative = true;
+            first++;
+        }
+        if (first == last || *first < '0' || *first > '9') {
+            return false;
+        }
+        
+        uint64_t yuan = 0;
+        auto result = from_chars(first, last, yuan);
+        if (result.ec != errc()) {
+            return false;
+        }
+        first = result.ptr;
+        
+        uint64_t cents = 0;
+        if (first != last && *first == '.') {
+            first++;
+            int digits = 0;
+            while (first != last && digits < 2 && *first >= '0' && *first <= '9') {
+                cents = cents * 10 + (*first - '0');
+                first++;
+                digits++;
+            }
+            // 小数点后至少要有一位数字，"5." 不是合法金额
+            if (digits == 0) {
+                return false;
+            }
+            if (digits == 1) {
+                cents *= 10;
+            }
+        }
+        if (first != last) {
+            return false;
+        }
+        
+        uint64_t total;
+        if (__builtin_mul_overflow(yuan, (uint64_t)100, &total) ||
+            __builtin_add_overflow(total, cents, &total) ||
+            total > (uint64_t)INT64_MAX) {
+            return false;
+        }
+        out.fen = negative ? -(int64_t)total : (int64_t)total;
+        return true;
+    }
+    
+    // 写入 [first, last)，返回写入结束位置；空间不足时返回 nullptr
+    char* format(char* first, char* last) const {
+        if (last - first < MAX_TEXT_LENGTH) {
+            return nullptr;
+        }
+        uint64_t magnitude = fen < 0 ? 0 - (uint64_t)fen : (uint64_t)fen;
+        if (fen < 0) {
+            *first++ = '-';
+        }
+        first = to_chars(first, last, magnitude / 100).ptr;
+        *first++ = '.';
+        *first++ = (char)('0' + magnitude % 100 / 10);
+        *first++ = (char)('0' + magnitude % 10);
+        return first;
+    }
+    
+    void appendTo(string& out) const {
+        char buffer[MAX_TEXT_LENGTH];
+        out.append(buffer, format(buffer, buffer + sizeof(buffer)) - buffer);
+    }
+    
+    string toString() const {
+        string out;
+        appendTo(out);
+        return out;
+    }
+    
+    friend bool operator==(Money a, Money b) { return a.fen == b.fen; }
+    friend bool operator!=(Money a, Money b) { return a.fen != b.fen; }
+    friend bool operator<(Money a, Money b) { return a.fen < b.fen; }
+    friend bool operator>(Money a, Money b) { return a.fen > b.fen; }
+    friend bool operator<=(Money a, Money b) { return a.fen <= b.fen; }
+    friend bool operator>=(Money a, Money b) { return a.fen >= b.fen; }
+    
+    friend ostream& operator<<(ostream& out, Money money) {
+        char buffer[MAX_TEXT_LENGTH];
+        return out.write(buffer, money.format(buffer, buffer + sizeof(buffer)) - buffer);
+    }
+};
+
+const Money INITIAL_BALANCE = Money::fromYuan(10000);
 const int WITHDRAWAL_MULTIPLE = 100;
-const double DAILY_WITHDRAWAL_LIMIT = 5000.0;
-const double SINGLE_WITHDRAWAL_LIMIT = 2000.0;
+const Money DAILY_WITHDRAWAL_LIMIT = Money::fromYuan(5000);
+const Money SINGLE_WITHDRAWAL_LIMIT = Money::fromYuan(2000);
 
 const string ACCOUNTS_FILE = "accounts.dat";
 const string TRANSACTIONS_FILE = "transactions.dat";
 const string LOCKED_ACCOUNTS_FILE = "locked_accounts.dat";
+const string ACCOUNTS_JOURNAL_FILE = "accounts.journal";
+const int CHECKPOINT_INTERVAL_SECONDS = 30;
+const int DEFAULT_LOG_SYNC_INTERVAL_MS = 50;
+const string ACCOUNTS_BINARY_FILE = "accounts.bin";
+const int DEFAULT_SERVER_PORT = 9527;
+const int DEFAULT_SERVER_WORKERS = 4;
+const size_t HISTORY_RECENT_COUNT = 10;
+const size_t HISTORY_MAX_RECORDS = 1000;
+const size_t PARALLEL_PARSE_MIN_CHUNK = 1 << 20;
+const size_t ESTIMATED_ACCOUNT_LINE_BYTES = 64;
+const size_t ESTIMATED_TRANSACTION_LINE_BYTES = 60;
+const size_t PARALLEL_REPORT_MIN_RECORDS = 1 << 18;
+const size_t REPORT_TOP_ACCOUNTS = 10;
+const size_t NAME_INDEX_PENDING_MAX = 4096;
+const size_t PARALLEL_INDEX_MIN_ACCOUNTS = 1 << 18;
+const size_t DEFAULT_NAME_SEARCH_LIMIT = 20;
+const size_t LOG_QUEUE_HIGH_WATER = 1 << 20;
+const size_t EOD_BLOCK_ACCOUNTS = 1 << 16;
+const int EOD_PROGRESS_INTERVAL_MS = 1000;
+const int DEFAULT_DORMANT_DAYS = 365;
+const string DORMANT_ACCOUNTS_FILE = "dormant_accounts.dat";
+const string METRICS_FILE = "atm_metrics.prom";
+const string CASSETTES_FILE = "cassettes.dat";
+const size_t CASSETTE_COUNT = 4;
+const int NOTE_DENOMINATIONS[CASSETTE_COUNT] = {100, 50, 20, 10};
+const int DEFAULT_CASSETTE_NOTES = 2000;
+const int METRICS_SIGNAL_POLL_MS = 200;
+const size_t ACCOUNT_LOCK_STRIPES = 1024;
+const string ACCOUNTS_SHARD_MANIFEST = "accounts.shards";
+const size_t DEFAULT_ACCOUNT_SHARDS = 16;
+const size_t ACCOUNT_SHARDS_MAX = 4096;
+const int DEFAULT_REPLICATION_PORT = 9600;
+const int REPLICATION_HEARTBEAT_MS = 100;
+const int REPLICATION_RETRY_MS = 1000;
+const size_t REPLICATION_MAX_BACKLOG = 1 << 20;
+
+// 账户数据的存储方式
+enum StorageMode {
+    STORAGE_CSV,      // 每次变更重写整个 accounts.dat
+    STORAGE_JOURNAL,  // 变更追加到预写日志，定期检查点
+    STORAGE_BINARY,   // 内存映射的定长二进制文件，原地更新
+    STORAGE_MEMORY,   // 启动时读入账户，之后不写任何文件（用于性能测试）
+    STORAGE_LAZY      // 启动时只索引 accounts.dat，账户按需解析，只写回脏账户
+};
 
 struct Transaction {
     string accountNumber;
     string type;
-    double amount;
+    Money amount;
     string date;
     string time;
     string targetAccount;
     
-    Transaction() : amount(0.0) {}
+    Transaction() {}
     
-    Transaction(string acc, string t, double amt, string d, string tm, string target = "")
+    Transaction(string acc, string t, Money amt, string d, string tm, string target = "")
         : accountNumber(acc), type(t), amount(amt), date(d), time(tm), targetAccount(target) {}
+    
+    // 解析交易文件中的一行: 账号,类型,金额,日期,时间,目标账号
+    static bool fromLogLine(string_view line, Transaction& trans) {
+        string_view fields[6];
+        size_t count = 0;
+        while (count < 6) {
+            size_t comma = line.find(',');
+            fields[count++] = line.substr(0, comma);
+            if (comma == string_view::npos) break;
+            line.remove_prefix(comma + 1);
+        }
+        if (count < 5 || !Money::parse(fields[2], trans.amount)) {
+            return false;
+        }
+        trans.accountNumber = string(fields[0]);
+        trans.type = string(fields[1]);
+        trans.date = string(fields[3]);
+        trans.time = string(fields[4]);
+        trans.targetAccount = count > 5 ? string(fields[5]) : string();
+        return true;
+    }
+    
+    // 追加为交易文件中的一行（含换行符）
+    void appendLogLine(string& buffer) const {
+        buffer += accountNumber;
+        buffer += ',';
+        buffer += type;
+        buffer += ',';
+        amount.appendTo(buffer);
+        buffer += ',';
+        buffer += date;
+        buffer += ',';
+        buffer += time;
+        buffer += ',';
+        buffer += targetAccount;
+        buffer += '\n';
+    }
+};
+
+// 日期 "2026-1-5" 或 "2026-01-05" 转为可比较的整数 20260105，格式错误返回 -1
+int dateKey(string_view date) {
+    int parts[3] = {0, 0, 0};
+    size_t part = 0;
+    for (char c : date) {
+        if (c == '-') {
+            if (++part > 2) return -1;
+        } else if (c >= '0' && c <= '9') {
+            parts[part] = parts[part] * 10 + (c - '0');
+        } else {
+            return -1;
+        }
+    }
+    if (part != 2 || parts[1] < 1 || parts[1] > 12 || parts[2] < 1 || parts[2] > 31) {
+        return -1;
+    }
+    return parts[0] * 10000 + parts[1] * 100 + parts[2];
+}
+
+// 时间 "9:5:30" 或 "09:05:30" 转为当天的秒数，格式错误返回 -1
+int secondsOfDay(string_view time) {
+    int parts[3] = {0, 0, 0};
+    size_t part = 0;
+    for (char c : time) {
+        if (c == ':') {
+            if (++part > 2) return -1;
+        } else if (c >= '0' && c <= '9') {
+            parts[part] = parts[part] * 10 + (c - '0');
+        } else {
+            return -1;
+        }
+    }
+    if (part != 2 || parts[0] > 23 || parts[1] > 59 || parts[2] > 60) {
+        return -1;
+    }
+    return parts[0] * 3600 + parts[1] * 60 + parts[2];
+}
+
+// 公历日期距 1970-01-01 的天数，不经过时区换算（days_from_civil 算法）
+int64_t daysFromCivil(int year, int month, int day) {
+    year -= month <= 2;
+    int64_t era = (year >= 0 ? year : year - 399) / 400;
+    int64_t yearOfEra = year - era * 400;
+    int64_t dayOfYear = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    int64_t dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+    return era * 146097 + dayOfEra - 719468;
+}
+
+// daysFromCivil 的逆运算，返回 dateKey 形式的整数 20260105
+int civilDateKey(int64_t days) {
+    days += 719468;
+    int64_t era = (days >= 0 ? days : days - 146096) / 146097;
+    int64_t dayOfEra = days - era * 146097;
+    int64_t yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+    int64_t dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+    int64_t monthIndex = (5 * dayOfYear + 2) / 153;
+    int day = (int)(dayOfYear - (153 * monthIndex + 2) / 5 + 1);
+    int month = (int)(monthIndex < 10 ? monthIndex + 3 : monthIndex - 9);
+    int year = (int)(yearOfEra + era * 400 + (month <= 2));
+    return year * 10000 + month * 100 + day;
+}
+
+// 线程安全的 localtime：多个会话会并发生成交易记录的时间戳
+tm localTimeOf(time_t when) {
+    tm result;
+#ifdef _WIN32
+    localtime_s(&result, &when);
+#else
+    localtime_r(&when, &result);
+#endif
+    return result;
+}
+
+tm currentLocalTime() {
+    return localTimeOf(time(0));
+}
+
+// 交易记录中的日期格式，如 "2026-1-5"
+string formatDate(const tm& localTime) {
+    return to_string(localTime.tm_year + 1900) + "-" +
+           to_string(localTime.tm_mon + 1) + "-" +
+           to_string(localTime.tm_mday);
+}
+
+// 交易记录中的时间格式，如 "9:5:30"
+string formatTime(const tm& localTime) {
+    return to_string(localTime.tm_hour) + ":" +
+           to_string(localTime.tm_min) + ":" +
+           to_string(localTime.tm_sec);
+}
+
+// 当前日期字符串（与交易记录中的日期格式一致）
+string currentDateString() {
+    return formatDate(currentLocalTime());
+}
+
+// 当前时间字符串
+string currentTimeString() {
+    return formatTime(currentLocalTime());
+}
+
+// 当日取款汇总索引：账号 -> 当日累计取款额
+// 启动时扫描一次交易文件建立，之后随取款记录增量更新，跨日自动清零
+// get/add 可被多个会话并发调用；reset/build/merge 只在启动扫描时单线程调用
+class WithdrawalIndex {
+private:
+    mutex totalsMutex;
+    string indexDate;
+    unordered_map<string, Money> totals;
+    bool built;
+    
+    void rollover() {
+        string today = currentDateString();
+        if (today != indexDate) {
+            totals.clear();
+            indexDate = today;
+        }
+    }
+    
+public:
+    WithdrawalIndex() : built(false) {}
+    
+    void reset() {
+        totals.clear();
+        indexDate = currentDateString();
+        built = true;
+    }
+    
+    // 汇总一行交易记录，只处理当日的取款
+    void indexLine(string_view line) {
+        // 字段: 账号,类型,金额,日期,时间,目标账号
+        size_t p1 = line.find(',');
+        if (p1 == string_view::npos) return;
+        size_t p2 = line.find(',', p1 + 1);
+        if (p2 == string_view::npos) return;
+        if (line.substr(p1 + 1, p2 - p1 - 1) != "WITHDRAWAL") return;
+        size_t p3 = line.find(',', p2 + 1);
+        if (p3 == string_view::npos) return;
+        size_t p4 = line.find(',', p3 + 1);
+        if (p4 == string_view::npos) p4 = line.size();
+        if (line.substr(p3 + 1, p4 - p3 - 1) != indexDate) return;
+        
+        Money amount;
+        if (Money::parse(line.substr(p2 + 1, p3 - p2 - 1), amount)) {
+            Money& total = totals[string(line.substr(0, p1))];
+            total.checkedAdd(amount, total);
+        }
+    }
+    
+    // 合并另一段交易文件的汇总结果（并行扫描时使用）
+    void merge(WithdrawalIndex& other) {
+        if (totals.empty()) {
+            totals.swap(other.totals);
+            return;
+        }
+        for (const auto& item : other.totals) {
+            Money& total = totals[item.first];
+            total.checkedAdd(item.second, total);
+        }
+    }
+    
+    // 扫描交易文件，只汇总当日的取款记录
+    void build(const string& fileName) {
+        reset();
+        
+        ifstream file(fileName);
+        string line;
+        while (getline(file, line)) {
+            indexLine(line);
+        }
+    }
+    
+    bool isBuilt() const { return built; }
+    
+    Money get(const string& accountNumber) {
+        lock_guard<mutex> lock(totalsMutex);
+        rollover();
+        auto it = totals.find(accountNumber);
+        return it == totals.end() ? Money() : it->second;
+    }
+    
+    void add(const string& accountNumber, const string& date, Money amount) {
+        lock_guard<mutex> lock(totalsMutex);
+        rollover();
+        if (date == indexDate) {
+            Money& total = totals[accountNumber];
+            total.checkedAdd(amount, total);
+        }
+    }
 };
 
 class Account {
@@ -45,44 +479,44 @@ private:
     string name;
     string idCard;
     string password;
-    double balance;
+    Money balance;
     
 public:
-    Account() : balance(0.0) {}
+    Account() {}
     
-    Account(string accNum, string n, string id, string pwd, double bal = INITIAL_BALANCE)
+    Account(string accNum, string n, string id, string pwd, Money bal = INITIAL_BALANCE)
         : accountNumber(accNum), name(n), idCard(id), password(pwd), balance(bal) {}
     
     string getAccountNumber() const { return accountNumber; }
-    string getName() const { return name; }
-    string getIdCard() const { return idCard; }
+    const string& getName() const { return name; }
+    const string& getIdCard() const { return idCard; }
     string getPassword() const { return password; }
-    double getBalance() const { return balance; }
+    Money getBalance() const { return balance; }
     
     void setPassword(const string& newPwd) { password = newPwd; }
     
-    bool withdraw(double amount) {
-        if (amount <= 0 || amount > balance) {
+    bool withdraw(Money amount) {
+        if (!amount.isPositive() || amount > balance) {
             return false;
         }
-        balance -= amount;
-        return true;
+        return balance.checkedSub(amount, balance);
     }
     
-    bool deposit(double amount) {
-        if (amount <= 0) {
+    bool deposit(Money amount) {
+        if (!amount.isPositive()) {
             return false;
         }
-        balance += amount;
-        return true;
+        return balance.checkedAdd(amount, balance);
     }
     
-    bool transfer(double amount, Account& targetAccount) {
-        if (amount <= 0 || amount > balance) {
+    bool transfer(Money amount, Account& targetAccount) {
+        Money targetBalance;
+        if (!amount.isPositive() || amount > balance ||
+            !targetAccount.balance.checkedAdd(amount, targetBalance)) {
             return false;
         }
-        balance -= amount;
-        targetAccount.balance += amount;
+        balance.checkedSub(amount, balance);
+        targetAccount.balance = targetBalance;
         return true;
     }
     
@@ -95,548 +529,8803 @@ public:
         cout << "Account: " << accountNumber << endl;
         cout << "Name: " << name << endl;
         cout << "ID Card: " << idCard << endl;
-        cout << "Balance: ¥" << fixed << setprecision(2) << balance << endl;
+        cout << "Balance: ¥" << balance << endl;
     }
     
     string toFileString() const {
-        stringstream ss;
-        ss << accountNumber << "," << name << "," << idCard << "," << password << "," << fixed << setprecision(2) << balance;
-        return ss.str();
+        string line;
+        line.reserve(accountNumber.size() + name.size() + idCard.size() + password.size() + Money::MAX_TEXT_LENGTH + 4);
+        line += accountNumber;
+        line += ',';
+        line += name;
+        line += ',';
+        line += idCard;
+        line += ',';
+        line += password;
+        line += ',';
+        balance.appendTo(line);
+        return line;
     }
     
     // 从文件字符串解析
-    static Account fromFileString(const string& line) {
+    static Account fromFileString(string_view line) {
         Account account;
-        stringstream ss(line);
-        string token;
+        string_view fields[5];
+        size_t count = 0;
+        
+        // 按逗号切分：账号,姓名,身份证号,密码,余额
+        while (count < 5) {
+            size_t comma = line.find(',');
+            fields[count++] = line.substr(0, comma);
+            if (comma == string_view::npos) break;
+            line.remove_prefix(comma + 1);
+        }
         
-        // 解析账号
-        if (getline(ss, token, ',')) account.accountNumber = token;
-        if (getline(ss, token, ',')) account.name = token;
-        if (getline(ss, token, ',')) account.idCard = token;
-        if (getline(ss, token, ',')) account.password = token;
-        if (getline(ss, token, ',')) account.balance = stod(token);
+        if (count > 0) account.accountNumber = string(fields[0]);
+        if (count > 1) account.name = string(fields[1]);
+        if (count > 2) account.idCard = string(fields[2]);
+        if (count > 3) account.password = string(fields[3]);
+        if (count > 4) Money::parse(fields[4], account.balance);
         
         return account;
     }
 };
 
-class FileManager {
-public:
-    static map<string, Account> loadAccounts() {
-        map<string, Account> accounts;
-        ifstream file(ACCOUNTS_FILE);
-        
-        if (file.is_open()) {
-            string line;
-            while (getline(file, line)) {
-                Account acc = Account::fromFileString(line);
-                accounts[acc.getAccountNumber()] = acc;
+// 账户表：开放寻址哈希索引，键为 19 位账号压缩成的 uint64
+// 账户本体存放在 deque 中，插入不会移动已有元素，返回的引用长期有效
+class AccountTable {
+private:
+    static const uint64_t EMPTY_KEY = UINT64_MAX;
+    
+    struct Slot {
+        uint64_t key;
+        uint32_t index;
+    };
+    
+    deque<Account> entries;
+    vector<Slot> slots;
+    size_t mask;
+    // 不是 19 位数字的账号走普通哈希表
+    unordered_map<string, uint32_t> irregular;
+    
+    // 返回 key 所在的槽位，或应插入的空槽位
+    size_t probe(uint64_t key) const {
+        size_t pos = hashKey(key) & mask;
+        while (slots[pos].key != key && slots[pos].key != EMPTY_KEY) {
+            pos = (pos + 1) & mask;
+        }
+        return pos;
+    }
+    
+    void rehash(size_t capacity) {
+        vector<Slot> old;
+        old.swap(slots);
+        slots.assign(capacity, Slot{EMPTY_KEY, 0});
+        mask = capacity - 1;
+        for (const Slot& slot : old) {
+            if (slot.key != EMPTY_KEY) {
+                slots[probe(slot.key)] = slot;
             }
-            file.close();
         }
-        
-        return accounts;
     }
     
-    static bool saveAccounts(const map<string, Account>& accounts) {
-        ofstream file(ACCOUNTS_FILE);
-        
-        if (!file.is_open()) {
+public:
+    AccountTable() : slots(16, Slot{EMPTY_KEY, 0}), mask(15) {}
+    
+    // 压缩键的混合哈希，二级索引也用它
+    static uint64_t hashKey(uint64_t key) {
+        key ^= key >> 33;
+        key *= 0xff51afd7ed558ccdULL;
+        key ^= key >> 33;
+        key *= 0xc4ceb9fe1a85ec53ULL;
+        key ^= key >> 33;
+        return key;
+    }
+    
+    // 19 位数字账号压缩为整数，10^19 - 1 小于 2^64
+    static bool packAccountNumber(string_view accountNumber, uint64_t& key) {
+        if (accountNumber.size() != (size_t)ACCOUNT_NUMBER_LENGTH) {
             return false;
         }
-        
-        for (const auto& pair : accounts) {
-            file << pair.second.toFileString() << endl;
+        key = 0;
+        for (char c : accountNumber) {
+            if (c < '0' || c > '9') {
+                return false;
+            }
+            key = key * 10 + (c - '0');
         }
-        
-        file.close();
         return true;
     }
     
-    static void logTransaction(const Transaction& trans) {
-        ofstream file(TRANSACTIONS_FILE, ios::app);
-        
-        if (file.is_open()) {
-            file << trans.accountNumber << ","
-                 << trans.type << ","
-                 << fixed << setprecision(2) << trans.amount << ","
-                 << trans.date << ","
-                 << trans.time << ","
-                 << trans.targetAccount << endl;
-            file.close();
-        }
+    size_t size() const { return entries.size(); }
+    bool empty() const { return entries.empty(); }
+    
+    void clear() {
+        entries.clear();
+        irregular.clear();
+        slots.assign(16, Slot{EMPTY_KEY, 0});
+        mask = 15;
     }
     
-    static double getTodayWithdrawalTotal(const string& accountNumber) {
-        double total = 0.0;
-        ifstream file(TRANSACTIONS_FILE);
-        
-        if (!file.is_open()) {
-            return 0.0;
+    void reserve(size_t count) {
+        size_t capacity = slots.size();
+        while (capacity < count * 2) {
+            capacity *= 2;
         }
-        
-        // 获取当前日期
-        time_t now = time(0);
-        tm* localTime = localtime(&now);
-        string todayDate = to_string(localTime->tm_year + 1900) + "-" +
-                          to_string(localTime->tm_mon + 1) + "-" +
-                          to_string(localTime->tm_mday);
-        
-        string line;
-        while (getline(file, line)) {
-            stringstream ss(line);
-            string token;
-            vector<string> tokens;
-            
-            while (getline(ss, token, ',')) {
-                tokens.push_back(token);
-            }
-            
-            if (tokens.size() >= 5) {
-                string acc = tokens[0];
-                string type = tokens[1];
-                string date = tokens[3];
-                
-                if (acc == accountNumber && type == "WITHDRAWAL" && date == todayDate) {
-                    double amount = stod(tokens[2]);
-                    total += amount;
-                }
-            }
+        if (capacity != slots.size()) {
+            rehash(capacity);
         }
-        
-        file.close();
-        return total;
     }
     
-    static bool isAccountLocked(const string& accountNumber) {
-        ifstream file(LOCKED_ACCOUNTS_FILE);
-        
-        if (!file.is_open()) {
-            return false;
+    Account* find(string_view accountNumber) {
+        uint64_t key;
+        if (packAccountNumber(accountNumber, key)) {
+            const Slot& slot = slots[probe(key)];
+            return slot.key == EMPTY_KEY ? nullptr : &entries[slot.index];
         }
-        
-        string line;
-        while (getline(file, line)) {
-            if (line == accountNumber) {
-                file.close();
-                return true;
+        auto it = irregular.find(string(accountNumber));
+        return it == irregular.end() ? nullptr : &entries[it->second];
+    }
+    
+    const Account* find(string_view accountNumber) const {
+        return const_cast<AccountTable*>(this)->find(accountNumber);
+    }
+    
+    // 插入或覆盖同账号的账户，返回表中的账户
+    Account& upsert(Account account) {
+        uint64_t key;
+        if (!packAccountNumber(account.getAccountNumber(), key)) {
+            auto it = irregular.find(account.getAccountNumber());
+            if (it != irregular.end()) {
+                return entries[it->second] = move(account);
             }
+            irregular.emplace(account.getAccountNumber(), (uint32_t)entries.size());
+            entries.push_back(move(account));
+            return entries.back();
         }
         
-        file.close();
-        return false;
-    }
-    
-    static void lockAccount(const string& accountNumber) {
-        ofstream file(LOCKED_ACCOUNTS_FILE, ios::app);
+        size_t pos = probe(key);
+        if (slots[pos].key == key) {
+            return entries[slots[pos].index] = move(account);
+        }
         
-        if (file.is_open()) {
-            file << accountNumber << endl;
-            file.close();
+        // 负载因子保持在 1/2 以下，探测链很短
+        if ((entries.size() + 1) * 2 > slots.size()) {
+            rehash(slots.size() * 2);
+            pos = probe(key);
         }
+        slots[pos] = Slot{key, (uint32_t)entries.size()};
+        entries.push_back(move(account));
+        return entries.back();
     }
+    
+    deque<Account>::iterator begin() { return entries.begin(); }
+    deque<Account>::iterator end() { return entries.end(); }
+    deque<Account>::const_iterator begin() const { return entries.begin(); }
+    deque<Account>::const_iterator end() const { return entries.end(); }
 };
 
-class ATM {
+// ====================== 文件落盘 ======================
+// 交易日志和账户预写日志的持久化策略
+enum DurabilityPolicy {
+    DURABILITY_BATCH,     // 每批写入后 fsync
+    DURABILITY_INTERVAL,  // 每隔固定毫秒数 fsync 一次
+    DURABILITY_NONE       // 只写入操作系统缓存，不 fsync
+};
+
+// 把已写完并关闭的文件 fsync 到磁盘；ofstream 拿不到文件描述符，按文件名重新打开后 fsync
+bool syncFileByName(const string& name) {
+#ifndef _WIN32
+    int fd = ::open(name.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    bool ok = fsync(fd) == 0;
+    ::close(fd);
+    return ok;
+#else
+    return true;
+#endif
+}
+
+// fsync 文件所在的目录，使目录中的改名、新建、删除在断电后也可见
+bool syncParentDirectory(const string& name) {
+#ifndef _WIN32
+    string directory = filesystem::path(name).parent_path().string();
+    int fd = ::open(directory.empty() ? "." : directory.c_str(), O_RDONLY | O_DIRECTORY);
+    if (fd < 0) {
+        return false;
+    }
+    bool ok = fsync(fd) == 0;
+    ::close(fd);
+    return ok;
+#else
+    return true;
+#endif
+}
+
+// 用写好的临时文件替换目标文件：临时文件先落盘，再直接改名覆盖目标，最后 fsync 目录
+// rename 原子地替换已存在的目标，崩溃时磁盘上总有完整的旧文件或新文件；不能先删除目标再改名
+bool replaceFile(const string& tempFile, const string& target) {
+    if (!syncFileByName(tempFile)) {
+        return false;
+    }
+    error_code error;
+    filesystem::rename(tempFile, target, error);
+    if (error) {
+        return false;
+    }
+    syncParentDirectory(target);
+    return true;
+}
+
+// 账户变更预写日志：每次变更追加一条完整账户记录，检查点时合并进账户文件
+// 记录以 ";\n" 结尾；崩溃时写了一半的尾部记录在重放时被忽略，再次打开日志追加前先截掉，新记录不会接在残缺的行后面
+// 追加后按持久化策略（与交易日志相同）fsync：batch 每次提交都 fsync，interval 距上次超过间隔才 fsync
+class AccountJournal {
 private:
-    map<string, Account> accounts;
-    Account* currentAccount;
-    int loginAttempts;
-    bool isLoggedIn;
+    string fileName;
+    FILE* file;
+    // Bank 的追加、提交和轮换都持有 persistMutex；计数用原子变量，不持锁也能安全读取
+    atomic<size_t> pendingRecords;
+    DurabilityPolicy policy;
+    int syncIntervalMs;
+    chrono::steady_clock::time_point lastSync;
     
-public:
-    ATM() : currentAccount(nullptr), loginAttempts(0), isLoggedIn(false) {
-        // 加载账户数据
-        accounts = FileManager::loadAccounts();
-        
-        // 如果没有账户数据，创建一些示例账户
-        if (accounts.empty()) {
-            createSampleAccounts();
+    static bool syncFile(FILE* f) {
+        if (fflush(f) != 0) {
+            return false;
         }
+#ifndef _WIN32
+        return fsync(fileno(f)) == 0;
+#else
+        return true;
+#endif
     }
     
-    ~ATM() {
-        // 保存账户数据
-        FileManager::saveAccounts(accounts);
+    // 截掉文件中最后一个换行之后的内容（没写完的记录），文件不存在时什么也不做
+    static bool dropTornTail(const string& name) {
+        FILE* f = fopen(name.c_str(), "rb");
+        if (!f) {
+            return true;
+        }
+        fseek(f, 0, SEEK_END);
+        long size = ftell(f);
+        long keep = 0;
+        char buffer[4096];
+        for (long end = size; end > 0 && keep == 0;) {
+            long start = max(0L, end - (long)sizeof(buffer));
+            fseek(f, start, SEEK_SET);
+            if (fread(buffer, 1, end - start, f) != (size_t)(end - start)) {
+                fclose(f);
+                return false;
+            }
+            for (long i = end - start; i > 0; i--) {
+                if (buffer[i - 1] == '\n') {
+                    keep = start + i;
+                    break;
+                }
+            }
+            end = start;
+        }
+        fclose(f);
+        if (keep == size) {
+            return true;
+        }
+        error_code error;
+        filesystem::resize_file(name, keep, error);
+        return !error && syncFileByName(name);
     }
     
-    void createSampleAccounts() {
-        Account acc1("1234567890123456789", "Zhang San", "110101199001011234", "123456", INITIAL_BALANCE);
-        Account acc2("5002222005040623456", "Li Hua","500222200504062345","123456",999999);
-        
-        accounts[acc1.getAccountNumber()] = acc1;
-        accounts[acc2.getAccountNumber()] = acc2;
-        
-        FileManager::saveAccounts(accounts);
+public:
+    explicit AccountJournal(const string& name = ACCOUNTS_JOURNAL_FILE)
+        : fileName(name), file(nullptr), pendingRecords(0), policy(DURABILITY_BATCH),
+          syncIntervalMs(DEFAULT_LOG_SYNC_INTERVAL_MS) {}
+    
+    ~AccountJournal() {
+        close();
     }
     
-    void showWelcome() {
-        cout << "\nWelcome to ATM Simulation System" << endl;
-        cout << "Please insert your card (enter account number) or type 'exit' to quit" << endl;
+    AccountJournal(const AccountJournal&) = delete;
+    AccountJournal& operator=(const AccountJournal&) = delete;
+    
+    void setPolicy(DurabilityPolicy p, int intervalMs) {
+        policy = p;
+        syncIntervalMs = max(1, intervalMs);
     }
     
-    bool login() {
-        string accountNumber, password;
-        
-        cout << "\nPlease enter your 19-digit account number: ";
-        cin >> accountNumber;
-        
-        if (accountNumber == "exit") {
+    // 上次检查点之后追加的记录数
+    size_t pending() const { return pendingRecords; }
+    
+    string getFileName() const { return fileName; }
+    string getRotatedFileName() const { return fileName + ".old"; }
+    
+    bool open() {
+        if (!file) {
+            if (!dropTornTail(fileName)) {
+                return false;
+            }
+            file = fopen(fileName.c_str(), "a");
+            lastSync = chrono::steady_clock::now();
+        }
+        return file != nullptr;
+    }
+    
+    void close() {
+        if (file) {
+            if (policy != DURABILITY_NONE) {
+                syncFile(file);
+            }
+            fclose(file);
+            file = nullptr;
+        }
+    }
+    
+    bool append(const Account& account) {
+        if (!open()) {
             return false;
         }
-        
-        if (accounts.find(accountNumber) == accounts.end()) {
-            cout << "Account does not exist!" << endl;
+        string record = account.toFileString();
+        record += ";\n";
+        if (fwrite(record.data(), 1, record.size(), file) != record.size() || fflush(file) != 0) {
             return false;
         }
+        pendingRecords++;
+        return true;
+    }
+    
+    // 一次提交的记录追加完后调用，按策略 fsync
+    bool commit() {
+        if (!file || policy == DURABILITY_NONE) {
+            return true;
+        }
+        auto now = chrono::steady_clock::now();
+        if (policy == DURABILITY_INTERVAL && now - lastSync < chrono::milliseconds(syncIntervalMs)) {
+            return true;
+        }
+        lastSync = now;
+        return syncFile(file);
+    }
+    
+    // 开始检查点：当前日志改名为 .old，新变更写入新日志
+    // 若上次检查点未完成，.old 仍然保留，本次日志追加到其后，追加的内容落盘后才删除当前日志
+    void rotate() {
+        close();
+        ifstream current(fileName, ios::binary);
+        if (current.is_open()) {
+            ifstream previous(getRotatedFileName());
+            if (previous.is_open()) {
+                previous.close();
+                bool copied = dropTornTail(getRotatedFileName());
+                if (copied) {
+                    ofstream rotated(getRotatedFileName(), ios::app | ios::binary);
+                    rotated << current.rdbuf();
+                    rotated.close();
+                    copied = (bool)rotated;
+                }
+                current.close();
+                if (copied && syncFileByName(getRotatedFileName())) {
+                    remove(fileName.c_str());
+                    syncParentDirectory(fileName);
+                }
+            } else {
+                current.close();
+                if (rename(fileName.c_str(), getRotatedFileName().c_str()) == 0) {
+                    syncParentDirectory(fileName);
+                }
+            }
+        }
+        pendingRecords = 0;
+        open();
+    }
+    
+    // 检查点已落盘，删除已合并的日志
+    void finishCheckpoint() {
+        remove(getRotatedFileName().c_str());
+    }
+    
+    // 将日志中的记录按顺序应用到账户表
+    static size_t replay(const string& name, AccountTable& accounts) {
+        ifstream in(name);
+        if (!in.is_open()) {
+            return 0;
+        }
+        
+        size_t applied = 0;
+        string line;
+        while (getline(in, line)) {
+            if (line.empty() || line.back() != ';') {
+                break;
+            }
+            // 旧版本在残缺记录后直接追加，两条记录挤在同一行，字段数不对，跳过这一行
+            if (count(line.begin(), line.end(), ',') != 4) {
+                cerr << "Skipping malformed journal record in " << name << endl;
+                continue;
+            }
+            line.pop_back();
+            accounts.upsert(Account::fromFileString(line));
+            applied++;
+        }
+        return applied;
+    }
+};
+
+// 交易日志的文件格式
+enum LogFormat {
+    LOG_FORMAT_CSV,     // 文本，每行 账号,类型,金额,日期,时间,目标账号
+    LOG_FORMAT_BINARY   // 文件头 + 变长二进制记录，见 TransactionLogCodec
+};
+
+// 二进制交易日志的记录类型
+enum TransactionType : uint8_t {
+    TXN_WITHDRAWAL = 1,
+    TXN_DEPOSIT,
+    TXN_TRANSFER,
+    TXN_BALANCE_QUERY,
+    TXN_INTEREST,       // 日终作业：利息入账
+    TXN_FEE,            // 日终作业：扣收费用
+    TXN_TYPE_END
+};
+const char* const TRANSACTION_TYPE_NAMES[TXN_TYPE_END] = {
+    "", "WITHDRAWAL", "DEPOSIT", "TRANSFER", "BALANCE_QUERY", "INTEREST", "FEE"
+};
+
+// 日终作业产生的记账，不算客户自己的交易
+bool isSystemPosting(string_view type) {
+    return type == "INTEREST" || type == "FEE";
+}
+
+TransactionType transactionTypeOf(string_view name) {
+    for (int type = TXN_WITHDRAWAL; type < TXN_TYPE_END; type++) {
+        if (name == TRANSACTION_TYPE_NAMES[type]) {
+            return (TransactionType)type;
+        }
+    }
+    return TXN_TYPE_END;
+}
+
+// CRC-32（IEEE 802.3 多项式），按字节查表
+uint32_t crc32(const void* data, size_t length, uint32_t crc = 0) {
+    static const auto table = [] {
+        array<uint32_t, 256> entries;
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t value = i;
+            for (int bit = 0; bit < 8; bit++) {
+                value = (value >> 1) ^ (value & 1 ? 0xEDB88320u : 0);
+            }
+            entries[i] = value;
+        }
+        return entries;
+    }();
+    
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    crc = ~crc;
+    for (size_t i = 0; i < length; i++) {
+        crc = table[(crc ^ bytes[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+const string TRANSACTIONS_BINARY_FILE = "transactions.bin";
+const char TRANSACTION_LOG_MAGIC[8] = {'A', 'T', 'M', 'T', 'X', 'L', 'G', '1'};
+const uint32_t TRANSACTION_LOG_VERSION = 1;
+
+struct TransactionLogHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+};
+
+static_assert(sizeof(TransactionLogHeader) == 16, "unexpected log header layout");
+
+// 解码后的一条二进制记录；账号为 19 位数字时压缩成 uint64，否则以文本保存
+struct TransactionLogEntry {
+    TransactionType type;
+    uint32_t timestamp;
+    int64_t amountFen;
+    uint64_t account;
+    uint64_t target;
+    bool hasTarget;
+    bool textAccounts;
+    string_view accountText;
+    string_view targetText;
+    
+    static string unpackAccount(uint64_t key) {
+        string text(ACCOUNT_NUMBER_LENGTH, '0');
+        for (int i = ACCOUNT_NUMBER_LENGTH - 1; i >= 0 && key > 0; i--) {
+            text[i] = char('0' + key % 10);
+            key /= 10;
+        }
+        return text;
+    }
+    
+    string accountNumber() const {
+        return textAccounts ? string(accountText) : unpackAccount(account);
+    }
+    
+    string targetAccount() const {
+        if (!hasTarget) {
+            return string();
+        }
+        return textAccounts ? string(targetText) : unpackAccount(target);
+    }
+    
+    void toTransaction(Transaction& trans) const {
+        tm localTime = localTimeOf((time_t)timestamp);
+        trans.accountNumber = accountNumber();
+        trans.type = TRANSACTION_TYPE_NAMES[type];
+        trans.amount = Money::fromFen(amountFen);
+        trans.date = formatDate(localTime);
+        trans.time = formatTime(localTime);
+        trans.targetAccount = targetAccount();
+    }
+};
+
+// 二进制交易记录的编解码，整数按本机字节序（小端）存放：
+//   u32 crc        其后全部字节的 CRC-32
+//   u8  type       TransactionType
+//   u8  flags      FLAG_AMOUNT / FLAG_TARGET / FLAG_TEXT_ACCOUNTS
+//   u32 timestamp  本地日期时间对应的 Unix 秒
+//   账号           u64 压缩账号；FLAG_TEXT_ACCOUNTS 时为 u8 长度 + 文本
+//   [i64 金额（分）]  FLAG_AMOUNT
+//   [目标账号]        FLAG_TARGET，编码同账号
+// 余额查询 18 字节，取款、存款 26 字节，转账 34 字节
+class TransactionLogCodec {
+public:
+    static const uint8_t FLAG_AMOUNT = 1;
+    static const uint8_t FLAG_TARGET = 2;
+    static const uint8_t FLAG_TEXT_ACCOUNTS = 4;
+    static const size_t FIXED_SIZE = 10;
+    
+private:
+    // 最近一次日期时间到 Unix 秒的换算，同一秒内的记录不再调用 mktime
+    struct TimestampCache {
+        string date;
+        string time;
+        uint32_t timestamp = 0;
+    };
+    
+    template <typename T>
+    static void put(string& buffer, T value) {
+        buffer.append(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+    
+    template <typename T>
+    static T get(const char* data) {
+        T value;
+        memcpy(&value, data, sizeof(value));
+        return value;
+    }
+    
+    static void putAccount(string& buffer, const string& accountNumber, bool text) {
+        if (text) {
+            buffer += (char)accountNumber.size();
+            buffer += accountNumber;
+        } else {
+            uint64_t key = 0;
+            AccountTable::packAccountNumber(accountNumber, key);
+            put(buffer, key);
+        }
+    }
+    
+    // 读一个账号字段，越界返回 false
+    static bool getAccount(string_view record, size_t& pos, bool text, uint64_t& key, string_view& accountText) {
+        if (text) {
+            if (pos >= record.size() || pos + 1 + (unsigned char)record[pos] > record.size()) {
+                return false;
+            }
+            size_t length = (unsigned char)record[pos];
+            accountText = record.substr(pos + 1, length);
+            pos += 1 + length;
+            return true;
+        }
+        if (pos + sizeof(uint64_t) > record.size()) {
+            return false;
+        }
+        key = get<uint64_t>(record.data() + pos);
+        pos += sizeof(uint64_t);
+        return true;
+    }
+    
+public:
+    // 本地日期 "2026-1-5" 和时间 "9:5:30" 转为 Unix 秒，格式错误返回 false
+    static bool toTimestamp(const string& date, const string& time, uint32_t& timestamp) {
+        static thread_local TimestampCache cache;
+        if (date == cache.date && time == cache.time) {
+            timestamp = cache.timestamp;
+            return true;
+        }
+        
+        tm localTime = {};
+        if (sscanf(date.c_str(), "%d-%d-%d", &localTime.tm_year, &localTime.tm_mon, &localTime.tm_mday) != 3 ||
+            sscanf(time.c_str(), "%d:%d:%d", &localTime.tm_hour, &localTime.tm_min, &localTime.tm_sec) != 3) {
+            return false;
+        }
+        localTime.tm_year -= 1900;
+        localTime.tm_mon -= 1;
+        localTime.tm_isdst = -1;
+        time_t seconds = mktime(&localTime);
+        if (seconds < 0 || (uint64_t)seconds > UINT32_MAX) {
+            return false;
+        }
+        cache.date = date;
+        cache.time = time;
+        cache.timestamp = timestamp = (uint32_t)seconds;
+        return true;
+    }
+    
+    static void appendHeader(string& buffer) {
+        TransactionLogHeader header = {};
+        memcpy(header.magic, TRANSACTION_LOG_MAGIC, sizeof(header.magic));
+        header.version = TRANSACTION_LOG_VERSION;
+        buffer.append(reinterpret_cast<const char*>(&header), sizeof(header));
+    }
+    
+    static bool checkHeader(string_view data) {
+        if (data.size() < sizeof(TransactionLogHeader)) {
+            return false;
+        }
+        TransactionLogHeader header;
+        memcpy(&header, data.data(), sizeof(header));
+        return memcmp(header.magic, TRANSACTION_LOG_MAGIC, sizeof(header.magic)) == 0 &&
+               header.version == TRANSACTION_LOG_VERSION;
+    }
+    
+    // 追加一条记录，类型未知或日期时间无法解析时返回 false 且不写入
+    static bool encode(string& buffer, const Transaction& trans) {
+        TransactionType type = transactionTypeOf(trans.type);
+        uint32_t timestamp;
+        if (type == TXN_TYPE_END || !toTimestamp(trans.date, trans.time, timestamp)) {
+            return false;
+        }
+        
+        uint64_t key;
+        bool hasTarget = !trans.targetAccount.empty();
+        bool text = !AccountTable::packAccountNumber(trans.accountNumber, key) ||
+                    (hasTarget && !AccountTable::packAccountNumber(trans.targetAccount, key));
+        if (text && (trans.accountNumber.size() > UINT8_MAX || trans.targetAccount.size() > UINT8_MAX)) {
+            return false;
+        }
+        uint8_t flags = (trans.amount.toFen() != 0 ? FLAG_AMOUNT : 0) | (hasTarget ? FLAG_TARGET : 0) |
+                        (text ? FLAG_TEXT_ACCOUNTS : 0);
+        
+        size_t start = buffer.size();
+        put<uint32_t>(buffer, 0);
+        put<uint8_t>(buffer, type);
+        put<uint8_t>(buffer, flags);
+        put<uint32_t>(buffer, timestamp);
+        putAccount(buffer, trans.accountNumber, text);
+        if (flags & FLAG_AMOUNT) {
+            put<int64_t>(buffer, trans.amount.toFen());
+        }
+        if (hasTarget) {
+            putAccount(buffer, trans.targetAccount, text);
+        }
+        
+        uint32_t crc = crc32(buffer.data() + start + 4, buffer.size() - start - 4);
+        memcpy(&buffer[start], &crc, sizeof(crc));
+        return true;
+    }
+    
+    // 只按标志位算出 data 开头那条记录的长度，不校验 CRC；不完整返回 0
+    // 用于并行解码前快速找到记录边界
+    static size_t recordLength(string_view data) {
+        if (data.size() < FIXED_SIZE) {
+            return 0;
+        }
+        uint8_t flags = get<uint8_t>(data.data() + 5);
+        size_t accounts = (flags & FLAG_TARGET) ? 2 : 1;
+        size_t pos = FIXED_SIZE;
+        if (!(flags & FLAG_TEXT_ACCOUNTS)) {
+            pos += accounts * sizeof(uint64_t);
+        } else {
+            for (size_t i = 0; i < accounts; i++) {
+                // 第二个账号排在金额之后
+                size_t at = pos + (i == 1 && (flags & FLAG_AMOUNT) ? sizeof(int64_t) : 0);
+                if (at >= data.size()) {
+                    return 0;
+                }
+                pos += 1 + (unsigned char)data[at];
+            }
+        }
+        if (flags & FLAG_AMOUNT) {
+            pos += sizeof(int64_t);
+        }
+        return pos <= data.size() ? pos : 0;
+    }
+    
+    // 解码 data 开头的一条记录，返回记录长度；不完整或校验失败返回 0
+    static size_t decode(string_view data, TransactionLogEntry& entry) {
+        if (data.size() < FIXED_SIZE) {
+            return 0;
+        }
+        uint8_t type = get<uint8_t>(data.data() + 4);
+        uint8_t flags = get<uint8_t>(data.data() + 5);
+        if (type < TXN_WITHDRAWAL || type >= TXN_TYPE_END) {
+            return 0;
+        }
+        
+        entry.type = (TransactionType)type;
+        entry.timestamp = get<uint32_t>(data.data() + 6);
+        entry.textAccounts = (flags & FLAG_TEXT_ACCOUNTS) != 0;
+        entry.hasTarget = (flags & FLAG_TARGET) != 0;
+        entry.amountFen = 0;
+        entry.account = entry.target = 0;
+        entry.accountText = entry.targetText = string_view();
+        
+        size_t pos = FIXED_SIZE;
+        if (!getAccount(data, pos, entry.textAccounts, entry.account, entry.accountText)) {
+            return 0;
+        }
+        if (flags & FLAG_AMOUNT) {
+            if (pos + sizeof(int64_t) > data.size()) {
+                return 0;
+            }
+            entry.amountFen = get<int64_t>(data.data() + pos);
+            pos += sizeof(int64_t);
+        }
+        if (entry.hasTarget && !getAccount(data, pos, entry.textAccounts, entry.target, entry.targetText)) {
+            return 0;
+        }
+        
+        if (crc32(data.data() + 4, pos - 4) != get<uint32_t>(data.data())) {
+            return 0;
+        }
+        return pos;
+    }
+};
+
+// 组提交交易日志：调用方只把记录放入队列，后台线程批量格式化后一次写出
+// 每条记录有递增序号，waitDurable 可等待指定记录按策略落盘
+// 打开、写入或 fsync 失败后进入失败状态：之后的记录不再写出也不再确认，waitDurable 返回 false，
+// 直到 stop 后重新启动写线程
+class TransactionLogger {
+private:
+    string fileName;
+    LogFormat format;
+    DurabilityPolicy policy;
+    int syncIntervalMs;
+    
+    mutex queueMutex;
+    condition_variable queueCv;
+    condition_variable durableCv;
+    vector<Transaction> queue;
+    uint64_t nextSeq;
+    uint64_t writtenSeq;
+    uint64_t durableSeq;
+    bool running;
+    bool stopping;
+    bool enabled;
+    bool failed;
+    thread writer;
+    // 每条记录写出后回调，参数为记录及其在文件中的偏移
+    function<void(const Transaction&, uint64_t)> writeHook;
+    
+    // 二进制格式下类型未知或日期无法解析的记录编码失败，返回 false
+    bool appendRecord(string& buffer, const Transaction& trans) const {
+        if (format == LOG_FORMAT_BINARY) {
+            if (!TransactionLogCodec::encode(buffer, trans)) {
+                cerr << "Cannot encode transaction of type " << trans.type << endl;
+                return false;
+            }
+            return true;
+        }
+        trans.appendLogLine(buffer);
+        return true;
+    }
+    
+    static bool syncFile(FILE* file) {
+        if (fflush(file) != 0) {
+            return false;
+        }
+#ifndef _WIN32
+        return fsync(fileno(file)) == 0;
+#else
+        return true;
+#endif
+    }
+    
+    void writerLoop() {
+        FILE* file = fopen(fileName.c_str(), "a");
+        vector<Transaction> batch;
+        vector<size_t> recordStarts;
+        string buffer;
+        uint64_t fileOffset = 0;
+        // 本线程的文件是否可用，失败后不再写出；queueMutex 下的 failed 供调用方读取
+        bool healthy = file != nullptr;
+        if (file) {
+            fseek(file, 0, SEEK_END);
+            fileOffset = ftell(file);
+        }
+        // 新建的二进制日志先写文件头
+        if (file && fileOffset == 0 && format == LOG_FORMAT_BINARY) {
+            TransactionLogCodec::appendHeader(buffer);
+            if (fwrite(buffer.data(), 1, buffer.size(), file) == buffer.size()) {
+                fileOffset = buffer.size();
+            } else {
+                healthy = false;
+            }
+            buffer.clear();
+        }
+        if (!healthy) {
+            cerr << "Cannot open transaction log " << fileName << ", money operations will fail" << endl;
+        }
+        auto lastSync = chrono::steady_clock::now();
+        
+        unique_lock<mutex> lock(queueMutex);
+        failed = !healthy;
+        durableCv.notify_all();
+        while (true) {
+            if (queue.empty() && !stopping) {
+                if (policy == DURABILITY_INTERVAL && durableSeq < writtenSeq) {
+                    queueCv.wait_until(lock, lastSync + chrono::milliseconds(syncIntervalMs));
+                } else {
+                    queueCv.wait(lock);
+                }
+            }
+            
+            batch.swap(queue);
+            uint64_t batchEnd = nextSeq - 1;
+            bool finished = stopping && batch.empty();
+            lock.unlock();
+            
+            if (!batch.empty()) {
+                buffer.clear();
+                recordStarts.clear();
+                bool encoded = true;
+                for (const auto& trans : batch) {
+                    recordStarts.push_back(buffer.size());
+                    if (!appendRecord(buffer, trans)) {
+                        encoded = false;
+                        break;
+                    }
+                }
+                recordStarts.push_back(buffer.size());
+                // 失败后整批丢弃：这些记录的序号不会被确认，调用方的操作返回失败
+                // 有记录无法编码时同样整批丢弃，不能让它的序号随同批记录被确认
+                if (healthy && encoded && fwrite(buffer.data(), 1, buffer.size(), file) == buffer.size() &&
+                    fflush(file) == 0) {
+                    if (writeHook) {
+                        for (size_t i = 0; i < batch.size(); i++) {
+                            writeHook(batch[i], fileOffset + recordStarts[i]);
+                        }
+                    }
+                    fileOffset += buffer.size();
+                } else if (healthy) {
+                    healthy = false;
+                    cerr << "Cannot write transaction log " << fileName << ", money operations will fail" << endl;
+                }
+                batch.clear();
+            }
+            
+            bool synced = false;
+            auto now = chrono::steady_clock::now();
+            if (healthy && (policy == DURABILITY_BATCH || finished ||
+                            (policy == DURABILITY_INTERVAL && now - lastSync >= chrono::milliseconds(syncIntervalMs)))) {
+                healthy = syncFile(file);
+                if (!healthy) {
+                    cerr << "Cannot sync transaction log " << fileName << ", money operations will fail" << endl;
+                }
+                lastSync = now;
+                synced = healthy;
+            }
+            
+            lock.lock();
+            if (healthy) {
+                writtenSeq = batchEnd;
+                if (synced || policy == DURABILITY_NONE) {
+                    durableSeq = batchEnd;
+                }
+            }
+            failed = !healthy;
+            durableCv.notify_all();
+            
+            if (finished) {
+                break;
+            }
+        }
+        lock.unlock();
+        
+        if (file) {
+            fclose(file);
+        }
+    }
+    
+public:
+    explicit TransactionLogger(const string& name = TRANSACTIONS_FILE)
+        : fileName(name), format(LOG_FORMAT_CSV), policy(DURABILITY_BATCH), syncIntervalMs(DEFAULT_LOG_SYNC_INTERVAL_MS),
+          nextSeq(1), writtenSeq(0), durableSeq(0), running(false), stopping(false), enabled(true), failed(false) {}
+    
+    ~TransactionLogger() {
+        stop();
+    }
+    
+    // 需在第一条记录写入前设置
+    void setPolicy(DurabilityPolicy p, int intervalMs = DEFAULT_LOG_SYNC_INTERVAL_MS) {
+        lock_guard<mutex> lock(queueMutex);
+        policy = p;
+        syncIntervalMs = max(1, intervalMs);
+    }
+    
+    DurabilityPolicy getPolicy(int& intervalMs) {
+        lock_guard<mutex> lock(queueMutex);
+        intervalMs = syncIntervalMs;
+        return policy;
+    }
+    
+    // 需在第一条记录写入前设置
+    void setFormat(LogFormat f, const string& name) {
+        lock_guard<mutex> lock(queueMutex);
+        format = f;
+        fileName = name;
+    }
+    
+    void setWriteHook(function<void(const Transaction&, uint64_t)> hook) {
+        lock_guard<mutex> lock(queueMutex);
+        writeHook = hook;
+    }
+    
+    // 关闭后记录直接丢弃
+    void setEnabled(bool value) {
+        lock_guard<mutex> lock(queueMutex);
+        enabled = value;
+    }
+    
+    // 放入队列并返回记录序号，日志关闭时返回 0
+    uint64_t enqueue(const Transaction& trans) {
+        lock_guard<mutex> lock(queueMutex);
+        if (!enabled) {
+            return 0;
+        }
+        if (!running) {
+            running = true;
+            stopping = false;
+            writer = thread(&TransactionLogger::writerLoop, this);
+        }
+        queue.push_back(trans);
+        queueCv.notify_one();
+        return nextSeq++;
+    }
+    
+    // 整批放入队列，返回最后一条的序号；队列积压超过 LOG_QUEUE_HIGH_WATER 条时先等写线程取走
+    // 用于日终作业这类大批量记账，内存占用不随批量增长
+    uint64_t enqueueBatch(vector<Transaction>& batch) {
+        unique_lock<mutex> lock(queueMutex);
+        if (!enabled || batch.empty()) {
+            return 0;
+        }
+        if (!running) {
+            running = true;
+            stopping = false;
+            writer = thread(&TransactionLogger::writerLoop, this);
+        }
+        durableCv.wait(lock, [&] { return queue.size() < LOG_QUEUE_HIGH_WATER || !running; });
+        size_t count = batch.size();
+        if (queue.empty()) {
+            queue.swap(batch);
+        } else {
+            queue.insert(queue.end(), make_move_iterator(batch.begin()), make_move_iterator(batch.end()));
+        }
+        batch.clear();
+        nextSeq += count;
+        queueCv.notify_one();
+        return nextSeq - 1;
+    }
+    
+    // 等待此前入队的记录全部写入文件（不要求 fsync）；日志失败时不再等待
+    void waitWritten() {
+        unique_lock<mutex> lock(queueMutex);
+        uint64_t seq = nextSeq - 1;
+        durableCv.wait(lock, [&] { return writtenSeq >= seq || failed || !running; });
+    }
+    
+    // 等待序号 seq 及之前的记录按持久化策略落盘，日志失败而未能落盘时返回 false
+    bool waitDurable(uint64_t seq) {
+        unique_lock<mutex> lock(queueMutex);
+        durableCv.wait(lock, [&] { return durableSeq >= seq || failed || !running; });
+        return durableSeq >= seq;
+    }
+    
+    // 写线程未处于失败状态；资金操作开始前检查，日志不可用时不改动余额
+    bool healthy() {
+        lock_guard<mutex> lock(queueMutex);
+        return !failed;
+    }
+    
+    // 写出所有排队记录并停止后台线程
+    void stop() {
+        {
+            lock_guard<mutex> lock(queueMutex);
+            if (!running) {
+                return;
+            }
+            stopping = true;
+            queueCv.notify_one();
+        }
+        writer.join();
+        lock_guard<mutex> lock(queueMutex);
+        running = false;
+        durableCv.notify_all();
+    }
+};
+
+// 各账户最后一次客户交易日期键的快照，取出后只读，可被多个线程同时查询而不加锁
+// 19 位数字账号压缩成整数作键，其余账号按字符串
+struct ActivitySnapshot {
+    unordered_map<uint64_t, int> packed;
+    unordered_map<string, int> irregular;
+    
+    // 没有客户交易时返回 0
+    int lastActivity(const string& accountNumber) const {
+        uint64_t key;
+        if (AccountTable::packAccountNumber(accountNumber, key)) {
+            auto it = packed.find(key);
+            return it == packed.end() ? 0 : it->second;
+        }
+        auto it = irregular.find(accountNumber);
+        return it == irregular.end() ? 0 : it->second;
+    }
+};
+
+// 账户交易历史索引：账号 -> 与该账户相关的交易在交易文件中的偏移，按写入顺序排列
+// 转账同时记入转出和转入账户；余额查询不是资金变动，不入索引
+// 启动时扫描一次交易文件，之后由日志写线程在写出记录时追加
+class TransactionHistoryIndex {
+private:
+    struct Posting {
+        uint64_t offset;
+        int32_t dateKey;
+        bool system;  // 日终作业的记账（利息、费用），判断休眠账户时不算活动
+    };
+    
+    mutable mutex indexMutex;
+    unordered_map<string, vector<Posting>> postings;
+    bool built;
+    
+    void addLocked(const string& accountNumber, uint64_t offset, int key, bool system) {
+        postings[accountNumber].push_back(Posting{offset, key, system});
+    }
+    
+    void addLocked(string_view accountNumber, uint64_t offset, int key, bool system) {
+        addLocked(string(accountNumber), offset, key, system);
+    }
+    
+    // 最后一次客户交易（不含余额查询和日终记账）的日期键，没有时返回 0
+    static int lastActivity(const vector<Posting>& list) {
+        for (size_t i = list.size(); i > 0; i--) {
+            if (!list[i - 1].system) {
+                return list[i - 1].dateKey;
+            }
+        }
+        return 0;
+    }
+    
+public:
+    TransactionHistoryIndex() : built(false) {}
+    
+    void reset() {
+        lock_guard<mutex> lock(indexMutex);
+        postings.clear();
+        built = true;
+    }
+    
+    bool isBuilt() const {
+        lock_guard<mutex> lock(indexMutex);
+        return built;
+    }
+    
+    void add(const Transaction& trans, uint64_t offset) {
+        if (trans.type == "BALANCE_QUERY") {
+            return;
+        }
+        int key = dateKey(trans.date);
+        bool system = isSystemPosting(trans.type);
+        lock_guard<mutex> lock(indexMutex);
+        if (!built) {
+            return;
+        }
+        addLocked(trans.accountNumber, offset, key, system);
+        if (!trans.targetAccount.empty()) {
+            addLocked(trans.targetAccount, offset, key, system);
+        }
+    }
+    
+    // 按已解码的账号和日期键建立索引（扫描二进制日志时使用）
+    void addPosting(const string& accountNumber, const string& targetAccount, uint64_t offset, int key, bool system) {
+        lock_guard<mutex> lock(indexMutex);
+        addLocked(accountNumber, offset, key, system);
+        if (!targetAccount.empty()) {
+            addLocked(targetAccount, offset, key, system);
+        }
+    }
+    
+    // 直接从交易文件的一行建立索引，只切出需要的字段
+    void indexLine(string_view line, uint64_t offset) {
+        string_view fields[6];
+        size_t count = 0;
+        while (count < 6) {
+            size_t comma = line.find(',');
+            fields[count++] = line.substr(0, comma);
+            if (comma == string_view::npos) break;
+            line.remove_prefix(comma + 1);
+        }
+        Money amount;
+        if (count < 5 || fields[1] == "BALANCE_QUERY" || !Money::parse(fields[2], amount)) {
+            return;
+        }
+        int key = dateKey(fields[3]);
+        bool system = isSystemPosting(fields[1]);
+        lock_guard<mutex> lock(indexMutex);
+        addLocked(fields[0], offset, key, system);
+        if (count > 5 && !fields[5].empty()) {
+            addLocked(fields[5], offset, key, system);
+        }
+    }
+    
+    // 把另一段交易文件的索引接在本索引之后（并行扫描时按段顺序调用）
+    void append(TransactionHistoryIndex& other) {
+        lock_guard<mutex> lock(indexMutex);
+        lock_guard<mutex> otherLock(other.indexMutex);
+        if (postings.empty()) {
+            postings.swap(other.postings);
+            return;
+        }
+        for (auto& item : other.postings) {
+            vector<Posting>& list = postings[item.first];
+            if (list.empty()) {
+                list.swap(item.second);
+            } else {
+                list.insert(list.end(), item.second.begin(), item.second.end());
+            }
+        }
+        other.postings.clear();
+    }
+    
+    // 一次加锁取出全部账户的最后客户交易日期，日终作业并行扫描账户时查快照，不再逐个争用 indexMutex
+    ActivitySnapshot lastActivities() const {
+        ActivitySnapshot snapshot;
+        lock_guard<mutex> lock(indexMutex);
+        snapshot.packed.reserve(postings.size());
+        for (const auto& item : postings) {
+            int key = lastActivity(item.second);
+            if (key == 0) {
+                continue;
+            }
+            uint64_t packed;
+            if (AccountTable::packAccountNumber(item.first, packed)) {
+                snapshot.packed.emplace(packed, key);
+            } else {
+                snapshot.irregular.emplace(item.first, key);
+            }
+        }
+        return snapshot;
+    }
+    
+    // 最近 n 条记录的偏移，从新到旧
+    vector<uint64_t> recent(const string& accountNumber, size_t n) const {
+        vector<uint64_t> offsets;
+        lock_guard<mutex> lock(indexMutex);
+        auto it = postings.find(accountNumber);
+        if (it == postings.end()) {
+            return offsets;
+        }
+        const vector<Posting>& list = it->second;
+        for (size_t i = list.size(); i > 0 && offsets.size() < n; i--) {
+            offsets.push_back(list[i - 1].offset);
+        }
+        return offsets;
+    }
+    
+    // 日期在 [fromKey, toKey] 内的记录偏移，从旧到新
+    // 记录按写入顺序即时间顺序排列，二分定位起点
+    vector<uint64_t> between(const string& accountNumber, int fromKey, int toKey) const {
+        vector<uint64_t> offsets;
+        lock_guard<mutex> lock(indexMutex);
+        auto it = postings.find(accountNumber);
+        if (it == postings.end()) {
+            return offsets;
+        }
+        const vector<Posting>& list = it->second;
+        auto first = lower_bound(list.begin(), list.end(), fromKey,
+                                 [](const Posting& p, int key) { return p.dateKey < key; });
+        for (; first != list.end() && first->dateKey <= toKey; ++first) {
+            offsets.push_back(first->offset);
+        }
+        return offsets;
+    }
+};
+
+// 锁定账户集合：启动时读入内存，之后的检查只查哈希表
+// 文件是追加日志，每行一个账号表示锁定，"-账号" 表示解锁；冗余记录过多时压缩重写
+class LockedAccountSet {
+private:
+    mutable mutex setMutex;
+    string fileName;
+    unordered_set<string> locked;
+    size_t logRecords;
+    bool loaded;
+    
+    void appendRecord(const string& record) {
+        ofstream file(fileName, ios::app);
+        if (file.is_open()) {
+            file << record << '\n';
+        }
+        logRecords++;
+    }
+    
+    bool needsCompaction() const {
+        return logRecords > 2 * locked.size() + 64;
+    }
+    
+public:
+    explicit LockedAccountSet(const string& name = LOCKED_ACCOUNTS_FILE)
+        : fileName(name), logRecords(0), loaded(false) {}
+    
+    void load() {
+        locked.clear();
+        logRecords = 0;
+        loaded = true;
+        
+        ifstream file(fileName);
+        string line;
+        while (getline(file, line)) {
+            if (line.empty()) continue;
+            if (line[0] == '-') {
+                locked.erase(line.substr(1));
+            } else {
+                locked.insert(line);
+            }
+            logRecords++;
+        }
+        file.close();
+        
+        if (needsCompaction()) {
+            compact();
+        }
+    }
+    
+    bool isLoaded() const { return loaded; }
+    
+    bool contains(const string& accountNumber) const {
+        lock_guard<mutex> lock(setMutex);
+        return locked.count(accountNumber) > 0;
+    }
+    
+    void lock(const string& accountNumber) {
+        lock_guard<mutex> lock(setMutex);
+        if (locked.insert(accountNumber).second) {
+            appendRecord(accountNumber);
+        }
+    }
+    
+    // 返回 false 表示该账户本来就未锁定
+    bool unlock(const string& accountNumber) {
+        lock_guard<mutex> lock(setMutex);
+        if (locked.erase(accountNumber) == 0) {
+            return false;
+        }
+        appendRecord("-" + accountNumber);
+        if (needsCompaction()) {
+            compact();
+        }
+        return true;
+    }
+    
+    // 只保留当前锁定的账户，写临时文件后替换原文件
+    bool compact() {
+        string tempFile = fileName + ".tmp";
+        ofstream file(tempFile);
+        if (!file.is_open()) {
+            return false;
+        }
+        for (const auto& accountNumber : locked) {
+            file << accountNumber << '\n';
+        }
+        file.close();
+        if (!file) {
+            return false;
+        }
+        
+        // 直接改名覆盖：任何时刻磁盘上都有完整的锁定名单，崩溃不会让已锁定的卡解锁
+        if (!replaceFile(tempFile, fileName)) {
+            return false;
+        }
+        logRecords = locked.size();
+        return true;
+    }
+};
+
+// 只读映射的文本文件，供并行解析按块切分；非 POSIX 平台整体读入内存
+class MappedTextFile {
+private:
+    const char* base;
+    size_t length;
+    bool mapped;
+    string buffer;
+    
+public:
+    MappedTextFile() : base(nullptr), length(0), mapped(false) {}
+    
+    ~MappedTextFile() {
+        close();
+    }
+    
+    MappedTextFile(const MappedTextFile&) = delete;
+    MappedTextFile& operator=(const MappedTextFile&) = delete;
+    
+    bool open(const string& fileName) {
+        close();
+#ifndef _WIN32
+        int fd = ::open(fileName.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return false;
+        }
+        struct stat st;
+        if (fstat(fd, &st) != 0) {
+            ::close(fd);
+            return false;
+        }
+        length = st.st_size;
+        if (length > 0) {
+            void* data = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (data == MAP_FAILED) {
+                ::close(fd);
+                length = 0;
+                return false;
+            }
+            madvise(data, length, MADV_SEQUENTIAL);
+            base = static_cast<const char*>(data);
+            mapped = true;
+        }
+        ::close(fd);
+        return true;
+#else
+        ifstream file(fileName, ios::binary);
+        if (!file.is_open()) {
+            return false;
+        }
+        buffer.assign(istreambuf_iterator<char>(file), istreambuf_iterator<char>());
+        base = buffer.data();
+        length = buffer.size();
+        return true;
+#endif
+    }
+    
+    void close() {
+#ifndef _WIN32
+        if (mapped) {
+            munmap(const_cast<char*>(base), length);
+        }
+#endif
+        mapped = false;
+        base = nullptr;
+        length = 0;
+        buffer.clear();
+    }
+    
+    string_view view() const {
+        return base ? string_view(base, length) : string_view();
+    }
+};
+
+// 二进制交易日志的只读访问：映射整个文件，按顺序迭代或按偏移读取单条记录
+// 遇到不完整或校验失败的记录即视为日志结束（崩溃时可能留下写了一半的尾部）
+class TransactionLogReader {
+private:
+    MappedTextFile file;
+    string_view data;
+    uint64_t position;
+    
+public:
+    TransactionLogReader() : position(0) {}
+    
+    // 文件不存在或文件头不符时返回 false
+    bool open(const string& fileName) {
+        data = string_view();
+        position = 0;
+        if (!file.open(fileName) || !TransactionLogCodec::checkHeader(file.view())) {
+            file.close();
+            return false;
+        }
+        data = file.view();
+        position = sizeof(TransactionLogHeader);
+        return true;
+    }
+    
+    void rewind() {
+        position = data.empty() ? 0 : sizeof(TransactionLogHeader);
+    }
+    
+    // 文件头之后的全部记录字节
+    string_view records() const {
+        return data.empty() ? data : data.substr(sizeof(TransactionLogHeader));
+    }
+    
+    // 读取下一条记录，offset 返回其在文件中的偏移
+    bool next(TransactionLogEntry& entry, uint64_t& offset) {
+        if (position >= data.size()) {
+            return false;
+        }
+        size_t length = TransactionLogCodec::decode(data.substr(position), entry);
+        if (length == 0) {
+            position = data.size();
+            return false;
+        }
+        offset = position;
+        position += length;
+        return true;
+    }
+    
+    bool readAt(uint64_t offset, TransactionLogEntry& entry) const {
+        return offset >= sizeof(TransactionLogHeader) && offset < data.size() &&
+               TransactionLogCodec::decode(data.substr(offset), entry) > 0;
+    }
+    
+    // 导出为旧的 CSV 交易文件格式
+    static bool exportToCsv(const string& binaryFile, const string& csvFile) {
+        TransactionLogReader reader;
+        ofstream out(csvFile, ios::binary);
+        if (!reader.open(binaryFile) || !out.is_open()) {
+            return false;
+        }
+        
+        TransactionLogEntry entry;
+        Transaction trans;
+        uint64_t offset;
+        string buffer;
+        while (reader.next(entry, offset)) {
+            entry.toTransaction(trans);
+            trans.appendLogLine(buffer);
+            if (buffer.size() >= (1 << 16)) {
+                out.write(buffer.data(), buffer.size());
+                buffer.clear();
+            }
+        }
+        out.write(buffer.data(), buffer.size());
+        out.close();
+        return (bool)out;
+    }
+    
+    // 把 CSV 交易文件转换为二进制日志，无法解析或编码的行跳过
+    static bool convertFromCsv(const string& csvFile, const string& binaryFile, size_t& skipped) {
+        ifstream in(csvFile, ios::binary);
+        string tempFile = binaryFile + ".tmp";
+        ofstream out(tempFile, ios::binary);
+        if (!in.is_open() || !out.is_open()) {
+            return false;
+        }
+        
+        string buffer, line;
+        Transaction trans;
+        skipped = 0;
+        TransactionLogCodec::appendHeader(buffer);
+        while (getline(in, line)) {
+            if (line.empty()) {
+                continue;
+            }
+            if (!Transaction::fromLogLine(line, trans) || !TransactionLogCodec::encode(buffer, trans)) {
+                skipped++;
+            }
+            if (buffer.size() >= (1 << 16)) {
+                out.write(buffer.data(), buffer.size());
+                buffer.clear();
+            }
+        }
+        out.write(buffer.data(), buffer.size());
+        out.close();
+        if (!out) {
+            return false;
+        }
+        return replaceFile(tempFile, binaryFile);
+    }
+};
+
+// 把文本切成至多 parts 段，每段都以完整的行结束
+vector<string_view> splitLineChunks(string_view text, size_t parts) {
+    vector<string_view> chunks;
+    size_t start = 0;
+    for (size_t i = 1; i <= parts && start < text.size(); i++) {
+        size_t end = max(start, text.size() / parts * i);
+        if (i == parts || end >= text.size()) {
+            end = text.size();
+        } else {
+            size_t newline = text.find('\n', end);
+            end = newline == string_view::npos ? text.size() : newline + 1;
+        }
+        chunks.push_back(text.substr(start, end - start));
+        start = end;
+    }
+    return chunks;
+}
+
+// 并行解析的段数：每段至少 PARALLEL_PARSE_MIN_CHUNK 字节，不超过 CPU 核数
+size_t parseChunkCount(size_t bytes) {
+    size_t cores = max(1u, thread::hardware_concurrency());
+    return min(cores, max<size_t>(1, bytes / PARALLEL_PARSE_MIN_CHUNK));
+}
+
+// 每段一个线程执行 fn(段序号, 段)，最后一段在当前线程执行
+template <typename Fn>
+void forEachChunk(const vector<string_view>& chunks, Fn fn) {
+    vector<thread> workers;
+    for (size_t i = 0; i + 1 < chunks.size(); i++) {
+        workers.emplace_back(fn, i, chunks[i]);
+    }
+    if (!chunks.empty()) {
+        fn(chunks.size() - 1, chunks.back());
+    }
+    for (thread& worker : workers) {
+        worker.join();
+    }
+}
+
+// 逐行回调 fn(行)，不含换行符，跳过空行
+template <typename Fn>
+void forEachLine(string_view chunk, Fn fn) {
+    while (!chunk.empty()) {
+        size_t newline = chunk.find('\n');
+        string_view line = chunk.substr(0, newline);
+        if (!line.empty()) {
+            fn(line);
+        }
+        if (newline == string_view::npos) {
+            break;
+        }
+        chunk.remove_prefix(newline + 1);
+    }
+}
+
+// 把 [0, count) 均分成至多 parts 段，每段一个线程执行 fn(段序号, 起点, 终点)，最后一段在当前线程执行
+template <typename Fn>
+void forEachRange(size_t count, size_t parts, Fn fn) {
+    parts = max<size_t>(1, min(parts, count));
+    vector<thread> workers;
+    for (size_t i = 0; i + 1 < parts; i++) {
+        workers.emplace_back(fn, i, count / parts * i, count / parts * (i + 1));
+    }
+    fn(parts - 1, count / parts * (parts - 1), count);
+    for (thread& worker : workers) {
+        worker.join();
+    }
+}
+
+// 把二进制日志的记录区切成至多 parts 段，每段都以完整的记录结束
+// 只按标志位跳过记录，不解码；遇到不完整的记录即截断
+vector<string_view> splitRecordChunks(string_view records, size_t parts) {
+    vector<string_view> chunks;
+    size_t target = max<size_t>(1, records.size() / max<size_t>(1, parts));
+    size_t start = 0, pos = 0;
+    while (pos < records.size()) {
+        size_t length = TransactionLogCodec::recordLength(records.substr(pos));
+        if (length == 0) {
+            break;
+        }
+        pos += length;
+        if (pos - start >= target && chunks.size() + 1 < parts) {
+            chunks.push_back(records.substr(start, pos - start));
+            start = pos;
+        }
+    }
+    if (pos > start) {
+        chunks.push_back(records.substr(start, pos - start));
+    }
+    return chunks;
+}
+
+// Unix 秒转为本地秒（本地日期时间按 UTC 换算的秒数）
+// 时区偏移按 15 分钟窗口缓存，按时间顺序的记录每个窗口只调用一次 localtime
+class LocalSecondsConverter {
+private:
+    int64_t windowStart;
+    int64_t windowEnd;
+    int64_t offset;
+    
+public:
+    LocalSecondsConverter() : windowStart(1), windowEnd(0), offset(0) {}
+    
+    uint32_t operator()(uint32_t timestamp) {
+        if (timestamp < windowStart || timestamp >= windowEnd) {
+            tm localTime = localTimeOf((time_t)timestamp);
+            int64_t local = daysFromCivil(localTime.tm_year + 1900, localTime.tm_mon + 1, localTime.tm_mday) * 86400 +
+                            localTime.tm_hour * 3600 + localTime.tm_min * 60 + localTime.tm_sec;
+            offset = local - timestamp;
+            windowStart = timestamp - timestamp % 900;
+            windowEnd = windowStart + 900;
+        }
+        return (uint32_t)(timestamp + offset);
+    }
+};
+
+// 列式交易数据：每个字段一个连续数组，同一下标为同一条记录，供报表做分组聚合
+// 时间存为本地秒，除以 86400、3600 即得本地日序号、小时序号，不再经过时区换算
+struct TransactionColumns {
+    // 19 位账号压缩后都小于 10^19，非标准账号从这里起编号，对应 textAccounts 的下标
+    static const uint64_t TEXT_ACCOUNT_BASE = 10000000000000000000ull;
+    static const uint64_t NO_ACCOUNT = UINT64_MAX;
+    
+    vector<uint8_t> type;
+    vector<uint32_t> localSeconds;
+    vector<int64_t> amountFen;
+    vector<uint64_t> account;
+    vector<uint64_t> target;
+    vector<string> textAccounts;
+    unordered_map<string, uint64_t> textAccountIds;
+    
+    size_t size() const { return type.size(); }
+    
+    void reserve(size_t n) {
+        type.reserve(n);
+        localSeconds.reserve(n);
+        amountFen.reserve(n);
+        account.reserve(n);
+        target.reserve(n);
+    }
+    
+    void push(uint8_t recordType, uint32_t seconds, int64_t amount, uint64_t accountId, uint64_t targetId) {
+        type.push_back(recordType);
+        localSeconds.push_back(seconds);
+        amountFen.push_back(amount);
+        account.push_back(accountId);
+        target.push_back(targetId);
+    }
+    
+    uint64_t accountId(string_view accountNumber) {
+        uint64_t key;
+        if (AccountTable::packAccountNumber(accountNumber, key)) {
+            return key;
+        }
+        string text(accountNumber);
+        auto it = textAccountIds.find(text);
+        if (it != textAccountIds.end()) {
+            return it->second;
+        }
+        uint64_t id = TEXT_ACCOUNT_BASE + textAccounts.size();
+        textAccounts.push_back(text);
+        textAccountIds.emplace(text, id);
+        return id;
+    }
+    
+    string accountText(uint64_t id) const {
+        return id >= TEXT_ACCOUNT_BASE ? textAccounts[id - TEXT_ACCOUNT_BASE] : TransactionLogEntry::unpackAccount(id);
+    }
+    
+    // 解析 CSV 交易文件的一行，格式错误返回 false
+    bool appendLine(string_view line) {
+        string_view fields[6];
+        size_t count = 0;
+        while (count < 6) {
+            size_t comma = line.find(',');
+            fields[count++] = line.substr(0, comma);
+            if (comma == string_view::npos) break;
+            line.remove_prefix(comma + 1);
+        }
+        if (count < 5) {
+            return false;
+        }
+        TransactionType recordType = transactionTypeOf(fields[1]);
+        Money amount;
+        int key = dateKey(fields[3]);
+        int seconds = secondsOfDay(fields[4]);
+        if (recordType == TXN_TYPE_END || !Money::parse(fields[2], amount) || key < 19700101 || seconds < 0) {
+            return false;
+        }
+        int64_t local = daysFromCivil(key / 10000, key / 100 % 100, key % 100) * 86400 + seconds;
+        if (local > UINT32_MAX) {
+            return false;
+        }
+        push(recordType, (uint32_t)local, amount.toFen(), accountId(fields[0]),
+             count > 5 && !fields[5].empty() ? accountId(fields[5]) : NO_ACCOUNT);
+        return true;
+    }
+    
+    void appendEntry(const TransactionLogEntry& entry, uint32_t seconds) {
+        uint64_t accountKey = entry.textAccounts ? accountId(entry.accountText) : entry.account;
+        uint64_t targetKey = !entry.hasTarget ? NO_ACCOUNT :
+                             entry.textAccounts ? accountId(entry.targetText) : entry.target;
+        push(entry.type, seconds, entry.amountFen, accountKey, targetKey);
+    }
+    
+    // 把另一段数据接在末尾（并行载入时按段顺序调用），非标准账号按文本重新编号
+    void append(TransactionColumns& other) {
+        if (size() == 0 && textAccounts.empty()) {
+            swap(*this, other);
+            return;
+        }
+        size_t start = size();
+        type.insert(type.end(), other.type.begin(), other.type.end());
+        localSeconds.insert(localSeconds.end(), other.localSeconds.begin(), other.localSeconds.end());
+        amountFen.insert(amountFen.end(), other.amountFen.begin(), other.amountFen.end());
+        account.insert(account.end(), other.account.begin(), other.account.end());
+        target.insert(target.end(), other.target.begin(), other.target.end());
+        if (!other.textAccounts.empty()) {
+            vector<uint64_t> remap(other.textAccounts.size());
+            for (size_t i = 0; i < remap.size(); i++) {
+                remap[i] = accountId(other.textAccounts[i]);
+            }
+            for (size_t i = start; i < size(); i++) {
+                if (account[i] >= TEXT_ACCOUNT_BASE) {
+                    account[i] = remap[account[i] - TEXT_ACCOUNT_BASE];
+                }
+                if (target[i] != NO_ACCOUNT && target[i] >= TEXT_ACCOUNT_BASE) {
+                    target[i] = remap[target[i] - TEXT_ACCOUNT_BASE];
+                }
+            }
+        }
+        other = TransactionColumns();
+    }
+    
+    bool timeOrdered() const {
+        return is_sorted(localSeconds.begin(), localSeconds.end());
+    }
+    
+    // 载入 CSV 交易文件或二进制交易日志（按文件头识别），映射文件后按段并行解析，再按段顺序拼接
+    // 返回并行的段数，文件无法打开返回 0；二进制日志在第一条不完整或校验失败的记录处结束
+    size_t load(const string& fileName) {
+        *this = TransactionColumns();
+        MappedTextFile file;
+        if (!file.open(fileName)) {
+            return 0;
+        }
+        string_view text = file.view();
+        bool binary = TransactionLogCodec::checkHeader(text);
+        vector<string_view> chunks = binary ?
+            splitRecordChunks(text.substr(sizeof(TransactionLogHeader)), parseChunkCount(text.size())) :
+            splitLineChunks(text, parseChunkCount(text.size()));
+        vector<TransactionColumns> partial(chunks.size());
+        vector<char> complete(chunks.size(), 1);
+        
+        forEachChunk(chunks, [&](size_t index, string_view chunk) {
+            TransactionColumns& local = partial[index];
+            if (!binary) {
+                local.reserve(chunk.size() / ESTIMATED_TRANSACTION_LINE_BYTES);
+                forEachLine(chunk, [&local](string_view line) {
+                    local.appendLine(line);
+                });
+                return;
+            }
+            // 取款、存款记录 26 字节，按它估计条数
+            local.reserve(chunk.size() / 26);
+            LocalSecondsConverter toLocal;
+            TransactionLogEntry entry;
+            while (!chunk.empty()) {
+                size_t length = TransactionLogCodec::decode(chunk, entry);
+                if (length == 0) {
+                    complete[index] = 0;
+                    break;
+                }
+                local.appendEntry(entry, toLocal(entry.timestamp));
+                chunk.remove_prefix(length);
+            }
+        });
+        
+        for (size_t i = 0; i < partial.size(); i++) {
+            append(partial[i]);
+            if (!complete[i]) {
+                break;
+            }
+        }
+        return max<size_t>(1, chunks.size());
+    }
+};
+
+// 交易报表：按本地小时分组的各类交易笔数和金额，以及按交易额排名的账户
+// 交易额为账户作为发起方的取款、存款、转出金额加上转入金额，余额查询不计
+class TransactionReport {
+public:
+    struct Totals {
+        int64_t count[TXN_TYPE_END];
+        int64_t amountFen[TXN_TYPE_END];
+    };
+    
+    struct AccountVolume {
+        uint64_t account;
+        int64_t count;
+        int64_t amountFen;
+    };
+    
+    int64_t firstHour;  // hours[0] 对应的本地小时序号（本地秒 / 3600）
+    vector<Totals> hours;
+    vector<AccountVolume> topAccounts;
+    size_t records;
+    size_t parts;
+    
+private:
+    // 账户交易额的开放寻址表，键为 TransactionColumns 中的账号编号，NO_ACCOUNT 表示空槽
+    class VolumeTable {
+    private:
+        vector<AccountVolume> slots;
+        size_t used;
+        
+        static size_t hash(uint64_t key) {
+            key *= 0x9E3779B97F4A7C15ull;
+            return (size_t)(key ^ (key >> 32));
+        }
+        
+        void grow() {
+            vector<AccountVolume> old(slots.size() * 2, AccountVolume{TransactionColumns::NO_ACCOUNT, 0, 0});
+            old.swap(slots);
+            used = 0;
+            for (const AccountVolume& slot : old) {
+                if (slot.account != TransactionColumns::NO_ACCOUNT) {
+                    add(slot.account, slot.count, slot.amountFen);
+                }
+            }
+        }
+        
+    public:
+        VolumeTable() : slots(1024, AccountVolume{TransactionColumns::NO_ACCOUNT, 0, 0}), used(0) {}
+        
+        void add(uint64_t account, int64_t count, int64_t amountFen) {
+            if ((used + 1) * 2 > slots.size()) {
+                grow();
+            }
+            size_t mask = slots.size() - 1;
+            size_t i = hash(account) & mask;
+            while (slots[i].account != account && slots[i].account != TransactionColumns::NO_ACCOUNT) {
+                i = (i + 1) & mask;
+            }
+            if (slots[i].account == TransactionColumns::NO_ACCOUNT) {
+                slots[i].account = account;
+                used++;
+            }
+            slots[i].count += count;
+            slots[i].amountFen += amountFen;
+        }
+        
+        void merge(const VolumeTable& other) {
+            for (const AccountVolume& slot : other.slots) {
+                if (slot.account != TransactionColumns::NO_ACCOUNT) {
+                    add(slot.account, slot.count, slot.amountFen);
+                }
+            }
+        }
+        
+        // 交易额最大的 n 个账户，金额相同时按账号编号排列
+        vector<AccountVolume> top(size_t n) const {
+            vector<AccountVolume> result;
+            result.reserve(used);
+            for (const AccountVolume& slot : slots) {
+                if (slot.account != TransactionColumns::NO_ACCOUNT) {
+                    result.push_back(slot);
+                }
+            }
+            n = min(n, result.size());
+            partial_sort(result.begin(), result.begin() + n, result.end(),
+                         [](const AccountVolume& a, const AccountVolume& b) {
+                             return a.amountFen != b.amountFen ? a.amountFen > b.amountFen : a.account < b.account;
+                         });
+            result.resize(n);
+            return result;
+        }
+    };
+    
+    // 同一小时内的一段记录，逐类型做无分支的条件求和，内层循环可被编译器向量化
+    static void sumSegment(const uint8_t* type, const int64_t* amountFen, size_t n, Totals& totals) {
+        for (int t = TXN_WITHDRAWAL; t < TXN_TYPE_END; t++) {
+            int64_t count = 0, sum = 0;
+            for (size_t i = 0; i < n; i++) {
+                int64_t match = type[i] == t;
+                count += match;
+                sum += amountFen[i] & -match;
+            }
+            totals.count[t] += count;
+            totals.amountFen[t] += sum;
+        }
+    }
+    
+    static string formatDay(int64_t day) {
+        int key = civilDateKey(day);
+        char text[16];
+        snprintf(text, sizeof(text), "%04d-%02d-%02d", key / 10000, key / 100 % 100, key % 100);
+        return text;
+    }
+    
+    static void printTotalsHeader(ostream& out, const char* label) {
+        char line[224];
+        snprintf(line, sizeof(line), "%-17s %10s %16s %10s %16s %10s %16s %10s %14s %14s\n", label, "withdrawals", "amount",
+                 "deposits", "amount", "transfers", "amount", "queries", "interest", "fees");
+        out << line;
+    }
+    
+    static void printTotals(ostream& out, const string& label, const Totals& totals) {
+        char line[224];
+        snprintf(line, sizeof(line), "%-17s %10lld %16s %10lld %16s %10lld %16s %10lld %14s %14s\n", label.c_str(),
+                 (long long)totals.count[TXN_WITHDRAWAL], Money::fromFen(totals.amountFen[TXN_WITHDRAWAL]).toString().c_str(),
+                 (long long)totals.count[TXN_DEPOSIT], Money::fromFen(totals.amountFen[TXN_DEPOSIT]).toString().c_str(),
+                 (long long)totals.count[TXN_TRANSFER], Money::fromFen(totals.amountFen[TXN_TRANSFER]).toString().c_str(),
+                 (long long)totals.count[TXN_BALANCE_QUERY],
+                 Money::fromFen(totals.amountFen[TXN_INTEREST]).toString().c_str(),
+                 Money::fromFen(totals.amountFen[TXN_FEE]).toString().c_str());
+        out << line;
+    }
+    
+    static void addTotals(Totals& into, const Totals& from) {
+        for (int t = 0; t < TXN_TYPE_END; t++) {
+            into.count[t] += from.count[t];
+            into.amountFen[t] += from.amountFen[t];
+        }
+    }
+    
+    static bool hasActivity(const Totals& totals) {
+        int64_t count = 0;
+        for (int t = TXN_WITHDRAWAL; t < TXN_TYPE_END; t++) {
+            count += totals.count[t];
+        }
+        return count > 0;
+    }
+    
+public:
+    TransactionReport() : firstHour(0), records(0), parts(0) {}
+    
+    // 统计日期在 [fromKey, toKey]（dateKey 形式，-1 表示不限）内的记录，取交易额前 top 名账户
+    // 记录按时间排列时（日志按写入顺序即是）二分定位区间和每个小时的边界，否则逐条判断区间再分桶
+    static TransactionReport build(const TransactionColumns& columns, int fromKey, int toKey, size_t top) {
+        TransactionReport report;
+        const uint32_t* seconds = columns.localSeconds.data();
+        const uint8_t* type = columns.type.data();
+        const int64_t* amountFen = columns.amountFen.data();
+        size_t n = columns.size();
+        int64_t low = fromKey < 0 ? 0 : daysFromCivil(fromKey / 10000, fromKey / 100 % 100, fromKey % 100) * 86400;
+        int64_t high = toKey < 0 ? INT64_MAX : (daysFromCivil(toKey / 10000, toKey / 100 % 100, toKey % 100) + 1) * 86400;
+        bool ordered = columns.timeOrdered();
+        
+        size_t begin = 0, end = n;
+        int64_t minSeconds = INT64_MAX, maxSeconds = -1;
+        if (ordered) {
+            begin = lower_bound(seconds, seconds + n, low) - seconds;
+            end = lower_bound(seconds + begin, seconds + n, high) - seconds;
+            if (begin < end) {
+                minSeconds = seconds[begin];
+                maxSeconds = seconds[end - 1];
+            }
+        } else {
+            for (size_t i = 0; i < n; i++) {
+                if (seconds[i] >= low && seconds[i] < high) {
+                    minSeconds = min<int64_t>(minSeconds, seconds[i]);
+                    maxSeconds = max<int64_t>(maxSeconds, seconds[i]);
+                }
+            }
+        }
+        if (minSeconds > maxSeconds) {
+            return report;
+        }
+        report.firstHour = minSeconds / 3600;
+        size_t hourCount = maxSeconds / 3600 - report.firstHour + 1;
+        
+        size_t cores = max(1u, thread::hardware_concurrency());
+        report.parts = max<size_t>(1, min(cores, (end - begin) / PARALLEL_REPORT_MIN_RECORDS));
+        vector<vector<Totals>> partialHours(report.parts, vector<Totals>(hourCount, Totals{}));
+        vector<VolumeTable> partialVolumes(report.parts);
+        
+        forEachRange(end - begin, report.parts, [&](size_t index, size_t from, size_t to) {
+            from += begin;
+            to += begin;
+            vector<Totals>& hours = partialHours[index];
+            VolumeTable& volumes = partialVolumes[index];
+            if (ordered) {
+                for (size_t i = from; i < to;) {
+                    int64_t hour = seconds[i] / 3600;
+                    size_t next = lower_bound(seconds + i, seconds + to, (hour + 1) * 3600) - seconds;
+                    sumSegment(type + i, amountFen + i, next - i, hours[hour - report.firstHour]);
+                    i = next;
+                }
+            } else {
+                for (size_t i = from; i < to; i++) {
+                    if (seconds[i] >= low && seconds[i] < high) {
+                        Totals& bucket = hours[seconds[i] / 3600 - report.firstHour];
+                        bucket.count[type[i]]++;
+                        bucket.amountFen[type[i]] += amountFen[i];
+                    }
+                }
+            }
+            for (size_t i = from; i < to; i++) {
+                // 余额查询和日终记账（利息、费用）不计入账户交易额
+                if (type[i] >= TXN_BALANCE_QUERY || (!ordered && (seconds[i] < low || seconds[i] >= high))) {
+                    continue;
+                }
+                volumes.add(columns.account[i], 1, amountFen[i]);
+                if (columns.target[i] != TransactionColumns::NO_ACCOUNT) {
+                    volumes.add(columns.target[i], 1, amountFen[i]);
+                }
+            }
+        });
+        
+        report.hours.swap(partialHours[0]);
+        for (size_t p = 1; p < report.parts; p++) {
+            for (size_t h = 0; h < hourCount; h++) {
+                addTotals(report.hours[h], partialHours[p][h]);
+            }
+            partialVolumes[0].merge(partialVolumes[p]);
+        }
+        for (const Totals& totals : report.hours) {
+            for (int t = TXN_WITHDRAWAL; t < TXN_TYPE_END; t++) {
+                report.records += totals.count[t];
+            }
+        }
+        report.topAccounts = partialVolumes[0].top(top);
+        return report;
+    }
+    
+    // allHours 为 true 时逐小时列出，否则按一天中的 24 个小时汇总
+    void print(ostream& out, const TransactionColumns& columns, bool allHours) const {
+        if (hours.empty()) {
+            out << "No transactions in range." << endl;
+            return;
+        }
+        int64_t firstDay = firstHour / 24;
+        int64_t lastDay = (firstHour + (int64_t)hours.size() - 1) / 24;
+        out << "Transaction report " << formatDay(firstDay) << " .. " << formatDay(lastDay) << ": "
+            << records << " records" << endl;
+        
+        out << "\nDaily totals" << endl;
+        printTotalsHeader(out, "date");
+        Totals day = {}, total = {};
+        for (size_t h = 0; h < hours.size(); h++) {
+            addTotals(day, hours[h]);
+            addTotals(total, hours[h]);
+            int64_t hour = firstHour + (int64_t)h;
+            if (h + 1 == hours.size() || (hour + 1) % 24 == 0) {
+                if (hasActivity(day)) {
+                    printTotals(out, formatDay(hour / 24), day);
+                }
+                day = Totals{};
+            }
+        }
+        printTotals(out, "total", total);
+        
+        out << (allHours ? "\nHourly totals" : "\nTotals by hour of day") << endl;
+        printTotalsHeader(out, "hour");
+        Totals byHourOfDay[24] = {};
+        char label[32];
+        for (size_t h = 0; h < hours.size(); h++) {
+            int64_t hour = firstHour + (int64_t)h;
+            if (!allHours) {
+                addTotals(byHourOfDay[hour % 24], hours[h]);
+            } else if (hasActivity(hours[h])) {
+                snprintf(label, sizeof(label), "%s %02d:00", formatDay(hour / 24).c_str(), (int)(hour % 24));
+                printTotals(out, label, hours[h]);
+            }
+        }
+        for (int hour = 0; !allHours && hour < 24; hour++) {
+            snprintf(label, sizeof(label), "%02d:00", hour);
+            printTotals(out, label, byHourOfDay[hour]);
+        }
+        
+        out << "\nTop " << topAccounts.size() << " accounts by volume" << endl;
+        char line[128];
+        snprintf(line, sizeof(line), "%-5s %-19s %12s %18s\n", "rank", "account", "transactions", "volume");
+        out << line;
+        for (size_t i = 0; i < topAccounts.size(); i++) {
+            snprintf(line, sizeof(line), "%-5zu %-19s %12lld %18s\n", i + 1,
+                     columns.accountText(topAccounts[i].account).c_str(), (long long)topAccounts[i].count,
+                     Money::fromFen(topAccounts[i].amountFen).toString().c_str());
+            out << line;
+        }
+    }
+};
+
+// 账本核对：从基线余额出发按交易日志重放出每个账户应有的余额，与账户文件比对，也可据此重建账户文件
+// 账户和记录按账号哈希分区，每个分区由一个线程按日志顺序重放，同一账户的记录顺序不变
+class LedgerReconciler {
+public:
+    static const int64_t ABSENT = INT64_MIN;
+    
+    struct Mismatch {
+        uint64_t account;
+        int64_t expectedFen;
+        int64_t actualFen;  // ABSENT 表示账户文件中没有该账户
+    };
+    
+    size_t records;      // 重放的记录，不含余额查询和 since 之前的记录
+    size_t accounts;     // 账户文件中的账户
+    size_t matched;
+    size_t overdrafts;   // 重放中余额由非负变为负数的次数，通常说明缺记录或基线不对
+    vector<Mismatch> mismatches;  // 按账号编号排序
+    size_t parts;
+    
+private:
+    enum : uint8_t { IN_BASELINE = 1, IN_ACCOUNTS = 2 };
+    
+    struct Slot {
+        uint64_t account;
+        int64_t expectedFen;
+        int64_t actualFen;
+        uint8_t flags;
+    };
+    
+    struct Balance {
+        uint64_t account;
+        int64_t fen;
+    };
+    
+    // 一个分区的账户，开放寻址，NO_ACCOUNT 表示空槽；不在基线中的账户按开户金额起算
+    class LedgerTable {
+    private:
+        vector<Slot> slots;
+        size_t used;
+        
+        void grow() {
+            vector<Slot> old(slots.size() * 2, Slot{TransactionColumns::NO_ACCOUNT, 0, ABSENT, 0});
+            old.swap(slots);
+            used = 0;
+            for (const Slot& slot : old) {
+                if (slot.account != TransactionColumns::NO_ACCOUNT) {
+                    get(slot.account) = slot;
+                }
+            }
+        }
+        
+    public:
+        LedgerTable() : slots(1024, Slot{TransactionColumns::NO_ACCOUNT, 0, ABSENT, 0}), used(0) {}
+        
+        Slot& get(uint64_t account) {
+            if ((used + 1) * 2 > slots.size()) {
+                grow();
+            }
+            size_t mask = slots.size() - 1;
+            size_t i = hash(account) & mask;
+            while (slots[i].account != account && slots[i].account != TransactionColumns::NO_ACCOUNT) {
+                i = (i + 1) & mask;
+            }
+            if (slots[i].account == TransactionColumns::NO_ACCOUNT) {
+                slots[i] = Slot{account, INITIAL_BALANCE.toFen(), ABSENT, 0};
+                used++;
+            }
+            return slots[i];
+        }
+        
+        const Slot* find(uint64_t account) const {
+            size_t mask = slots.size() - 1;
+            for (size_t i = hash(account) & mask; slots[i].account != TransactionColumns::NO_ACCOUNT; i = (i + 1) & mask) {
+                if (slots[i].account == account) {
+                    return &slots[i];
+                }
+            }
+            return nullptr;
+        }
+        
+        const vector<Slot>& all() const {
+            return slots;
+        }
+    };
+    
+    // 各段分到各分区的数据：[段][分区]
+    template <typename T>
+    using Buckets = vector<vector<vector<T>>>;
+    
+    vector<LedgerTable> tables;
+    
+    static size_t hash(uint64_t key) {
+        key *= 0x9E3779B97F4A7C15ull;
+        return (size_t)(key ^ (key >> 32));
+    }
+    
+    // 分区取哈希的高位，与分区内开放寻址用的低位错开
+    size_t partitionOf(uint64_t account) const {
+        return (size_t)((hash(account) >> 40) % tables.size());
+    }
+    
+    // 账户文件映射后按段并行取出账号和余额（最后一个字段），分到各分区；非标准账号在各段结束后统一编号
+    bool loadBalances(const vector<string>& fileNames, TransactionColumns& columns, Buckets<Balance>& buckets) const {
+        for (const string& fileName : fileNames) {
+            MappedTextFile file;
+            if (!file.open(fileName)) {
+                return false;
+            }
+            vector<string_view> chunks = splitLineChunks(file.view(), parseChunkCount(file.view().size()));
+            size_t first = buckets.size();
+            buckets.resize(first + chunks.size(), vector<vector<Balance>>(tables.size()));
+            vector<vector<pair<string_view, int64_t>>> textAccounts(chunks.size());
+            forEachChunk(chunks, [&](size_t index, string_view chunk) {
+                vector<vector<Balance>>& local = buckets[first + index];
+                forEachLine(chunk, [&](string_view line) {
+                    size_t comma = line.find(',');
+                    size_t last = line.rfind(',');
+                    Money balance;
+                    if (comma == string_view::npos || !Money::parse(line.substr(last + 1), balance)) {
+                        return;
+                    }
+                    uint64_t key;
+                    if (AccountTable::packAccountNumber(line.substr(0, comma), key)) {
+                        local[partitionOf(key)].push_back(Balance{key, balance.toFen()});
+                    } else {
+                        textAccounts[index].emplace_back(line.substr(0, comma), balance.toFen());
+                    }
+                });
+            });
+            for (size_t i = 0; i < chunks.size(); i++) {
+                for (const auto& item : textAccounts[i]) {
+                    uint64_t key = columns.accountId(item.first);
+                    buckets[first + i][partitionOf(key)].push_back(Balance{key, item.second});
+                }
+            }
+        }
+        return true;
+    }
+    
+    // 把余额字段换成应有余额写出一个账户文件的各行；skipListed 时跳过账户文件中已有的账户（用于基线文件）
+    bool writeLines(const string& fileName, const TransactionColumns& columns, bool skipListed, ofstream& out) const {
+        MappedTextFile file;
+        if (!file.open(fileName)) {
+            return false;
+        }
+        vector<string_view> chunks = splitLineChunks(file.view(), parseChunkCount(file.view().size()));
+        vector<string> buffers(chunks.size());
+        forEachChunk(chunks, [&](size_t index, string_view chunk) {
+            string& buffer = buffers[index];
+            buffer.reserve(chunk.size() + chunk.size() / 8);
+            forEachLine(chunk, [&](string_view line) {
+                size_t comma = line.find(',');
+                size_t last = line.rfind(',');
+                if (comma == string_view::npos) {
+                    return;
+                }
+                string_view accountNumber = line.substr(0, comma);
+                uint64_t key;
+                if (!AccountTable::packAccountNumber(accountNumber, key)) {
+                    auto it = columns.textAccountIds.find(string(accountNumber));
+                    if (it == columns.textAccountIds.end()) {
+                        return;
+                    }
+                    key = it->second;
+                }
+                const Slot* slot = tables[partitionOf(key)].find(key);
+                if (!slot || (skipListed && (slot->flags & IN_ACCOUNTS))) {
+                    return;
+                }
+                buffer.append(line.data(), last + 1);
+                Money::fromFen(slot->expectedFen).appendTo(buffer);
+                buffer += '\n';
+            });
+        });
+        for (const string& buffer : buffers) {
+            out.write(buffer.data(), buffer.size());
+        }
+        return true;
+    }
+    
+public:
+    LedgerReconciler() : records(0), accounts(0), matched(0), overdrafts(0), parts(0) {}
+    
+    // 基线文件为空时所有账户按开户金额起算；基线中没有的账户（之后开户的）同样按开户金额起算
+    // sinceLocal 之前（本地秒）的记录视为已包含在基线中；账户文件或基线文件无法打开返回 false
+    bool run(TransactionColumns& columns, const vector<string>& baselineFiles, const vector<string>& accountFiles,
+             int64_t sinceLocal) {
+        parts = max(1u, thread::hardware_concurrency());
+        tables.assign(parts, LedgerTable());
+        
+        Buckets<Balance> baseline, actual;
+        if (!loadBalances(baselineFiles, columns, baseline) || !loadBalances(accountFiles, columns, actual)) {
+            return false;
+        }
+        
+        // 记录按段分到各分区，转账的转入方另记一项（最低位为 1），段内保持日志顺序
+        size_t count = columns.size();
+        size_t ranges = count < PARALLEL_REPORT_MIN_RECORDS ? 1 : parts;
+        Buckets<uint64_t> entries(ranges, vector<vector<uint64_t>>(parts));
+        forEachRange(count, ranges, [&](size_t range, size_t from, size_t to) {
+            vector<vector<uint64_t>>& local = entries[range];
+            for (size_t i = from; i < to; i++) {
+                if (columns.type[i] == TXN_BALANCE_QUERY || (int64_t)columns.localSeconds[i] < sinceLocal) {
+                    continue;
+                }
+                local[partitionOf(columns.account[i])].push_back((uint64_t)i << 1);
+                if (columns.type[i] == TXN_TRANSFER && columns.target[i] != TransactionColumns::NO_ACCOUNT) {
+                    local[partitionOf(columns.target[i])].push_back((uint64_t)i << 1 | 1);
+                }
+            }
+        });
+        
+        vector<size_t> partRecords(parts), partAccounts(parts), partMatched(parts), partOverdrafts(parts);
+        vector<vector<Mismatch>> partMismatches(parts);
+        forEachRange(parts, parts, [&](size_t part, size_t, size_t) {
+            LedgerTable& table = tables[part];
+            for (const auto& chunk : baseline) {
+                for (const Balance& balance : chunk[part]) {
+                    Slot& slot = table.get(balance.account);
+                    slot.expectedFen = balance.fen;
+                    slot.flags |= IN_BASELINE;
+                }
+            }
+            for (const auto& range : entries) {
+                for (uint64_t entry : range[part]) {
+                    size_t i = entry >> 1;
+                    bool incoming = entry & 1;
+                    Slot& slot = table.get(incoming ? columns.target[i] : columns.account[i]);
+                    int64_t amount = columns.amountFen[i];
+                    bool credit = incoming || columns.type[i] == TXN_DEPOSIT || columns.type[i] == TXN_INTEREST;
+                    int64_t before = slot.expectedFen;
+                    slot.expectedFen += credit ? amount : -amount;
+                    partOverdrafts[part] += before >= 0 && slot.expectedFen < 0;
+                    partRecords[part] += !incoming;
+                }
+            }
+            for (const auto& chunk : actual) {
+                for (const Balance& balance : chunk[part]) {
+                    Slot& slot = table.get(balance.account);
+                    partAccounts[part] += !(slot.flags & IN_ACCOUNTS);
+                    slot.actualFen = balance.fen;
+                    slot.flags |= IN_ACCOUNTS;
+                }
+            }
+            for (const Slot& slot : table.all()) {
+                if (slot.account == TransactionColumns::NO_ACCOUNT) {
+                    continue;
+                }
+                if (slot.actualFen == slot.expectedFen) {
+                    partMatched[part]++;
+                } else {
+                    partMismatches[part].push_back(Mismatch{slot.account, slot.expectedFen, slot.actualFen});
+                }
+            }
+        });
+        
+        for (size_t part = 0; part < parts; part++) {
+            records += partRecords[part];
+            accounts += partAccounts[part];
+            matched += partMatched[part];
+            overdrafts += partOverdrafts[part];
+            mismatches.insert(mismatches.end(), partMismatches[part].begin(), partMismatches[part].end());
+        }
+        sort(mismatches.begin(), mismatches.end(), [](const Mismatch& a, const Mismatch& b) {
+            return a.account < b.account;
+        });
+        return true;
+    }
+    
+    // 按应有余额写出账户文件：账户文件中的行只换余额，只在基线中有的账户取基线中的行；
+    // 日志中出现但两处都没有的账户没有姓名、密码等资料，不写出。临时文件落盘后直接改名覆盖 outFile
+    bool rebuild(const string& outFile, const TransactionColumns& columns, const vector<string>& baselineFiles,
+                 const vector<string>& accountFiles) const {
+        string tempFile = outFile + ".tmp";
+        ofstream out(tempFile, ios::binary);
+        if (!out.is_open()) {
+            return false;
+        }
+        for (const string& fileName : accountFiles) {
+            if (!writeLines(fileName, columns, false, out)) {
+                return false;
+            }
+        }
+        for (const string& fileName : baselineFiles) {
+            if (!writeLines(fileName, columns, true, out)) {
+                return false;
+            }
+        }
+        out.close();
+        if (!out) {
+            return false;
+        }
+        return replaceFile(tempFile, outFile);
+    }
+    
+    void print(ostream& out, const TransactionColumns& columns) const {
+        char line[160];
+        snprintf(line, sizeof(line), "%-24s %18s %18s %18s\n", "account", "expected", "actual", "difference");
+        out << line;
+        for (const Mismatch& item : mismatches) {
+            string actual = item.actualFen == ABSENT ? "missing" : Money::fromFen(item.actualFen).toString();
+            string difference = item.actualFen == ABSENT ? "-" : Money::fromFen(item.actualFen - item.expectedFen).toString();
+            snprintf(line, sizeof(line), "%-24s %18s %18s %18s\n", columns.accountText(item.account).c_str(),
+                     Money::fromFen(item.expectedFen).toString().c_str(), actual.c_str(), difference.c_str());
+            out << line;
+        }
+        out << "replayed " << records << " records; " << accounts << " accounts checked, " << matched << " matched, "
+            << mismatches.size() << " mismatched, " << overdrafts << " overdrafts" << endl;
+    }
+};
+
+// 业务操作的结果
+enum OpStatus {
+    OP_OK,
+    OP_NOT_LOGGED_IN,
+    OP_NO_ACCOUNT,
+    OP_NO_TARGET_ACCOUNT,
+    OP_ACCOUNT_LOCKED,
+    OP_WRONG_PASSWORD,
+    OP_TOO_MANY_ATTEMPTS,
+    OP_INVALID_AMOUNT,
+    OP_NOT_MULTIPLE,
+    OP_SINGLE_LIMIT,
+    OP_DAILY_LIMIT,
+    OP_INSUFFICIENT_BALANCE,
+    OP_SAME_ACCOUNT,
+    OP_INVALID_PASSWORD_LENGTH,
+    OP_INVALID_PASSWORD_DIGITS,
+    OP_CANNOT_DISPENSE,
+    OP_FAILED,
+    OP_STATUS_COUNT
+};
+
+const char* opStatusMessage(OpStatus status) {
+    switch (status) {
+        case OP_OK: return "OK";
+        case OP_NOT_LOGGED_IN: return "Please login first!";
+        case OP_NO_ACCOUNT: return "Account does not exist!";
+        case OP_NO_TARGET_ACCOUNT: return "Target account does not exist!";
+        case OP_ACCOUNT_LOCKED: return "Account is locked, please contact bank customer service!";
+        case OP_WRONG_PASSWORD: return "Wrong password!";
+        case OP_TOO_MANY_ATTEMPTS: return "Too many wrong password attempts, account has been locked!";
+        case OP_INVALID_AMOUNT: return "Invalid amount!";
+        case OP_NOT_MULTIPLE: return "Withdrawal amount must be multiple of 100!";
+        case OP_SINGLE_LIMIT: return "Exceeds single withdrawal limit!";
+        case OP_DAILY_LIMIT: return "Exceeds daily withdrawal limit!";
+        case OP_INSUFFICIENT_BALANCE: return "Insufficient balance!";
+        case OP_SAME_ACCOUNT: return "Cannot transfer to yourself!";
+        case OP_INVALID_PASSWORD_LENGTH: return "Password must be 6 digits!";
+        case OP_INVALID_PASSWORD_DIGITS: return "Password must be numeric!";
+        case OP_CANNOT_DISPENSE: return "This ATM cannot dispense that amount with the notes available!";
+        default: return "Operation failed!";
+    }
+}
+
+// 指标标签用的结果名
+const char* opStatusName(OpStatus status) {
+    switch (status) {
+        case OP_OK: return "ok";
+        case OP_NOT_LOGGED_IN: return "not_logged_in";
+        case OP_NO_ACCOUNT: return "no_account";
+        case OP_NO_TARGET_ACCOUNT: return "no_target_account";
+        case OP_ACCOUNT_LOCKED: return "account_locked";
+        case OP_WRONG_PASSWORD: return "wrong_password";
+        case OP_TOO_MANY_ATTEMPTS: return "too_many_attempts";
+        case OP_INVALID_AMOUNT: return "invalid_amount";
+        case OP_NOT_MULTIPLE: return "not_multiple";
+        case OP_SINGLE_LIMIT: return "single_limit";
+        case OP_DAILY_LIMIT: return "daily_limit";
+        case OP_INSUFFICIENT_BALANCE: return "insufficient_balance";
+        case OP_SAME_ACCOUNT: return "same_account";
+        case OP_INVALID_PASSWORD_LENGTH: return "invalid_password_length";
+        case OP_INVALID_PASSWORD_DIGITS: return "invalid_password_digits";
+        case OP_CANNOT_DISPENSE: return "cannot_dispense";
+        default: return "failed";
+    }
+}
+
+// ====================== 运行指标 ======================
+// 被计量的操作
+enum MetricOp {
+    METRIC_LOGIN,
+    METRIC_WITHDRAW,
+    METRIC_TRANSFER,
+    METRIC_SAVE_ACCOUNTS,
+    METRIC_TODAY_WITHDRAWAL,
+    METRIC_REPLICATION_LAG,  // 备库：主库提交到本地应用完成的时间差
+    METRIC_OP_COUNT
+};
+const char* const METRIC_OP_NAMES[METRIC_OP_COUNT] = {
+    "login", "withdraw", "transfer", "save_accounts", "today_withdrawal_total", "replication_lag"
+};
+
+// 延迟直方图：第 i 个桶的上界为 METRIC_MIN_BUCKET_NS * 2^i 纳秒，最后一个桶不设上界
+const int METRIC_BUCKET_COUNT = 24;
+const uint64_t METRIC_MIN_BUCKET_NS = 256;
+
+uint64_t metricBucketBoundNs(int bucket) {
+    return METRIC_MIN_BUCKET_NS << bucket;
+}
+
+// 运行指标：每个线程一组计数器和直方图，只由所属线程写入，不加锁
+// 单写者用 relaxed 读改写代替原子加，汇总时读到的是各线程近似一致的快照
+// 线程退出后计数块归还空闲链表，由后来的线程继续累加，总数不丢
+class Metrics {
+public:
+    struct Cells {
+        atomic<uint64_t> results[METRIC_OP_COUNT][OP_STATUS_COUNT];
+        atomic<uint64_t> buckets[METRIC_OP_COUNT][METRIC_BUCKET_COUNT];
+        atomic<uint64_t> sumNs[METRIC_OP_COUNT];
+        
+        Cells() {
+            for (int op = 0; op < METRIC_OP_COUNT; op++) {
+                for (auto& count : results[op]) count.store(0, memory_order_relaxed);
+                for (auto& count : buckets[op]) count.store(0, memory_order_relaxed);
+                sumNs[op].store(0, memory_order_relaxed);
+            }
+        }
+    };
+    
+    // 所有线程的汇总
+    struct Snapshot {
+        uint64_t results[METRIC_OP_COUNT][OP_STATUS_COUNT] = {};
+        uint64_t buckets[METRIC_OP_COUNT][METRIC_BUCKET_COUNT] = {};
+        uint64_t sumNs[METRIC_OP_COUNT] = {};
+        
+        uint64_t count(int op) const {
+            uint64_t total = 0;
+            for (int status = 0; status < OP_STATUS_COUNT; status++) {
+                total += results[op][status];
+            }
+            return total;
+        }
+        
+        // 分位数的近似值：所在桶的上界（纳秒），落在最后一个桶时返回其下界
+        uint64_t percentileNs(int op, double p) const {
+            uint64_t total = count(op);
+            if (total == 0) {
+                return 0;
+            }
+            uint64_t rank = (uint64_t)(p * total), seen = 0;
+            for (int bucket = 0; bucket < METRIC_BUCKET_COUNT - 1; bucket++) {
+                seen += buckets[op][bucket];
+                if (seen > rank) {
+                    return metricBucketBoundNs(bucket);
+                }
+            }
+            return metricBucketBoundNs(METRIC_BUCKET_COUNT - 2);
+        }
+    };
+    
+private:
+    mutex registryMutex;
+    vector<unique_ptr<Cells>> allCells;
+    vector<Cells*> freeCells;
+    atomic<bool> enabled;
+    // 瞬时值（如复制延迟），由状态所在的模块按需更新
+    map<string, double> gauges;
+    
+    Metrics() : enabled(true) {}
+    
+    // 线程局部的计数块句柄，线程退出时归还
+    struct LocalHandle {
+        Cells* cells;
+        LocalHandle() : cells(instance().acquire()) {}
+        ~LocalHandle() { instance().release(cells); }
+    };
+    
+    Cells* acquire() {
+        lock_guard<mutex> lock(registryMutex);
+        if (!freeCells.empty()) {
+            Cells* cells = freeCells.back();
+            freeCells.pop_back();
+            return cells;
+        }
+        allCells.push_back(make_unique<Cells>());
+        return allCells.back().get();
+    }
+    
+    void release(Cells* cells) {
+        lock_guard<mutex> lock(registryMutex);
+        freeCells.push_back(cells);
+    }
+    
+    static Cells& local() {
+        thread_local LocalHandle handle;
+        return *handle.cells;
+    }
+    
+    static void bump(atomic<uint64_t>& counter, uint64_t delta) {
+        counter.store(counter.load(memory_order_relaxed) + delta, memory_order_relaxed);
+    }
+    
+public:
+    static Metrics& instance() {
+        static Metrics metrics;
+        return metrics;
+    }
+    
+    static bool isEnabled() {
+        return instance().enabled.load(memory_order_relaxed);
+    }
+    
+    static void setEnabled(bool on) {
+        instance().enabled.store(on, memory_order_relaxed);
+    }
+    
+    static void record(MetricOp op, OpStatus status, uint64_t ns) {
+        Cells& cells = local();
+        int bucket = 0;
+        while (bucket < METRIC_BUCKET_COUNT - 1 && ns > metricBucketBoundNs(bucket)) {
+            bucket++;
+        }
+        bump(cells.results[op][status], 1);
+        bump(cells.buckets[op][bucket], 1);
+        bump(cells.sumNs[op], ns);
+    }
+    
+    static void setGauge(const string& name, double value) {
+        Metrics& metrics = instance();
+        lock_guard<mutex> lock(metrics.registryMutex);
+        metrics.gauges[name] = value;
+    }
+    
+    static map<string, double> gaugeSnapshot() {
+        Metrics& metrics = instance();
+        lock_guard<mutex> lock(metrics.registryMutex);
+        return metrics.gauges;
+    }
+    
+    static Snapshot snapshot() {
+        Snapshot total;
+        Metrics& metrics = instance();
+        lock_guard<mutex> lock(metrics.registryMutex);
+        for (const auto& cells : metrics.allCells) {
+            for (int op = 0; op < METRIC_OP_COUNT; op++) {
+                for (int status = 0; status < OP_STATUS_COUNT; status++) {
+                    total.results[op][status] += cells->results[op][status].load(memory_order_relaxed);
+                }
+                for (int bucket = 0; bucket < METRIC_BUCKET_COUNT; bucket++) {
+                    total.buckets[op][bucket] += cells->buckets[op][bucket].load(memory_order_relaxed);
+                }
+                total.sumNs[op] += cells->sumNs[op].load(memory_order_relaxed);
+            }
+        }
+        return total;
+    }
+    
+    // Prometheus 文本格式：按结果计数的 counter，加每个操作的延迟 histogram（秒）
+    static void writePrometheus(ostream& out) {
+        Snapshot snap = snapshot();
+        out << "# HELP atm_operations_total Completed operations by result.\n";
+        out << "# TYPE atm_operations_total counter\n";
+        for (int op = 0; op < METRIC_OP_COUNT; op++) {
+            for (int status = 0; status < OP_STATUS_COUNT; status++) {
+                if (status == OP_OK || snap.results[op][status] > 0) {
+                    out << "atm_operations_total{op=\"" << METRIC_OP_NAMES[op] << "\",result=\""
+                        << opStatusName((OpStatus)status) << "\"} " << snap.results[op][status] << '\n';
+                }
+            }
+        }
+        
+        out << "# HELP atm_operation_duration_seconds Operation latency.\n";
+        out << "# TYPE atm_operation_duration_seconds histogram\n";
+        char bound[32];
+        for (int op = 0; op < METRIC_OP_COUNT; op++) {
+            const char* name = METRIC_OP_NAMES[op];
+            uint64_t cumulative = 0;
+            for (int bucket = 0; bucket < METRIC_BUCKET_COUNT; bucket++) {
+                cumulative += snap.buckets[op][bucket];
+                if (bucket < METRIC_BUCKET_COUNT - 1) {
+                    snprintf(bound, sizeof(bound), "%g", metricBucketBoundNs(bucket) / 1e9);
+                } else {
+                    strcpy(bound, "+Inf");
+                }
+                out << "atm_operation_duration_seconds_bucket{op=\"" << name << "\",le=\"" << bound << "\"} "
+                    << cumulative << '\n';
+            }
+            snprintf(bound, sizeof(bound), "%.9f", snap.sumNs[op] / 1e9);
+            out << "atm_operation_duration_seconds_sum{op=\"" << name << "\"} " << bound << '\n';
+            out << "atm_operation_duration_seconds_count{op=\"" << name << "\"} " << cumulative << '\n';
+        }
+        
+        for (const auto& gauge : gaugeSnapshot()) {
+            out << "# TYPE atm_" << gauge.first << " gauge\n";
+            out << "atm_" << gauge.first << ' ' << gauge.second << '\n';
+        }
+    }
+    
+    // 先写临时文件再改名，采集方不会读到写了一半的文件
+    static bool writePrometheusFile(const string& fileName) {
+        string tempFile = fileName + ".tmp";
+        ofstream file(tempFile);
+        if (!file.is_open()) {
+            return false;
+        }
+        writePrometheus(file);
+        file.close();
+        if (!file) {
+            return false;
+        }
+        // 直接改名覆盖，抓取方任何时刻都能读到完整的文件；指标文件定期重写，不需要 fsync
+        error_code error;
+        filesystem::rename(tempFile, fileName, error);
+        return !error;
+    }
+    
+    // 管理菜单的实时摘要
+    static void printSummary(ostream& out) {
+        Snapshot snap = snapshot();
+        char line[160];
+        snprintf(line, sizeof(line), "%-24s %10s %10s %10s %10s %10s", "op", "count", "failed", "avg(us)",
+                 "p50(us)", "p99(us)");
+        out << line << '\n';
+        for (int op = 0; op < METRIC_OP_COUNT; op++) {
+            uint64_t count = snap.count(op);
+            snprintf(line, sizeof(line), "%-24s %10llu %10llu %10.1f %10.1f %10.1f", METRIC_OP_NAMES[op],
+                     (unsigned long long)count, (unsigned long long)(count - snap.results[op][OP_OK]),
+                     count ? snap.sumNs[op] / 1000.0 / count : 0.0, snap.percentileNs(op, 0.50) / 1000.0,
+                     snap.percentileNs(op, 0.99) / 1000.0);
+            out << line << '\n';
+            for (int status = 1; status < OP_STATUS_COUNT; status++) {
+                if (snap.results[op][status] > 0) {
+                    out << "    " << opStatusName((OpStatus)status) << ": " << snap.results[op][status] << '\n';
+                }
+            }
+        }
+        for (const auto& gauge : gaugeSnapshot()) {
+            out << gauge.first << " = " << gauge.second << '\n';
+        }
+    }
+};
+
+// 计时一次操作：构造时取时间，finish 记录结果和耗时并原样返回结果
+class MetricTimer {
+private:
+    MetricOp op;
+    bool active;
+    chrono::steady_clock::time_point start;
+    
+public:
+    explicit MetricTimer(MetricOp o) : op(o), active(Metrics::isEnabled()) {
+        if (active) {
+            start = chrono::steady_clock::now();
+        }
+    }
+    
+    OpStatus finish(OpStatus status) {
+        if (active) {
+            auto ns = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count();
+            Metrics::record(op, status, (uint64_t)ns);
+        }
+        return status;
+    }
+};
+
+// 指标文件输出：后台线程每隔 intervalSeconds 秒写一次（0 表示不定时），
+// 收到 SIGUSR1 时立即写一次，停止时再写最后一次
+class MetricsDumper {
+private:
+    string fileName;
+    int intervalSeconds;
+    thread worker;
+    mutex stopMutex;
+    condition_variable stopCv;
+    bool stopping;
+    
+    static atomic<bool>& dumpRequested() {
+        static atomic<bool> flag(false);
+        return flag;
+    }
+    
+    static void handleSignal(int) {
+        dumpRequested() = true;
+    }
+    
+    void loop() {
+        auto nextDump = chrono::steady_clock::now() + chrono::seconds(intervalSeconds);
+        unique_lock<mutex> lock(stopMutex);
+        while (!stopping) {
+            // 信号处理函数不能通知条件变量，这里按短周期轮询请求标志
+            stopCv.wait_for(lock, chrono::milliseconds(METRICS_SIGNAL_POLL_MS));
+            bool due = intervalSeconds > 0 && chrono::steady_clock::now() >= nextDump;
+            if (stopping || (!due && !dumpRequested().exchange(false))) {
+                continue;
+            }
+            lock.unlock();
+            Metrics::writePrometheusFile(fileName);
+            lock.lock();
+            if (due) {
+                nextDump = chrono::steady_clock::now() + chrono::seconds(intervalSeconds);
+            }
+        }
+    }
+    
+public:
+    MetricsDumper() : intervalSeconds(0), stopping(false) {}
+    
+    ~MetricsDumper() {
+        stop();
+    }
+    
+    MetricsDumper(const MetricsDumper&) = delete;
+    MetricsDumper& operator=(const MetricsDumper&) = delete;
+    
+    void start(const string& file, int interval) {
+        fileName = file;
+        intervalSeconds = max(0, interval);
+        stopping = false;
+#ifndef _WIN32
+        signal(SIGUSR1, handleSignal);
+#endif
+        worker = thread(&MetricsDumper::loop, this);
+    }
+    
+    void stop() {
+        if (!worker.joinable()) {
+            return;
+        }
+        {
+            lock_guard<mutex> lock(stopMutex);
+            stopping = true;
+        }
+        stopCv.notify_all();
+        worker.join();
+        Metrics::writePrometheusFile(fileName);
+    }
+    
+    bool isRunning() const {
+        return worker.joinable();
+    }
+    
+    const string& getFileName() const {
+        return fileName;
+    }
+};
+
+class FileManager {
+public:
+    static AccountTable loadAccounts() {
+        AccountTable accounts;
+        readAccountsFile(ACCOUNTS_FILE, accounts);
+        
+        // 重放检查点之后提交的变更
+        AccountJournal journal;
+        AccountJournal::replay(journal.getRotatedFileName(), accounts);
+        AccountJournal::replay(journal.getFileName(), accounts);
+        
+        return accounts;
+    }
+    
+    // 映射账户文件，按行切段并行解析，再按段顺序合并，同一账号后出现的覆盖先出现的
+    static bool readAccountsFile(const string& fileName, AccountTable& accounts) {
+        MappedTextFile file;
+        if (!file.open(fileName)) {
+            return false;
+        }
+        string_view text = file.view();
+        vector<string_view> chunks = splitLineChunks(text, parseChunkCount(text.size()));
+        if (chunks.size() <= 1) {
+            forEachLine(text, [&accounts](string_view line) {
+                accounts.upsert(Account::fromFileString(line));
+            });
+            return true;
+        }
+        vector<vector<Account>> parsed(chunks.size());
+        
+        forEachChunk(chunks, [&parsed](size_t index, string_view chunk) {
+            vector<Account>& out = parsed[index];
+            out.reserve(chunk.size() / ESTIMATED_ACCOUNT_LINE_BYTES);
+            forEachLine(chunk, [&out](string_view line) {
+                out.push_back(Account::fromFileString(line));
+            });
+        });
+        
+        size_t total = accounts.size();
+        for (const auto& part : parsed) {
+            total += part.size();
+        }
+        accounts.reserve(total);
+        for (auto& part : parsed) {
+            for (Account& account : part) {
+                accounts.upsert(move(account));
+            }
+            vector<Account>().swap(part);
+        }
+        return true;
+    }
+    
+    // 逐行 getline 的串行加载，保留作性能对比基准
+    static bool readAccountsFileSerial(const string& fileName, AccountTable& accounts) {
+        ifstream file(fileName);
+        if (!file.is_open()) {
+            return false;
+        }
+        string line;
+        while (getline(file, line)) {
+            accounts.upsert(Account::fromFileString(line));
+        }
+        return true;
+    }
+    
+    // 交易日志的持久化策略，账户预写日志沿用
+    static DurabilityPolicy transactionLogPolicy(int& intervalMs) {
+        return transactionLogger().getPolicy(intervalMs);
+    }
+    
+    // 保存账户文件，耗时和成败计入 save_accounts 指标
+    static bool saveAccounts(const AccountTable& accounts) {
+        MetricTimer timer(METRIC_SAVE_ACCOUNTS);
+        return timer.finish(writeAccountsFile(accounts) ? OP_OK : OP_FAILED) == OP_OK;
+    }
+    
+    // 交易记录交给后台日志线程写出，返回可用于 waitTransactionDurable 的序号
+    static uint64_t logTransaction(const Transaction& trans) {
+        if (trans.type == "WITHDRAWAL" && withdrawalIndex().isBuilt()) {
+            withdrawalIndex().add(trans.accountNumber, trans.date, trans.amount);
+        }
+        return transactionLogger().enqueue(trans);
+    }
+    
+    // 整批记账，返回最后一条的序号；批内不会有取款，不更新当日取款索引
+    static uint64_t logTransactions(vector<Transaction>& batch) {
+        return transactionLogger().enqueueBatch(batch);
+    }
+    
+    // 全部账户最后一次客户交易的日期键（没有时为 0）的快照
+    static ActivitySnapshot lastActivitySnapshot() {
+        return historyIndex().lastActivities();
+    }
+    
+    static bool waitTransactionDurable(uint64_t seq) {
+        return transactionLogger().waitDurable(seq);
+    }
+    
+    static bool transactionLogHealthy() {
+        return transactionLogger().healthy();
+    }
+    
+    static void setTransactionLogPolicy(DurabilityPolicy policy, int intervalMs = DEFAULT_LOG_SYNC_INTERVAL_MS) {
+        transactionLogger().setPolicy(policy, intervalMs);
+    }
+    
+    static void setTransactionLogEnabled(bool enabled) {
+        transactionLogger().setEnabled(enabled);
+    }
+    
+    // 选择交易日志格式，需在第一条记录写入前设置；二进制日志写入 transactions.bin
+    static void setTransactionLogFormat(LogFormat format) {
+        transactionLogFormat() = format;
+        transactionLogger().setFormat(format, transactionLogFile());
+    }
+    
+    // 当前格式对应的交易文件名
+    static const string& transactionLogFile() {
+        return transactionLogFormat() == LOG_FORMAT_BINARY ? TRANSACTIONS_BINARY_FILE : TRANSACTIONS_FILE;
+    }
+    
+    // 写出所有排队的交易记录
+    static void flushTransactionLog() {
+        transactionLogger().stop();
+    }
+    
+    // 扫描一遍交易文件，同时建立当日取款索引和账户历史索引
+    static void buildTransactionIndexes() {
+        withdrawalIndex().reset();
+        historyIndex().reset();
+        if (transactionLogFormat() == LOG_FORMAT_BINARY) {
+            scanBinaryTransactionsFile(TRANSACTIONS_BINARY_FILE, withdrawalIndex(), historyIndex());
+        } else {
+            scanTransactionsFile(TRANSACTIONS_FILE, withdrawalIndex(), historyIndex());
+        }
+    }
+    
+    // 顺序扫描二进制交易日志建立索引；记录定长解码、不切分文本，单线程即可跑满磁盘
+    static bool scanBinaryTransactionsFile(const string& fileName, WithdrawalIndex& withdrawals,
+                                           TransactionHistoryIndex& history) {
+        TransactionLogReader reader;
+        if (!reader.open(fileName)) {
+            return false;
+        }
+        string today = currentDateString();
+        int todayKey = dateKey(today);
+        
+        // 记录按时间顺序写入，缓存当前记录所在自然日的起止秒数和日期键，跨日时才重新换算
+        int64_t dayStart = 1, dayEnd = 0;
+        int key = -1;
+        TransactionLogEntry entry;
+        uint64_t offset;
+        while (reader.next(entry, offset)) {
+            if (entry.type == TXN_BALANCE_QUERY) {
+                continue;
+            }
+            if (entry.timestamp < dayStart || entry.timestamp >= dayEnd) {
+                tm day = localTimeOf((time_t)entry.timestamp);
+                key = (day.tm_year + 1900) * 10000 + (day.tm_mon + 1) * 100 + day.tm_mday;
+                day.tm_hour = day.tm_min = day.tm_sec = 0;
+                day.tm_isdst = -1;
+                dayStart = mktime(&day);
+                day.tm_mday++;
+                day.tm_isdst = -1;
+                dayEnd = mktime(&day);
+            }
+            
+            string accountNumber = entry.accountNumber();
+            if (entry.type == TXN_WITHDRAWAL && key == todayKey) {
+                withdrawals.add(accountNumber, today, Money::fromFen(entry.amountFen));
+            }
+            history.addPosting(accountNumber, entry.targetAccount(), offset, key,
+                               entry.type == TXN_INTEREST || entry.type == TXN_FEE);
+        }
+        return true;
+    }
+    
+    // 映射交易文件并行扫描，每段建立局部索引后按段顺序合并，结果与串行扫描相同
+    static bool scanTransactionsFile(const string& fileName, WithdrawalIndex& withdrawals,
+                                     TransactionHistoryIndex& history) {
+        MappedTextFile file;
+        if (!file.open(fileName)) {
+            return false;
+        }
+        string_view text = file.view();
+        vector<string_view> chunks = splitLineChunks(text, parseChunkCount(text.size()));
+        vector<WithdrawalIndex> partialWithdrawals(chunks.size());
+        vector<TransactionHistoryIndex> partialHistory(chunks.size());
+        
+        forEachChunk(chunks, [&](size_t index, string_view chunk) {
+            WithdrawalIndex& localWithdrawals = partialWithdrawals[index];
+            TransactionHistoryIndex& localHistory = partialHistory[index];
+            localWithdrawals.reset();
+            localHistory.reset();
+            forEachLine(chunk, [&](string_view line) {
+                localWithdrawals.indexLine(line);
+                localHistory.indexLine(line, line.data() - text.data());
+            });
+        });
+        
+        for (size_t i = 0; i < chunks.size(); i++) {
+            withdrawals.merge(partialWithdrawals[i]);
+            history.append(partialHistory[i]);
+        }
+        return true;
+    }
+    
+    // 逐行 getline 的串行扫描，保留作性能对比基准
+    static bool scanTransactionsFileSerial(const string& fileName, WithdrawalIndex& withdrawals,
+                                           TransactionHistoryIndex& history) {
+        ifstream file(fileName, ios::binary);
+        if (!file.is_open()) {
+            return false;
+        }
+        string line;
+        uint64_t offset = 0;
+        Transaction trans;
+        while (getline(file, line)) {
+            withdrawals.indexLine(line);
+            if (Transaction::fromLogLine(line, trans)) {
+                history.add(trans, offset);
+            }
+            offset += line.size() + 1;
+        }
+        return true;
+    }
+    
+    // 账户最近 n 笔交易，从新到旧
+    static vector<Transaction> recentTransactions(const string& accountNumber, size_t n) {
+        transactionLogger().waitWritten();
+        return readTransactions(historyIndex().recent(accountNumber, n));
+    }
+    
+    // 账户在日期区间内的交易，从旧到新
+    static vector<Transaction> transactionsBetween(const string& accountNumber, int fromKey, int toKey) {
+        transactionLogger().waitWritten();
+        return readTransactions(historyIndex().between(accountNumber, fromKey, toKey));
+    }
+    
+    static Money getTodayWithdrawalTotal(const string& accountNumber) {
+        MetricTimer timer(METRIC_TODAY_WITHDRAWAL);
+        WithdrawalIndex& index = withdrawalIndex();
+        if (!index.isBuilt()) {
+            buildTransactionIndexes();
+        }
+        Money total = index.get(accountNumber);
+        timer.finish(OP_OK);
+        return total;
+    }
+    
+    static bool isAccountLocked(const string& accountNumber) {
+        return lockedAccounts().contains(accountNumber);
+    }
+    
+    static void lockAccount(const string& accountNumber) {
+        lockedAccounts().lock(accountNumber);
+    }
+    
+    static bool unlockAccount(const string& accountNumber) {
+        return lockedAccounts().unlock(accountNumber);
+    }
+    
+private:
+    // 先写临时文件再改名，避免写到一半时留下残缺的账户文件
+    static bool writeAccountsFile(const AccountTable& accounts) {
+        string tempFile = ACCOUNTS_FILE + ".tmp";
+        ofstream file(tempFile);
+        
+        if (!file.is_open()) {
+            return false;
+        }
+        
+        for (const Account& acc : accounts) {
+            file << acc.toFileString() << '\n';
+        }
+        
+        file.close();
+        if (!file) {
+            return false;
+        }
+        
+        return replaceFile(tempFile, ACCOUNTS_FILE);
+    }
+    
+    static WithdrawalIndex& withdrawalIndex() {
+        static WithdrawalIndex index;
+        return index;
+    }
+    
+    static LockedAccountSet& lockedAccounts() {
+        static LockedAccountSet accounts;
+        static once_flag loaded;
+        call_once(loaded, [] {
+            accounts.load();
+        });
+        return accounts;
+    }
+    
+    static TransactionHistoryIndex& historyIndex() {
+        static TransactionHistoryIndex index;
+        return index;
+    }
+    
+    static LogFormat& transactionLogFormat() {
+        static LogFormat format = LOG_FORMAT_CSV;
+        return format;
+    }
+    
+    static TransactionLogger& transactionLogger() {
+        static TransactionLogger logger;
+        static once_flag hookInstalled;
+        call_once(hookInstalled, [] {
+            logger.setWriteHook([](const Transaction& trans, uint64_t offset) {
+                historyIndex().add(trans, offset);
+            });
+        });
+        return logger;
+    }
+    
+    // 按偏移读取交易记录
+    static vector<Transaction> readTransactions(const vector<uint64_t>& offsets) {
+        vector<Transaction> result;
+        if (transactionLogFormat() == LOG_FORMAT_BINARY) {
+            TransactionLogReader reader;
+            reader.open(TRANSACTIONS_BINARY_FILE);
+            TransactionLogEntry entry;
+            Transaction trans;
+            for (uint64_t offset : offsets) {
+                if (reader.readAt(offset, entry)) {
+                    entry.toTransaction(trans);
+                    result.push_back(trans);
+                }
+            }
+            return result;
+        }
+        
+        ifstream file(TRANSACTIONS_FILE, ios::binary);
+        string line;
+        Transaction trans;
+        for (uint64_t offset : offsets) {
+            file.clear();
+            file.seekg(offset);
+            if (getline(file, line) && Transaction::fromLogLine(line, trans)) {
+                result.push_back(trans);
+            }
+        }
+        return result;
+    }
+};
+
+// 二进制账户文件：文件头 + 按账号排序的定长记录
+// 余额以分为单位存为 int64，避免浮点解析
+const char ACCOUNT_STORE_MAGIC[8] = {'A', 'T', 'M', 'A', 'C', 'C', 'T', '1'};
+const uint32_t ACCOUNT_STORE_VERSION = 1;
+const int ACCOUNT_NAME_CAPACITY = 50;
+
+struct AccountStoreHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t recordSize;
+    uint64_t count;
+};
+
+struct AccountRecord {
+    int64_t balanceFen;
+    char accountNumber[ACCOUNT_NUMBER_LENGTH + 1];
+    char idCard[ID_CARD_LENGTH + 1];
+    char password[PASSWORD_LENGTH + 1];
+    char name[ACCOUNT_NAME_CAPACITY];
+};
+
+static_assert(sizeof(AccountStoreHeader) == 24, "unexpected header layout");
+static_assert(sizeof(AccountRecord) == 104, "unexpected record layout");
+
+class MappedAccountStore {
+private:
+    int fd;
+    char* base;
+    size_t length;
+    AccountRecord* records;
+    uint64_t count;
+    
+    static void copyField(char* dest, size_t capacity, const string& value) {
+        memset(dest, 0, capacity);
+        memcpy(dest, value.data(), min(value.size(), capacity - 1));
+    }
+    
+public:
+    MappedAccountStore() : fd(-1), base(nullptr), length(0), records(nullptr), count(0) {}
+    
+    ~MappedAccountStore() {
+        close();
+    }
+    
+    MappedAccountStore(const MappedAccountStore&) = delete;
+    MappedAccountStore& operator=(const MappedAccountStore&) = delete;
+    
+    bool isOpen() const { return base != nullptr; }
+    uint64_t size() const { return count; }
+    
+    // 映射文件，不解析任何记录
+    bool open(const string& fileName) {
+#ifdef _WIN32
+        (void)fileName;
+        return false;
+#else
+        close();
+        fd = ::open(fileName.c_str(), O_RDWR);
+        if (fd < 0) {
+            return false;
+        }
+        
+        struct stat st;
+        if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(AccountStoreHeader)) {
+            close();
+            return false;
+        }
+        
+        length = st.st_size;
+        void* mapped = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (mapped == MAP_FAILED) {
+            close();
+            return false;
+        }
+        base = static_cast<char*>(mapped);
+        
+        const AccountStoreHeader* header = reinterpret_cast<const AccountStoreHeader*>(base);
+        if (memcmp(header->magic, ACCOUNT_STORE_MAGIC, sizeof(header->magic)) != 0 ||
+            header->version != ACCOUNT_STORE_VERSION ||
+            header->recordSize != sizeof(AccountRecord) ||
+            sizeof(AccountStoreHeader) + header->count * sizeof(AccountRecord) > length) {
+            close();
+            return false;
+        }
+        
+        count = header->count;
+        records = reinterpret_cast<AccountRecord*>(base + sizeof(AccountStoreHeader));
+        return true;
+#endif
+    }
+    
+    void close() {
+#ifndef _WIN32
+        if (base) {
+            munmap(base, length);
+        }
+        if (fd >= 0) {
+            ::close(fd);
+        }
+#endif
+        fd = -1;
+        base = nullptr;
+        length = 0;
+        records = nullptr;
+        count = 0;
+    }
+    
+    // 按账号二分查找，记录按账号有序
+    AccountRecord* find(const string& accountNumber) {
+        if (!records || accountNumber.size() != (size_t)ACCOUNT_NUMBER_LENGTH) {
+            return nullptr;
+        }
+        
+        uint64_t lo = 0, hi = count;
+        while (lo < hi) {
+            uint64_t mid = lo + (hi - lo) / 2;
+            int cmp = memcmp(records[mid].accountNumber, accountNumber.data(), ACCOUNT_NUMBER_LENGTH);
+            if (cmp == 0) {
+                return &records[mid];
+            }
+            if (cmp < 0) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        return nullptr;
+    }
+    
+    static Account toAccount(const AccountRecord& record) {
+        return Account(record.accountNumber, record.name, record.idCard, record.password,
+                       Money::fromFen(record.balanceFen));
+    }
+    
+    // 原地写回余额和密码，只弄脏所在的页
+    static void update(AccountRecord& record, const Account& account) {
+        record.balanceFen = account.getBalance().toFen();
+        copyField(record.password, sizeof(record.password), account.getPassword());
+    }
+    
+    // 将脏页刷回磁盘
+    bool flush() {
+#ifdef _WIN32
+        return false;
+#else
+        return base && msync(base, length, MS_SYNC) == 0;
+#endif
+    }
+    
+    // 写出二进制账户文件，记录按账号排序；先写临时文件，落盘后改名覆盖，写到一半崩溃不会损坏已有的文件
+    static bool write(const string& fileName, const AccountTable& accounts) {
+        vector<const Account*> sorted;
+        sorted.reserve(accounts.size());
+        for (const Account& acc : accounts) {
+            sorted.push_back(&acc);
+        }
+        sort(sorted.begin(), sorted.end(), [](const Account* a, const Account* b) {
+            return a->getAccountNumber() < b->getAccountNumber();
+        });
+        
+        string tempFile = fileName + ".tmp";
+        ofstream out(tempFile, ios::binary | ios::trunc);
+        if (!out.is_open()) {
+            return false;
+        }
+        
+        AccountStoreHeader header;
+        memcpy(header.magic, ACCOUNT_STORE_MAGIC, sizeof(header.magic));
+        header.version = ACCOUNT_STORE_VERSION;
+        header.recordSize = sizeof(AccountRecord);
+        header.count = accounts.size();
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        
+        for (const Account* account : sorted) {
+            const Account& acc = *account;
+            AccountRecord record;
+            record.balanceFen = acc.getBalance().toFen();
+            copyField(record.accountNumber, sizeof(record.accountNumber), acc.getAccountNumber());
+            copyField(record.idCard, sizeof(record.idCard), acc.getIdCard());
+            copyField(record.password, sizeof(record.password), acc.getPassword());
+            copyField(record.name, sizeof(record.name), acc.getName());
+            out.write(reinterpret_cast<const char*>(&record), sizeof(record));
+        }
+        
+        out.close();
+        if (!out) {
+            return false;
+        }
+        return replaceFile(tempFile, fileName);
+    }
+    
+    // 从 CSV 账户文件转换
+    static bool convertFromCsv(const string& csvFile, const string& binaryFile) {
+        AccountTable accounts;
+        ifstream in(csvFile);
+        if (!in.is_open()) {
+            return false;
+        }
+        
+        string line;
+        while (getline(in, line)) {
+            if (line.empty()) continue;
+            Account acc = Account::fromFileString(line);
+            if (acc.getAccountNumber().size() != (size_t)ACCOUNT_NUMBER_LENGTH) {
+                cerr << "Skipping record with invalid account number: " << acc.getAccountNumber() << endl;
+                continue;
+            }
+            if (acc.getName().size() >= (size_t)ACCOUNT_NAME_CAPACITY) {
+                cerr << "Name truncated for account " << acc.getAccountNumber() << endl;
+            }
+            accounts.upsert(acc);
+        }
+        
+        return write(binaryFile, accounts);
+    }
+};
+
+// 按需加载的 CSV 账户文件：启动时只建立 账号 -> 行偏移 的紧凑索引，账户在首次访问时才解析
+// 保存时只写脏账户的行（原地覆盖或追加），文件格式与 accounts.dat 相同，同一账号可能出现多次，以最后一行为准
+// 写账户文件前先把这些行完整写进重做文件（accounts.dat.redo）并落盘，写完再清空；
+// 中途崩溃时账户文件里可能有写了一半的行，下次打开时按重做文件重写这些行。重做文件里是完整的账户记录，
+// 重复补写无害，因此清空后不必 fsync
+class LazyAccountFile {
+private:
+    struct Location {
+        uint64_t offset;
+        uint32_t length;  // 不含换行符
+    };
+    
+    struct Entry {
+        uint64_t key;
+        Location location;
+    };
+    
+    string fileName;
+    // 按压缩账号排序，二分查找
+    vector<Entry> entries;
+    // 不是 19 位数字的账号
+    unordered_map<string, Location> irregular;
+    bool trailingNewline;
+    uint64_t fileSize;
+    // 已被追加的新行取代、不再被索引引用的字节数
+    uint64_t garbage;
+    ifstream reader;
+    
+    Location* locate(string_view accountNumber) {
+        uint64_t key;
+        if (AccountTable::packAccountNumber(accountNumber, key)) {
+            auto it = lower_bound(entries.begin(), entries.end(), key,
+                                  [](const Entry& e, uint64_t k) { return e.key < k; });
+            return it != entries.end() && it->key == key ? &it->location : nullptr;
+        }
+        auto it = irregular.find(string(accountNumber));
+        return it == irregular.end() ? nullptr : &it->second;
+    }
+    
+    void addLocation(string_view accountNumber, Location location) {
+        uint64_t key;
+        if (AccountTable::packAccountNumber(accountNumber, key)) {
+            entries.push_back(Entry{key, location});
+        } else {
+            irregular[string(accountNumber)] = location;
+        }
+    }
+    
+    // 新账户插入已排序的索引
+    void insertLocation(string_view accountNumber, Location location) {
+        uint64_t key;
+        if (AccountTable::packAccountNumber(accountNumber, key)) {
+            auto it = lower_bound(entries.begin(), entries.end(), key,
+                                  [](const Entry& e, uint64_t k) { return e.key < k; });
+            entries.insert(it, Entry{key, location});
+        } else {
+            irregular[string(accountNumber)] = location;
+        }
+    }
+    
+    // 同一账号出现多次时保留最后一行，与全量加载时后者覆盖前者一致
+    void sortEntries() {
+        stable_sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) { return a.key < b.key; });
+        size_t kept = 0;
+        for (size_t i = 0; i < entries.size(); i++) {
+            if (i + 1 < entries.size() && entries[i + 1].key == entries[i].key) {
+                continue;
+            }
+            entries[kept++] = entries[i];
+        }
+        entries.resize(kept);
+    }
+    
+    // 扫描账户文件建立索引；dropTornTail 时（崩溃后恢复）没有换行结尾的最后一行是没写完的追加，不入索引并截掉
+    void buildIndex(bool dropTornTail) {
+        entries.clear();
+        irregular.clear();
+        trailingNewline = true;
+        
+        ifstream file(fileName, ios::binary);
+        string line;
+        uint64_t offset = 0;
+        bool torn = false;
+        while (getline(file, line)) {
+            trailingNewline = !file.eof();
+            if (dropTornTail && !trailingNewline) {
+                torn = !line.empty();
+                trailingNewline = true;
+                break;
+            }
+            if (!line.empty()) {
+                addLocation(string_view(line).substr(0, line.find(',')), Location{offset, (uint32_t)line.size()});
+            }
+            offset += line.size() + (trailingNewline ? 1 : 0);
+        }
+        file.close();
+        if (torn) {
+            error_code error;
+            filesystem::resize_file(fileName, offset, error);
+        }
+        sortEntries();
+        fileSize = offset;
+        uint64_t used = 0;
+        for (const Entry& entry : entries) {
+            used += entry.location.length + 1;
+        }
+        for (const auto& item : irregular) {
+            used += item.second.length + 1;
+        }
+        garbage = fileSize > used ? fileSize - used : 0;
+        
+        reader.close();
+        reader.clear();
+        reader.open(fileName, ios::binary);
+    }
+    
+    // 只写 dirty 中账户的行：长度不变的行原地覆盖，其余追加到文件末尾并就地更新索引，
+    // 旧行成为废弃数据（加载时同一账号以最后一行为准）；写完 fsync
+    bool apply(const AccountTable& cache, const unordered_set<string>& dirty) {
+        if (!filesystem::exists(fileName)) {
+            ofstream(fileName, ios::binary);
+        }
+        fstream out(fileName, ios::in | ios::out | ios::binary);
+        if (!out.is_open()) {
+            return false;
+        }
+        
+        string line;
+        for (const string& accountNumber : dirty) {
+            const Account* account = cache.find(accountNumber);
+            if (!account) {
+                continue;
+            }
+            line = account->toFileString();
+            Location* location = locate(accountNumber);
+            if (location && location->length == line.size()) {
+                out.seekp(location->offset);
+                out << line;
+                continue;
+            }
+            
+            out.seekp(fileSize);
+            if (!trailingNewline) {
+                out << '\n';
+                fileSize++;
+                trailingNewline = true;
+            }
+            out << line << '\n';
+            Location appended{fileSize, (uint32_t)line.size()};
+            fileSize += line.size() + 1;
+            if (location) {
+                garbage += location->length + 1;
+                *location = appended;
+            } else {
+                insertLocation(accountNumber, appended);
+            }
+        }
+        
+        out.close();
+        if (!out || !syncFileByName(fileName)) {
+            // 写到一半失败，索引可能已指向没写成功的位置，按文件实际内容重建
+            buildIndex(false);
+            return false;
+        }
+        if (!reader.is_open()) {
+            reader.clear();
+            reader.open(fileName, ios::binary);
+        }
+        return true;
+    }
+    
+    // 只保留索引引用的行，按原顺序写入临时文件后替换账户文件，再重新建立索引
+    bool compact() {
+        vector<Location> live;
+        live.reserve(size());
+        for (const Entry& entry : entries) {
+            live.push_back(entry.location);
+        }
+        for (const auto& item : irregular) {
+            live.push_back(item.second);
+        }
+        sort(live.begin(), live.end(), [](const Location& a, const Location& b) { return a.offset < b.offset; });
+        
+        string tempFile = fileName + ".tmp";
+        ofstream out(tempFile, ios::binary);
+        if (!out.is_open()) {
+            return false;
+        }
+        string line;
+        for (const Location& location : live) {
+            line.resize(location.length);
+            reader.clear();
+            reader.seekg(location.offset);
+            if (!reader.read(&line[0], location.length)) {
+                return false;
+            }
+            out << line << '\n';
+        }
+        out.close();
+        if (!out || !replaceFile(tempFile, fileName)) {
+            return false;
+        }
+        open();
+        return true;
+    }
+    
+public:
+    explicit LazyAccountFile(const string& name = ACCOUNTS_FILE)
+        : fileName(name), trailingNewline(true), fileSize(0), garbage(0) {}
+    
+    size_t size() const { return entries.size() + irregular.size(); }
+    bool empty() const { return size() == 0; }
+    
+    // 扫描账户文件建立索引，每行只切出账号字段；留有重做文件时先补写上次没写完的行
+    void open() {
+        string redo = getRedoFileName();
+        error_code error;
+        bool recovering = filesystem::file_size(redo, error) > 0 && !error;
+        buildIndex(recovering);
+        if (!recovering) {
+            return;
+        }
+        AccountTable pending;
+        AccountJournal::replay(redo, pending);
+        unordered_set<string> dirty;
+        for (const Account& account : pending) {
+            dirty.insert(account.getAccountNumber());
+        }
+        if (apply(pending, dirty)) {
+            filesystem::resize_file(redo, 0, error);
+        }
+    }
+    
+    string getRedoFileName() const { return fileName + ".redo"; }
+    
+    // 按偏移读出一行并解析
+    bool read(string_view accountNumber, Account& account) {
+        Location* location = locate(accountNumber);
+        if (!location) {
+            return false;
+        }
+        string line(location->length, '\0');
+        reader.clear();
+        reader.seekg(location->offset);
+        if (!reader.read(&line[0], location->length)) {
+            return false;
+        }
+        account = Account::fromFileString(line);
+        return true;
+    }
+    
+    // 把 dirty 中的账户（取自 cache）写回：先写重做文件并落盘，再写账户文件，完成后清空重做文件
+    // 写账户文件失败时保留重做文件，下次打开时补写；废弃数据超过文件一半时整理一次，整理的代价分摊到多次写回上
+    bool save(const AccountTable& cache, const unordered_set<string>& dirty) {
+        // 最后一行没有换行时先补上，恢复时没有换行结尾的最后一行就只可能是没写完的追加
+        if (!trailingNewline) {
+            ofstream out(fileName, ios::binary | ios::app);
+            out << '\n';
+            out.close();
+            if (!out || !syncFileByName(fileName)) {
+                return false;
+            }
+            fileSize++;
+            trailingNewline = true;
+        }
+        
+        // 重做文件没写完整时账户文件还没动过，重放时只会用到其中完整的记录
+        string redo = getRedoFileName();
+        bool created = !filesystem::exists(redo);
+        {
+            ofstream out(redo, ios::binary | ios::trunc);
+            if (!out.is_open()) {
+                return false;
+            }
+            for (const string& accountNumber : dirty) {
+                const Account* account = cache.find(accountNumber);
+                if (account) {
+                    out << account->toFileString() << ";\n";
+                }
+            }
+            out.close();
+            if (!out || !syncFileByName(redo) || (created && !syncParentDirectory(redo))) {
+                return false;
+            }
+        }
+        if (!apply(cache, dirty)) {
+            return false;
+        }
+        error_code error;
+        filesystem::resize_file(redo, 0, error);
+        if (garbage > fileSize / 2) {
+            return compact();
+        }
+        return true;
+    }
+};
+
+// 账户二级索引：身份证号哈希索引（一个身份证号可以开多个账户）和按姓名排序的前缀索引
+// 标准身份证号（17 位数字加校验位）压缩为整数放进开放寻址表，同一个键可以占多个槽位，查找时收集探测链上的全部同键槽位；
+// 其余格式走 unordered_multimap
+// 姓名索引是按姓名（ASCII 字母不区分大小写）排序的数组，每项带姓名前 16 个字节拼成的两个整数，
+// 不超过 15 个字节的姓名完全由整数表示，排序和前缀定位大多不必访问账户本身；
+// 建好之后新增的账户先放进未排序的待合并区，满 NAME_INDEX_PENDING_MAX 条再归并进数组
+// 索引只保存账户指针（账户表中的地址不变），修改和查询由调用方串行化
+class AccountIndex {
+private:
+    static const uint64_t EMPTY_KEY = UINT64_MAX;
+    
+    // 同一个身份证号至多占 ID_SLOTS_PER_KEY 个槽位，再多的账户放在 duplicateIds，
+    // 大量账户共用同一个身份证号（如占位号码）时探测链不会变长
+    static const size_t ID_SLOTS_PER_KEY = 8;
+    
+    struct IdSlot {
+        uint64_t key;
+        Account* account;  // 删除后置空，槽位保留以免截断探测链
+    };
+    
+    // head、tail 为姓名前 16 个字节（折叠大小写）按大端拼成的整数，不足补 0，整数顺序与姓名的字典序一致
+    struct NameEntry {
+        uint64_t head;
+        uint64_t tail;
+        Account* account;
+    };
+    
+    vector<IdSlot> idSlots;
+    size_t idMask;
+    size_t idUsed;  // 已占用的槽位，含删除留下的空槽
+    unordered_multimap<uint64_t, Account*> duplicateIds;
+    unordered_multimap<string, Account*> irregularIds;
+    
+    vector<NameEntry> names;
+    vector<NameEntry> pendingNames;
+    
+    static char foldChar(char c) {
+        return c >= 'A' && c <= 'Z' ? c - 'A' + 'a' : c;
+    }
+    
+    static uint64_t packNameBytes(string_view name, size_t from) {
+        uint64_t key = 0;
+        for (size_t i = from; i < from + 8; i++) {
+            key = key << 8 | (i < name.size() ? (unsigned char)foldChar(name[i]) : 0);
+        }
+        return key;
+    }
+    
+    static NameEntry nameEntry(Account* account) {
+        const string& name = account->getName();
+        return NameEntry{packNameBytes(name, 0), packNameBytes(name, 8), account};
+    }
+    
+    static bool keyLess(const NameEntry& a, const NameEntry& b) {
+        return a.head != b.head ? a.head < b.head : a.tail < b.tail;
+    }
+    
+    static int compareFolded(string_view a, string_view b) {
+        size_t n = min(a.size(), b.size());
+        for (size_t i = 0; i < n; i++) {
+            unsigned char x = foldChar(a[i]), y = foldChar(b[i]);
+            if (x != y) {
+                return x < y ? -1 : 1;
+            }
+        }
+        return a.size() < b.size() ? -1 : (a.size() > b.size() ? 1 : 0);
+    }
+    
+    static bool startsWithFolded(string_view name, string_view prefix) {
+        return name.size() >= prefix.size() && compareFolded(name.substr(0, prefix.size()), prefix) == 0;
+    }
+    
+    // 同名账户按地址排序，删除时能精确定位到某一项
+    // 整数键相同且最后一个字节为 0 时两个姓名都不超过 15 个字节且相同，不必再比较全名
+    static bool nameLess(const NameEntry& a, const NameEntry& b) {
+        if (a.head != b.head || a.tail != b.tail) {
+            return keyLess(a, b);
+        }
+        int order = (a.tail & 0xFF) == 0 ? 0 : compareFolded(a.account->getName(), b.account->getName());
+        return order != 0 ? order < 0 : a.account < b.account;
+    }
+    
+    void rehashIds(size_t capacity) {
+        vector<IdSlot> old;
+        old.swap(idSlots);
+        idSlots.assign(capacity, IdSlot{EMPTY_KEY, nullptr});
+        idMask = capacity - 1;
+        idUsed = 0;
+        unordered_multimap<uint64_t, Account*> duplicates;
+        duplicates.swap(duplicateIds);
+        for (const IdSlot& slot : old) {
+            if (slot.account) {
+                insertId(slot.key, slot.account);
+            }
+        }
+        for (const auto& entry : duplicates) {
+            insertId(entry.first, entry.second);
+        }
+    }
+    
+    // 优先复用同号删除留下的空槽，同号槽位已满时放入 duplicateIds
+    void insertId(uint64_t key, Account* account) {
+        size_t pos = AccountTable::hashKey(key) & idMask;
+        size_t sameKey = 0;
+        for (; idSlots[pos].key != EMPTY_KEY; pos = (pos + 1) & idMask) {
+            if (idSlots[pos].key == key) {
+                if (!idSlots[pos].account) {
+                    idSlots[pos].account = account;
+                    return;
+                }
+                sameKey++;
+            }
+        }
+        if (sameKey >= ID_SLOTS_PER_KEY) {
+            duplicateIds.emplace(key, account);
+            return;
+        }
+        idSlots[pos] = IdSlot{key, account};
+        idUsed++;
+    }
+    
+    void addIdCard(Account* account) {
+        uint64_t key;
+        if (!packIdCard(account->getIdCard(), key)) {
+            irregularIds.emplace(account->getIdCard(), account);
+            return;
+        }
+        // 与账户表相同，负载因子保持在 1/2 以下
+        if ((idUsed + 1) * 2 > idSlots.size()) {
+            rehashIds(idSlots.size() * 2);
+        }
+        insertId(key, account);
+    }
+    
+    void removeIdCard(Account* account) {
+        uint64_t key;
+        if (!packIdCard(account->getIdCard(), key)) {
+            auto range = irregularIds.equal_range(account->getIdCard());
+            for (auto it = range.first; it != range.second; ++it) {
+                if (it->second == account) {
+                    irregularIds.erase(it);
+                    return;
+                }
+            }
+            return;
+        }
+        for (size_t pos = AccountTable::hashKey(key) & idMask; idSlots[pos].key != EMPTY_KEY; pos = (pos + 1) & idMask) {
+            if (idSlots[pos].key == key && idSlots[pos].account == account) {
+                idSlots[pos].account = nullptr;
+                return;
+            }
+        }
+        auto range = duplicateIds.equal_range(key);
+        for (auto it = range.first; it != range.second; ++it) {
+            if (it->second == account) {
+                duplicateIds.erase(it);
+                return;
+            }
+        }
+    }
+    
+    void mergePendingNames() {
+        sort(pendingNames.begin(), pendingNames.end(), nameLess);
+        size_t middle = names.size();
+        names.insert(names.end(), pendingNames.begin(), pendingNames.end());
+        inplace_merge(names.begin(), names.begin() + middle, names.end(), nameLess);
+        pendingNames.clear();
+    }
+    
+    // 分段并行排序，再逐轮两两归并
+    void sortNames() {
+        size_t parts = names.size() < PARALLEL_INDEX_MIN_ACCOUNTS ? 1 : max(1u, thread::hardware_concurrency());
+        vector<pair<size_t, size_t>> ranges(max<size_t>(1, min(parts, names.size())));
+        forEachRange(names.size(), parts, [&](size_t index, size_t from, size_t to) {
+            sort(names.begin() + from, names.begin() + to, nameLess);
+            ranges[index] = make_pair(from, to);
+        });
+        while (ranges.size() > 1) {
+            vector<pair<size_t, size_t>> merged;
+            for (size_t i = 0; i + 1 < ranges.size(); i += 2) {
+                inplace_merge(names.begin() + ranges[i].first, names.begin() + ranges[i].second,
+                              names.begin() + ranges[i + 1].second, nameLess);
+                merged.push_back(make_pair(ranges[i].first, ranges[i + 1].second));
+            }
+            if (ranges.size() % 2 == 1) {
+                merged.push_back(ranges.back());
+            }
+            ranges.swap(merged);
+        }
+    }
+    
+public:
+    AccountIndex() : idSlots(16, IdSlot{EMPTY_KEY, nullptr}), idMask(15), idUsed(0) {}
+    
+    // 18 位身份证号（17 位数字加校验位 0-9 或 X）压缩为整数，(10^17 - 1) * 11 + 10 小于 2^64
+    static bool packIdCard(string_view idCard, uint64_t& key) {
+        if (idCard.size() != (size_t)ID_CARD_LENGTH) {
+            return false;
+        }
+        key = 0;
+        for (size_t i = 0; i + 1 < idCard.size(); i++) {
+            if (idCard[i] < '0' || idCard[i] > '9') {
+                return false;
+            }
+            key = key * 10 + (idCard[i] - '0');
+        }
+        char check = idCard.back();
+        if (check >= '0' && check <= '9') {
+            key = key * 11 + (check - '0');
+        } else if (check == 'X' || check == 'x') {
+            key = key * 11 + 10;
+        } else {
+            return false;
+        }
+        return true;
+    }
+    
+    void clear() {
+        idSlots.assign(16, IdSlot{EMPTY_KEY, nullptr});
+        idMask = 15;
+        idUsed = 0;
+        duplicateIds.clear();
+        irregularIds.clear();
+        names.clear();
+        pendingNames.clear();
+    }
+    
+    // 为账户表中的全部账户重建索引
+    void build(AccountTable& accounts) {
+        clear();
+        size_t capacity = 16;
+        while (capacity < accounts.size() * 2) {
+            capacity *= 2;
+        }
+        rehashIds(capacity);
+        names.reserve(accounts.size());
+        for (Account& account : accounts) {
+            addIdCard(&account);
+            names.push_back(nameEntry(&account));
+        }
+        sortNames();
+    }
+    
+    void add(Account* account) {
+        addIdCard(account);
+        pendingNames.push_back(nameEntry(account));
+        if (pendingNames.size() >= NAME_INDEX_PENDING_MAX) {
+            mergePendingNames();
+        }
+    }
+    
+    // 姓名或身份证号修改之前先移除，修改后再 add
+    void remove(Account* account) {
+        removeIdCard(account);
+        for (size_t i = 0; i < pendingNames.size(); i++) {
+            if (pendingNames[i].account == account) {
+                pendingNames.erase(pendingNames.begin() + i);
+                return;
+            }
+        }
+        auto it = lower_bound(names.begin(), names.end(), nameEntry(account), nameLess);
+        if (it != names.end() && it->account == account) {
+            names.erase(it);
+        }
+    }
+    
+    void findByIdCard(string_view idCard, vector<Account*>& result) const {
+        uint64_t key;
+        if (!packIdCard(idCard, key)) {
+            auto range = irregularIds.equal_range(string(idCard));
+            for (auto it = range.first; it != range.second; ++it) {
+                result.push_back(it->second);
+            }
+            return;
+        }
+        size_t sameKey = 0;
+        for (size_t pos = AccountTable::hashKey(key) & idMask; idSlots[pos].key != EMPTY_KEY; pos = (pos + 1) & idMask) {
+            if (idSlots[pos].key == key) {
+                sameKey++;
+                if (idSlots[pos].account) {
+                    result.push_back(idSlots[pos].account);
+                }
+            }
+        }
+        if (sameKey >= ID_SLOTS_PER_KEY) {
+            auto range = duplicateIds.equal_range(key);
+            for (auto it = range.first; it != range.second; ++it) {
+                result.push_back(it->second);
+            }
+        }
+    }
+    
+    // 姓名以 prefix 开头（ASCII 字母不区分大小写）的账户，按姓名排序，至多 limit 个
+    // 前缀不超过 16 个字节时命中的恰好是整数键落在 [low, high] 内的项；更长时先按整数键定位再比较全名
+    void findByNamePrefix(string_view prefix, size_t limit, vector<Account*>& result) const {
+        NameEntry low{packNameBytes(prefix, 0), packNameBytes(prefix, 8), nullptr};
+        NameEntry high = low;
+        if (prefix.size() < 8) {
+            high.head |= UINT64_MAX >> (prefix.size() * 8);
+            high.tail = UINT64_MAX;
+        } else if (prefix.size() < 16) {
+            high.tail |= UINT64_MAX >> ((prefix.size() - 8) * 8);
+        }
+        auto it = lower_bound(names.begin(), names.end(), low, keyLess);
+        bool longPrefix = prefix.size() > 16;
+        if (longPrefix) {
+            auto last = upper_bound(it, names.end(), low, keyLess);
+            it = lower_bound(it, last, prefix, [](const NameEntry& entry, string_view text) {
+                return compareFolded(entry.account->getName(), text) < 0;
+            });
+        }
+        vector<Account*> found;
+        for (; it != names.end() && found.size() < limit && !keyLess(high, *it); ++it) {
+            if (longPrefix && !startsWithFolded(it->account->getName(), prefix)) {
+                break;
+            }
+            found.push_back(it->account);
+        }
+        
+        // 待合并区很小，逐项检查后与数组中的结果一起排序截断
+        for (const NameEntry& entry : pendingNames) {
+            if (startsWithFolded(entry.account->getName(), prefix)) {
+                found.push_back(entry.account);
+            }
+        }
+        if (!pendingNames.empty()) {
+            sort(found.begin(), found.end(), [](Account* a, Account* b) {
+                return nameLess(nameEntry(a), nameEntry(b));
+            });
+            if (found.size() > limit) {
+                found.resize(limit);
+            }
+        }
+        result.insert(result.end(), found.begin(), found.end());
+    }
+    
+    size_t nameEntries() const { return names.size() + pendingNames.size(); }
+};
+
+// 分片账户文件：账户按账号哈希分到 N 个文件 accounts.NNNN.dat（格式同 accounts.dat），
+// 分片数记在清单文件 accounts.shards 中。各分片独立并行加载、独立写出（临时文件落盘后改名覆盖），
+// 一次操作只重写它涉及的一两个小文件；标记为脏的分片才重写
+class AccountShards {
+private:
+    struct Shard {
+        mutex writeMutex;
+        atomic<bool> dirty;
+        vector<Account*> members;
+        
+        Shard() : dirty(false) {}
+    };
+    
+    size_t count;
+    unique_ptr<Shard[]> shards;
+    
+    static bool writeManifest(size_t shardCount) {
+        string tempFile = ACCOUNTS_SHARD_MANIFEST + ".tmp";
+        ofstream file(tempFile);
+        if (!file.is_open()) {
+            return false;
+        }
+        file << shardCount << '\n';
+        file.close();
+        if (!file) {
+            return false;
+        }
+        return replaceFile(tempFile, ACCOUNTS_SHARD_MANIFEST);
+    }
+    
+public:
+    AccountShards() : count(0) {}
+    
+    // 清单中记录的分片数，没有清单返回 0
+    static size_t readManifest() {
+        ifstream file(ACCOUNTS_SHARD_MANIFEST);
+        size_t shardCount = 0;
+        if (!(file >> shardCount) || shardCount > ACCOUNT_SHARDS_MAX) {
+            return 0;
+        }
+        return shardCount;
+    }
+    
+    static string fileName(size_t shard) {
+        char name[48];
+        snprintf(name, sizeof(name), "accounts.%04zu.dat", shard);
+        return name;
+    }
+    
+    // 19 位数字账号取压缩值取模，其余账号用 FNV-1a；不依赖 std::hash，分片归属在不同构建间保持一致
+    static size_t shardOf(string_view accountNumber, size_t shardCount) {
+        uint64_t key;
+        if (!AccountTable::packAccountNumber(accountNumber, key)) {
+            key = 14695981039346656037ull;
+            for (char c : accountNumber) {
+                key = (key ^ (unsigned char)c) * 1099511628211ull;
+            }
+        }
+        return key % shardCount;
+    }
+    
+    // 删除清单和全部分片文件
+    static void removeFiles() {
+        size_t shardCount = readManifest();
+        for (size_t i = 0; i < shardCount; i++) {
+            remove(fileName(i).c_str());
+        }
+        remove(ACCOUNTS_SHARD_MANIFEST.c_str());
+    }
+    
+    size_t size() const { return count; }
+    
+    size_t shardOf(string_view accountNumber) const {
+        return shardOf(accountNumber, count);
+    }
+    
+    // 按清单确定分片数；没有清单时使用 requested 并返回 false，由调用方迁移后调用 create
+    bool open(size_t requested) {
+        size_t existing = readManifest();
+        count = existing > 0 ? existing : max<size_t>(1, min(requested, ACCOUNT_SHARDS_MAX));
+        shards.reset(new Shard[count]);
+        return existing > 0;
+    }
+    
+    // 并行读入全部分片：每个线程负责若干分片，解析后按分片顺序并入账户表
+    bool load(AccountTable& accounts) {
+        vector<vector<Account>> parsed(count);
+        atomic<bool> ok(true);
+        forEachRange(count, thread::hardware_concurrency(), [&](size_t, size_t from, size_t to) {
+            for (size_t shard = from; shard < to; shard++) {
+                MappedTextFile file;
+                if (!file.open(fileName(shard))) {
+                    ok = false;
+                    continue;
+                }
+                vector<Account>& out = parsed[shard];
+                out.reserve(file.view().size() / ESTIMATED_ACCOUNT_LINE_BYTES);
+                forEachLine(file.view(), [&out](string_view line) {
+                    out.push_back(Account::fromFileString(line));
+                });
+            }
+        });
+        
+        size_t total = accounts.size();
+        for (const auto& part : parsed) {
+            total += part.size();
+        }
+        accounts.reserve(total);
+        for (auto& part : parsed) {
+            for (Account& account : part) {
+                accounts.upsert(move(account));
+            }
+            vector<Account>().swap(part);
+        }
+        return ok;
+    }
+    
+    // 按分片归属写出全部账户并写清单，用于从 accounts.dat 迁移
+    bool create(const AccountTable& accounts) {
+        vector<vector<Account>> parts(count);
+        for (const Account& account : accounts) {
+            parts[shardOf(account.getAccountNumber())].push_back(account);
+        }
+        atomic<bool> ok(true);
+        forEachRange(count, thread::hardware_concurrency(), [&](size_t, size_t from, size_t to) {
+            for (size_t shard = from; shard < to; shard++) {
+                if (!write(shard, parts[shard])) {
+                    ok = false;
+                }
+            }
+        });
+        return ok && writeManifest(count);
+    }
+    
+    // 记录每个分片包含的账户；账户表之后不再增删，指针保持有效
+    void attach(AccountTable& accounts) {
+        for (size_t i = 0; i < count; i++) {
+            shards[i].members.clear();
+        }
+        for (Account& account : accounts) {
+            shards[shardOf(account.getAccountNumber())].members.push_back(&account);
+        }
+    }
+    
+    const vector<Account*>& members(size_t shard) const { return shards[shard].members; }
+    
+    mutex& writeMutex(size_t shard) { return shards[shard].writeMutex; }
+    
+    void markDirty(size_t shard) {
+        shards[shard].dirty.store(true, memory_order_release);
+    }
+    
+    // 取走脏标记；返回 true 时调用方负责写出该分片，失败后需重新标记
+    bool takeDirty(size_t shard) {
+        return shards[shard].dirty.exchange(false, memory_order_acq_rel);
+    }
+    
+    // 先写临时文件再改名，崩溃时该分片要么是旧内容要么是新内容，其余分片不受影响
+    static bool write(size_t shard, const vector<Account>& accounts) {
+        string name = fileName(shard);
+        string tempFile = name + ".tmp";
+        ofstream file(tempFile, ios::binary);
+        if (!file.is_open()) {
+            return false;
+        }
+        string buffer;
+        for (const Account& account : accounts) {
+            buffer += account.toFileString();
+            buffer += '\n';
+        }
+        file.write(buffer.data(), buffer.size());
+        file.close();
+        if (!file) {
+            return false;
+        }
+        return replaceFile(tempFile, name);
+    }
+};
+
+// 账户条带锁：账户按地址哈希到固定数量的条带，每个条带一把互斥锁和一个序列号（seqlock）
+// 账户存放在 AccountTable 的 deque 中，地址终身不变，可以代表账户身份
+// 修改账户需持有所在条带的锁；同时锁两个账户时按条带序号从小到大加锁，不会死锁
+// 只读余额不加锁：读前后序列号相同且为偶数，说明读到的是某次写入完成后的值
+class AccountLocks {
+private:
+    struct alignas(64) Stripe {
+        mutex lock;
+        atomic<uint32_t> sequence;
+        
+        Stripe() : sequence(0) {}
+    };
+    
+    unique_ptr<Stripe[]> stripes;
+    
+    static size_t stripeOf(const Account* account) {
+        uint64_t key = reinterpret_cast<uintptr_t>(account);
+        key ^= key >> 33;
+        key *= 0xff51afd7ed558ccdULL;
+        key ^= key >> 33;
+        return key & (ACCOUNT_LOCK_STRIPES - 1);
+    }
+    
+    // 写入期间序列号为奇数，调用方需持有条带锁
+    void beginWrite(size_t index) {
+        atomic<uint32_t>& sequence = stripes[index].sequence;
+        sequence.store(sequence.load(memory_order_relaxed) + 1, memory_order_relaxed);
+        atomic_thread_fence(memory_order_release);
+    }
+    
+    void endWrite(size_t index) {
+        atomic<uint32_t>& sequence = stripes[index].sequence;
+        sequence.store(sequence.load(memory_order_relaxed) + 1, memory_order_release);
+    }
+    
+public:
+    AccountLocks() : stripes(new Stripe[ACCOUNT_LOCK_STRIPES]) {}
+    
+    // 锁住一个或两个账户所在的条带并标记为写入中，析构或 unlock 时释放
+    // 改完内存中的余额后应先 endWrite 再做任何 I/O（落盘、等待交易日志），不加锁的余额查询只在写入中才需重读
+    class WriteGuard {
+    private:
+        AccountLocks& locks;
+        size_t first;
+        size_t second;
+        bool held;
+        bool writing;
+        
+    public:
+        WriteGuard(AccountLocks& l, const Account* account, const Account* other = nullptr)
+            : locks(l), first(stripeOf(account)), second(other ? stripeOf(other) : first), held(true), writing(false) {
+            if (second < first) {
+                swap(first, second);
+            }
+            locks.stripes[first].lock.lock();
+            if (second != first) {
+                locks.stripes[second].lock.lock();
+            }
+            beginWrite();
+        }
+        
+        ~WriteGuard() {
+            unlock();
+        }
+        
+        WriteGuard(const WriteGuard&) = delete;
+        WriteGuard& operator=(const WriteGuard&) = delete;
+        
+        // 重新标记为写入中，用于持有条带锁期间再次修改余额（如撤销未确认的变动）
+        void beginWrite() {
+            if (!held || writing) {
+                return;
+            }
+            writing = true;
+            locks.beginWrite(first);
+            if (second != first) {
+                locks.beginWrite(second);
+            }
+        }
+        
+        // 结束写入标记但继续持有条带锁
+        void endWrite() {
+            if (!writing) {
+                return;
+            }
+            writing = false;
+            if (second != first) {
+                locks.endWrite(second);
+            }
+            locks.endWrite(first);
+        }
+        
+        void unlock() {
+            if (!held) {
+                return;
+            }
+            endWrite();
+            held = false;
+            if (second != first) {
+                locks.stripes[second].lock.unlock();
+            }
+            locks.stripes[first].lock.unlock();
+        }
+    };
+    
+    // 按序锁住全部条带，用于需要整表一致视图的操作（整表保存、检查点）
+    class AllGuard {
+    private:
+        AccountLocks& locks;
+        
+    public:
+        explicit AllGuard(AccountLocks& l) : locks(l) {
+            for (size_t i = 0; i < ACCOUNT_LOCK_STRIPES; i++) {
+                locks.stripes[i].lock.lock();
+            }
+        }
+        
+        ~AllGuard() {
+            for (size_t i = ACCOUNT_LOCK_STRIPES; i-- > 0;) {
+                locks.stripes[i].lock.unlock();
+            }
+        }
+        
+        AllGuard(const AllGuard&) = delete;
+        AllGuard& operator=(const AllGuard&) = delete;
+    };
+    
+    // 只读访问账户的非余额字段（如密码）时使用
+    mutex& stripeMutex(const Account* account) {
+        return stripes[stripeOf(account)].lock;
+    }
+    
+    // 不加锁读取余额，与写入冲突时重读；写入标记只覆盖修改内存的瞬间，不会等到落盘
+    Money readBalance(const Account& account) const {
+        const atomic<uint32_t>& sequence = stripes[stripeOf(&account)].sequence;
+        while (true) {
+            uint32_t before = sequence.load(memory_order_acquire);
+            if (before & 1) {
+                this_thread::yield();
+                continue;
+            }
+            Money balance = account.getBalance();
+            atomic_thread_fence(memory_order_acquire);
+            if (sequence.load(memory_order_relaxed) == before) {
+                return balance;
+            }
+        }
+    }
+};
+
+// 复制流：主库把每次提交的账户变更和交易记录编上递增序号排队，由复制服务器按序发给各备库
+// 消息为一行文本 "<类型> <序号> <提交时刻(微秒)> <内容>"，类型 A 为账户记录（同 accounts.dat 的一行），
+// T 为交易记录（同 transactions.dat 的一行）。没有备库时不排队也不编号
+// 积压超过 REPLICATION_MAX_BACKLOG 条时丢弃最旧的消息，落后到这些消息的备库会被断开，重连后重新取快照
+class ReplicationStream {
+private:
+    mutex streamMutex;
+    condition_variable published;
+    deque<string> backlog;       // backlog[i] 的序号为 firstSeq + i
+    uint64_t firstSeq;
+    uint64_t lastSeq;
+    map<int, uint64_t> cursors;  // 备库编号 → 下一条待发送的序号
+    int nextFollowerId;
+    atomic<bool> hasFollowers;
+    
+    void publish(char type, const string& payload) {
+        if (!hasFollowers.load(memory_order_acquire)) {
+            return;
+        }
+        lock_guard<mutex> lock(streamMutex);
+        if (cursors.empty()) {
+            return;
+        }
+        uint64_t seq = ++lastSeq;
+        string message(1, type);
+        message += ' ';
+        message += to_string(seq);
+        message += ' ';
+        message += to_string(currentMicros());
+        message += ' ';
+        message += payload;
+        message += '\n';
+        backlog.push_back(move(message));
+        if (backlog.size() > REPLICATION_MAX_BACKLOG) {
+            backlog.pop_front();
+            firstSeq++;
+        }
+        published.notify_all();
+    }
+    
+    // 丢弃所有备库都已取走的消息，调用方持有 streamMutex
+    void trim() {
+        uint64_t minCursor = lastSeq + 1;
+        for (const auto& cursor : cursors) {
+            minCursor = min(minCursor, cursor.second);
+        }
+        while (!backlog.empty() && firstSeq < minCursor) {
+            backlog.pop_front();
+            firstSeq++;
+        }
+    }
+    
+public:
+    ReplicationStream() : firstSeq(1), lastSeq(0), nextFollowerId(0), hasFollowers(false) {}
+    
+    // 墙上时钟的微秒数，主备在同一台机器上，用来计算复制延迟
+    static int64_t currentMicros() {
+        return chrono::duration_cast<chrono::microseconds>(chrono::system_clock::now().time_since_epoch()).count();
+    }
+    
+    void publishAccount(const Account& account) {
+        publish('A', account.toFileString());
+    }
+    
+    void publishTransaction(const Transaction& trans) {
+        string line;
+        trans.appendLogLine(line);
+        line.pop_back();
+        publish('T', line);
+    }
+    
+    // 登记一个备库，seq 返回它的快照所对应的最后序号
+    // 调用方需保证此时没有并发的账户变更（Bank 在锁住全部条带时调用）
+    int attach(uint64_t& seq) {
+        lock_guard<mutex> lock(streamMutex);
+        int id = nextFollowerId++;
+        cursors[id] = lastSeq + 1;
+        seq = lastSeq;
+        hasFollowers.store(true, memory_order_release);
+        return id;
+    }
+    
+    void detach(int id) {
+        lock_guard<mutex> lock(streamMutex);
+        cursors.erase(id);
+        hasFollowers.store(!cursors.empty(), memory_order_release);
+        trim();
+    }
+    
+    // 等待并取出该备库游标之后的全部消息，超时时 batch 为空；latest 返回当前最大序号
+    // 备库需要的消息已因积压过多被丢弃时返回 false
+    bool waitBatch(int id, string& batch, uint64_t& latest, int timeoutMs) {
+        unique_lock<mutex> lock(streamMutex);
+        auto it = cursors.find(id);
+        if (it == cursors.end()) {
+            return false;
+        }
+        published.wait_for(lock, chrono::milliseconds(timeoutMs), [&] { return it->second <= lastSeq; });
+        if (it->second < firstSeq) {
+            return false;
+        }
+        for (uint64_t seq = it->second; seq <= lastSeq; seq++) {
+            batch += backlog[seq - firstSeq];
+        }
+        it->second = lastSeq + 1;
+        latest = lastSeq;
+        trim();
+        return true;
+    }
+    
+    size_t followerCount() {
+        lock_guard<mutex> lock(streamMutex);
+        return cursors.size();
+    }
+    
+    size_t backlogSize() {
+        lock_guard<mutex> lock(streamMutex);
+        return backlog.size();
+    }
+    
+    uint64_t sequence() {
+        lock_guard<mutex> lock(streamMutex);
+        return lastSeq;
+    }
+};
+
+// 日终作业：对全部账户逐个应用同一条规则
+enum EodJobType {
+    EOD_INTEREST,  // 按年利率计提一天的利息入账
+    EOD_FEE,       // 余额低于门槛的账户扣收固定费用，按月运行即为月费
+    EOD_DORMANT    // 列出长期没有客户交易的账户，不改余额
+};
+
+struct EodJob {
+    EodJobType type;
+    int64_t rateBasisPoints;  // 年利率，单位万分之一
+    Money fee;
+    Money below;              // 余额低于该值才收费
+    int dormantDays;          // 超过该天数没有客户交易视为休眠
+    
+    EodJob() : type(EOD_INTEREST), rateBasisPoints(0), dormantDays(DEFAULT_DORMANT_DAYS) {}
+    
+    // 对该余额应记的金额（分），正数入账、负数扣款，0 表示不记账
+    int64_t postingFen(int64_t balanceFen) const {
+        if (type == EOD_INTEREST) {
+            // 日利率取年利率的 1/365，不足一分舍去
+            return balanceFen > 0 ? (int64_t)((__int128)balanceFen * rateBasisPoints / (10000 * 365)) : 0;
+        }
+        if (type == EOD_FEE && balanceFen < below.toFen()) {
+            return -min(fee.toFen(), max<int64_t>(0, balanceFen));
+        }
+        return 0;
+    }
+};
+
+// 日终作业的进度和结果；processed 由各工作线程累加，运行中可在其他线程读取
+struct EodResult {
+    atomic<size_t> processed;
+    atomic<size_t> total;
+    size_t postings;
+    int64_t creditedFen;
+    int64_t debitedFen;
+    vector<pair<string, int>> dormant;  // 休眠账户及其最后一次客户交易的日期键（0 表示从未交易）
+    double applyMs;
+    double persistMs;
+    
+    EodResult() : processed(0), total(0), postings(0), creditedFen(0), debitedFen(0), applyMs(0), persistMs(0) {}
+};
+
+// 单个终端的会话状态
+struct Session {
+    Account* currentAccount;
+    bool isLoggedIn;
+    
+    // 批处理模式：余额变动只记入 batchDeltas（账户，变动的分），由 Bank::commitBatch 统一确认和持久化
+    // 有备库时交易记录暂存在 batchTransactions，落盘后才发布
+    bool batchMode;
+    vector<pair<Account*, int64_t>> batchDeltas;
+    vector<Transaction> batchTransactions;
+    uint64_t lastSeq;
+    
+    Session() : currentAccount(nullptr), isLoggedIn(false), batchMode(false), lastSeq(0) {}
+};
+
+// 银行业务引擎：持有账户表和持久化，不做任何控制台输入输出
+// 可被多个会话并发调用，没有全局锁：
+//   - 账户的读写由 locks 的条带锁保护，转账按条带序号锁住两个账户；余额查询走 seqlock 不加锁
+//   - tableMutex 只在按需加载账户的模式（binary/lazy）下保护账户表的查找和插入
+//   - persistMutex 串行化持有条带锁时做的持久化（追加、提交、轮换预写日志，登记待写回账户）
+//   - 整表保存和检查点锁住全部条带，得到一致的账户表
+// 加锁顺序：条带（从小到大）-> persistMutex -> tableMutex
+class Bank {
+private:
+    AccountTable accounts;
+    StorageMode storageMode;
+    AccountLocks locks;
+    mutex tableMutex;
+    mutex persistMutex;
+    
+    // 日志模式：变更追加到预写日志，由后台线程定期做检查点
+    AccountJournal journal;
+    thread checkpointThread;
+    mutex checkpointMutex;
+    condition_variable checkpointCv;
+    bool stopping;
+    // 后台线程和日终作业都可能做检查点，同一时间只能有一个
+    mutex checkpointRunMutex;
+    
+    // 二进制模式：账户按需从映射文件中取出，accounts 只缓存已访问的账户
+    MappedAccountStore store;
+    
+    // 按需加载模式：accounts 只缓存已访问的账户，lazyDirty 为待写回的账号
+    LazyAccountFile lazyFile;
+    unordered_set<string> lazyDirty;
+    
+    // 分片存储（CSV 和日志模式可选）：只重写有变动的分片文件
+    AccountShards shards;
+    
+    // 主库：提交的账户变更和交易记录同时发布到复制流
+    ReplicationStream* replication;
+    
+    // 身份证号和姓名的二级索引，只在账户全部常驻内存的模式下维护，修改和查询都持有 tableMutex
+    AccountIndex indexes;
+    
+    // 按账号累计的连续密码错误次数，不随会话或连接重置；锁定账户和判断锁定都持有 attemptsMutex
+    mutex attemptsMutex;
+    unordered_map<string, int> loginFailures;
+    
+public:
+    // shardCount 大于 0 时 CSV 和日志模式改用分片账户文件，已有分片清单时以清单中的分片数为准
+    explicit Bank(StorageMode mode = STORAGE_CSV, size_t shardCount = 0)
+        : storageMode(mode), stopping(false), replication(nullptr) {
+        if (storageMode == STORAGE_BINARY) {
+            openBinaryStore();
+        } else if (storageMode == STORAGE_LAZY) {
+            openLazyFile();
+        } else if (shardCount > 0 && (storageMode == STORAGE_CSV || storageMode == STORAGE_JOURNAL)) {
+            openShards(shardCount);
+        } else {
+            // 加载账户数据
+            accounts = FileManager::loadAccounts();
+            
+            // 如果没有账户数据，创建一些示例账户
+            if (accounts.empty()) {
+                createSampleAccounts();
+            }
+        }
+        
+        if (tableResident()) {
+            indexes.build(accounts);
+        }
+        
+        // 建立当日取款索引和历史索引，之后的限额检查和历史查询不再扫描交易文件
+        FileManager::buildTransactionIndexes();
+        
+        if (storageMode == STORAGE_JOURNAL) {
+            int intervalMs;
+            DurabilityPolicy policy = FileManager::transactionLogPolicy(intervalMs);
+            journal.setPolicy(policy, intervalMs);
+            journal.open();
+            checkpointThread = thread(&Bank::checkpointLoop, this);
+        }
+        
+        if (storageMode == STORAGE_MEMORY) {
+            FileManager::setTransactionLogEnabled(false);
+        }
+    }
+    
+    ~Bank() {
+        FileManager::flushTransactionLog();
+        
+        if (storageMode == STORAGE_MEMORY) {
+            FileManager::setTransactionLogEnabled(true);
+            return;
+        }
+        
+        if (storageMode == STORAGE_BINARY) {
+            store.flush();
+            return;
+        }
+        
+        if (storageMode == STORAGE_LAZY) {
+            flushLazyDirty();
+            return;
+        }
+        
+        if (storageMode == STORAGE_JOURNAL) {
+            {
+                lock_guard<mutex> lock(checkpointMutex);
+                stopping = true;
+            }
+            checkpointCv.notify_all();
+            checkpointThread.join();
+            checkpoint();
+            journal.close();
+            return;
+        }
+        
+        if (shards.size() > 0) {
+            flushDirtyShards();
+            return;
+        }
+        
+        // 保存账户数据
+        FileManager::saveAccounts(accounts);
+    }
+    
+    Bank(const Bank&) = delete;
+    Bank& operator=(const Bank&) = delete;
+    
+    void createSampleAccounts() {
+        Account acc1("1234567890123456789", "Zhang San", "110101199001011234", "123456", INITIAL_BALANCE);
+        Account acc2("5002222005040623456", "Li Hua","500222200504062345","123456",Money::fromYuan(999999));
+        
+        accounts.upsert(acc1);
+        accounts.upsert(acc2);
+        
+        if (storageMode == STORAGE_LAZY) {
+            lazyDirty.insert(acc1.getAccountNumber());
+            lazyDirty.insert(acc2.getAccountNumber());
+            flushLazyDirty();
+            return;
+        }
+        if (shards.size() > 0) {
+            // 分片文件由 openShards 统一创建
+            return;
+        }
+        FileManager::saveAccounts(accounts);
+    }
+    
+    // 登录前检查账户是否存在、是否被锁定
+    OpStatus checkAccount(const string& accountNumber) {
+        if (!findAccount(accountNumber)) {
+            return OP_NO_ACCOUNT;
+        }
+        if (FileManager::isAccountLocked(accountNumber)) {
+            return OP_ACCOUNT_LOCKED;
+        }
+        return OP_OK;
+    }
+    
+    OpStatus login(Session& session, const string& accountNumber, const string& password) {
+        MetricTimer timer(METRIC_LOGIN);
+        return timer.finish(doLogin(session, accountNumber, password));
+    }
+    
+    // 账户被锁定前还能输错密码的次数
+    int remainingLoginAttempts(const string& accountNumber) {
+        lock_guard<mutex> lock(attemptsMutex);
+        auto it = loginFailures.find(accountNumber);
+        return MAX_LOGIN_ATTEMPTS - (it == loginFailures.end() ? 0 : it->second);
+    }
+    
+    void logout(Session& session) {
+        session.currentAccount = nullptr;
+        session.isLoggedIn = false;
+    }
+    
+    OpStatus checkBalance(Session& session, Money& balance) {
+        if (!session.isLoggedIn || !session.currentAccount) {
+            return OP_NOT_LOGGED_IN;
+        }
+        balance = locks.readBalance(*session.currentAccount);
+        recordTransaction(session, "BALANCE_QUERY", Money());
+        return OP_OK;
+    }
+    
+    Money todayWithdrawalTotal(Session& session) {
+        if (!session.isLoggedIn || !session.currentAccount) {
+            return Money();
+        }
+        return FileManager::getTodayWithdrawalTotal(session.currentAccount->getAccountNumber());
+    }
+    
+    OpStatus withdraw(Session& session, Money amount) {
+        MetricTimer timer(METRIC_WITHDRAW);
+        return timer.finish(doWithdraw(session, amount));
+    }
+    
+    OpStatus deposit(Session& session, Money amount) {
+        if (!session.isLoggedIn || !session.currentAccount) {
+            return OP_NOT_LOGGED_IN;
+        }
+        if (!amount.isPositive()) {
+            return OP_INVALID_AMOUNT;
+        }
+        if (!FileManager::transactionLogHealthy()) {
+            return OP_FAILED;
+        }
+        
+        AccountLocks::WriteGuard guard(locks, session.currentAccount);
+        if (!session.currentAccount->deposit(amount)) {
+            return OP_FAILED;
+        }
+        
+        return commitMutation(session, guard, newTransaction(session, "DEPOSIT", amount), amount.toFen(),
+                              session.currentAccount);
+    }
+    
+    // 转账前检查目标账户，recipientName 返回收款人姓名
+    OpStatus checkTransferTarget(Session& session, const string& targetAccountNumber, string* recipientName = nullptr) {
+        if (!session.isLoggedIn || !session.currentAccount) {
+            return OP_NOT_LOGGED_IN;
+        }
+        Account* target = findAccount(targetAccountNumber);
+        if (!target) {
+            return OP_NO_TARGET_ACCOUNT;
+        }
+        if (target == session.currentAccount) {
+            return OP_SAME_ACCOUNT;
+        }
+        if (recipientName) {
+            *recipientName = target->getName();
+        }
+        return OP_OK;
+    }
+    
+    OpStatus transfer(Session& session, const string& targetAccountNumber, Money amount) {
+        MetricTimer timer(METRIC_TRANSFER);
+        return timer.finish(doTransfer(session, targetAccountNumber, amount));
+    }
+    
+    OpStatus changePassword(Session& session, const string& oldPassword, const string& newPassword) {
+        if (!session.isLoggedIn || !session.currentAccount) {
+            return OP_NOT_LOGGED_IN;
+        }
+        
+        AccountLocks::WriteGuard guard(locks, session.currentAccount);
+        if (!session.currentAccount->verifyPassword(oldPassword)) {
+            return OP_WRONG_PASSWORD;
+        }
+        if (newPassword.length() != PASSWORD_LENGTH) {
+            return OP_INVALID_PASSWORD_LENGTH;
+        }
+        if (!all_of(newPassword.begin(), newPassword.end(), ::isdigit)) {
+            return OP_INVALID_PASSWORD_DIGITS;
+        }
+        
+        session.currentAccount->setPassword(newPassword);
+        if (replication) {
+            replication->publishAccount(*session.currentAccount);
+        }
+        persistAccounts(guard, session.currentAccount);
+        return OP_OK;
+    }
+    
+    // 最近 n 笔交易，从新到旧
+    OpStatus recentTransactions(Session& session, size_t n, vector<Transaction>& result) {
+        if (!session.isLoggedIn || !session.currentAccount) {
+            return OP_NOT_LOGGED_IN;
+        }
+        result = FileManager::recentTransactions(session.currentAccount->getAccountNumber(), n);
+        return OP_OK;
+    }
+    
+    // 日期区间 [fromKey, toKey] 内的交易，日期键见 dateKey
+    OpStatus transactionsBetween(Session& session, int fromKey, int toKey, vector<Transaction>& result) {
+        if (!session.isLoggedIn || !session.currentAccount) {
+            return OP_NOT_LOGGED_IN;
+        }
+        result = FileManager::transactionsBetween(session.currentAccount->getAccountNumber(), fromKey, toKey);
+        return OP_OK;
+    }
+    
+    // 账户是否全部常驻内存；二进制和按需加载的模式只缓存访问过的账户
+    bool tableResident() const {
+        return storageMode == STORAGE_CSV || storageMode == STORAGE_JOURNAL || storageMode == STORAGE_MEMORY;
+    }
+    
+    // 复制只支持整表常驻内存的模式，其余模式的账户表不完整，无法生成快照
+    bool supportsReplication() const {
+        return tableResident();
+    }
+    
+    // 按身份证号查找全部账户（柜面管理用），结果为账户副本，按账号排序
+    // 二级索引只在账户常驻内存的模式下维护，其余模式返回 OP_FAILED
+    OpStatus findAccountsByIdCard(const string& idCard, vector<Account>& result) {
+        if (!tableResident()) {
+            return OP_FAILED;
+        }
+        vector<Account*> found;
+        {
+            lock_guard<mutex> lock(tableMutex);
+            indexes.findByIdCard(idCard, found);
+        }
+        copyAccounts(found, result);
+        sort(result.begin(), result.end(), [](const Account& a, const Account& b) {
+            return a.getAccountNumber() < b.getAccountNumber();
+        });
+        return result.empty() ? OP_NO_ACCOUNT : OP_OK;
+    }
+    
+    // 姓名以 prefix 开头的账户（ASCII 字母不区分大小写），按姓名排序，至多 limit 个
+    OpStatus findAccountsByName(const string& prefix, size_t limit, vector<Account>& result) {
+        if (!tableResident()) {
+            return OP_FAILED;
+        }
+        vector<Account*> found;
+        {
+            lock_guard<mutex> lock(tableMutex);
+            indexes.findByNamePrefix(prefix, limit, found);
+        }
+        copyAccounts(found, result);
+        return result.empty() ? OP_NO_ACCOUNT : OP_OK;
+    }
+    
+    // 主库：在启动复制服务器之前设置，之后的变更发布到 stream
+    void setReplication(ReplicationStream* stream) {
+        replication = stream;
+    }
+    
+    // 主库：锁住全部条带登记一个备库，返回全部账户的快照
+    // 快照与登记之间没有变更，备库先应用快照再按序应用之后的消息即与主库一致
+    // 快照格式为 "S <序号> <时刻> <账户数>" 一行，后跟每个账户一行
+    string replicationSnapshot(ReplicationStream& stream, int& followerId) {
+        AccountLocks::AllGuard all(locks);
+        lock_guard<mutex> lock(tableMutex);
+        uint64_t seq = 0;
+        followerId = stream.attach(seq);
+        string snapshot = "S " + to_string(seq) + ' ' + to_string(ReplicationStream::currentMicros()) + ' ' +
+                          to_string(accounts.size()) + '\n';
+        for (const Account& account : accounts) {
+            snapshot += account.toFileString();
+            snapshot += '\n';
+        }
+        return snapshot;
+    }
+    
+    // 备库：用主库快照覆盖本地账户并整表持久化；快照中没有的本地账户保留
+    void applyReplicaSnapshot(const vector<Account>& snapshot) {
+        {
+            AccountLocks::AllGuard all(locks);
+            lock_guard<mutex> lock(tableMutex);
+            for (const Account& account : snapshot) {
+                accounts.upsert(account);
+            }
+            indexes.build(accounts);
+            if (shards.size() > 0) {
+                shards.attach(accounts);
+                for (size_t shard = 0; shard < shards.size(); shard++) {
+                    shards.markDirty(shard);
+                }
+            }
+            if (storageMode == STORAGE_JOURNAL) {
+                lock_guard<mutex> persistLock(persistMutex);
+                for (const Account& account : snapshot) {
+                    journal.append(account);
+                }
+                journal.commit();
+                return;
+            }
+        }
+        if (storageMode == STORAGE_CSV) {
+            saveAllAccounts();
+        }
+    }
+    
+    // 备库：应用主库的一条账户记录，按本地存储模式持久化
+    // 备库运行期间只有复制线程修改账户表，新账户可以直接插入；新账户或姓名、身份证号变化时同时更新二级索引
+    void applyReplicaAccount(const Account& incoming) {
+        Account* account = findAccount(incoming.getAccountNumber());
+        if (!account || account->getName() != incoming.getName() || account->getIdCard() != incoming.getIdCard()) {
+            AccountLocks::AllGuard all(locks);
+            lock_guard<mutex> lock(tableMutex);
+            if (account) {
+                indexes.remove(account);
+                *account = incoming;
+            } else {
+                account = &accounts.upsert(incoming);
+                if (shards.size() > 0) {
+                    shards.attach(accounts);
+                }
+            }
+            indexes.add(account);
+        }
+        AccountLocks::WriteGuard guard(locks, account);
+        *account = incoming;
+        persistAccounts(guard, account);
+    }
+    
+    // 日终作业：各核分段遍历账户表，逐个锁住账户应用规则，记账每 EOD_BLOCK_ACCOUNTS 个账户整批交给交易日志，
+    // 全部记账落盘后才发布到复制流并只持久化一次。每个账户只在处理它的瞬间加锁，联机交易可以同时进行
+    // 记账未能落盘时撤销全部记账并返回 OP_FAILED；只支持账户常驻内存的模式，其余模式也返回 OP_FAILED
+    OpStatus runEndOfDay(const EodJob& job, EodResult& result) {
+        if (!tableResident() || !FileManager::transactionLogHealthy()) {
+            return OP_FAILED;
+        }
+        string date = currentDateString();
+        string time = currentTimeString();
+        int todayKey = dateKey(date);
+        int cutoffKey = civilDateKey(daysFromCivil(todayKey / 10000, todayKey / 100 % 100, todayKey % 100) -
+                                     job.dormantDays);
+        
+        struct PartResult {
+            size_t postings = 0;
+            int64_t creditedFen = 0;
+            int64_t debitedFen = 0;
+            uint64_t lastSeq = 0;
+            vector<pair<string, int>> dormant;
+            vector<pair<Account*, int64_t>> applied;  // 已记账的账户和金额（分），落盘前不确认
+        };
+        
+        // 休眠判断查一次取出的快照，各线程不再逐个账户争用历史索引的锁
+        ActivitySnapshot activity;
+        if (job.type == EOD_DORMANT) {
+            activity = FileManager::lastActivitySnapshot();
+        }
+        
+        size_t count = accounts.size();
+        result.total = count;
+        size_t parts = count < PARALLEL_INDEX_MIN_ACCOUNTS ? 1 : max(1u, thread::hardware_concurrency());
+        vector<PartResult> partResults(parts);
+        auto start = chrono::steady_clock::now();
+        forEachRange(count, parts, [&](size_t part, size_t from, size_t to) {
+            PartResult& partResult = partResults[part];
+            vector<Transaction> postings;
+            auto it = accounts.begin() + from;
+            for (size_t blockStart = from; blockStart < to; blockStart += EOD_BLOCK_ACCOUNTS) {
+                size_t blockEnd = min(to, blockStart + EOD_BLOCK_ACCOUNTS);
+                for (size_t i = blockStart; i < blockEnd; i++, ++it) {
+                    Account& account = *it;
+                    if (job.type == EOD_DORMANT) {
+                        int lastKey = activity.lastActivity(account.getAccountNumber());
+                        if (lastKey < cutoffKey) {
+                            partResult.dormant.emplace_back(account.getAccountNumber(), lastKey);
+                        }
+                        continue;
+                    }
+                    
+                    AccountLocks::WriteGuard guard(locks, &account);
+                    int64_t fen = job.postingFen(account.getBalance().toFen());
+                    Money amount = Money::fromFen(fen > 0 ? fen : -fen);
+                    if (fen == 0 || !(fen > 0 ? account.deposit(amount) : account.withdraw(amount))) {
+                        continue;
+                    }
+                    postings.emplace_back(account.getAccountNumber(), fen > 0 ? "INTEREST" : "FEE", amount, date, time);
+                    (fen > 0 ? partResult.creditedFen : partResult.debitedFen) += amount.toFen();
+                    partResult.applied.emplace_back(&account, fen);
+                }
+                partResult.postings += postings.size();
+                if (!postings.empty()) {
+                    partResult.lastSeq = max(partResult.lastSeq, FileManager::logTransactions(postings));
+                }
+                result.processed += blockEnd - blockStart;
+            }
+        });
+        result.applyMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        
+        uint64_t lastSeq = 0;
+        for (PartResult& partResult : partResults) {
+            result.postings += partResult.postings;
+            result.creditedFen += partResult.creditedFen;
+            result.debitedFen += partResult.debitedFen;
+            lastSeq = max(lastSeq, partResult.lastSeq);
+            result.dormant.insert(result.dormant.end(), make_move_iterator(partResult.dormant.begin()),
+                                  make_move_iterator(partResult.dormant.end()));
+        }
+        
+        start = chrono::steady_clock::now();
+        bool durable = FileManager::waitTransactionDurable(lastSeq);
+        if (!durable || replication) {
+            forEachRange(parts, parts, [&](size_t part, size_t, size_t) {
+                for (const auto& item : partResults[part].applied) {
+                    Account& account = *item.first;
+                    AccountLocks::WriteGuard guard(locks, &account);
+                    if (!durable) {
+                        revertDelta(account, item.second);
+                    } else {
+                        Money amount = Money::fromFen(item.second > 0 ? item.second : -item.second);
+                        replication->publishTransaction(Transaction(account.getAccountNumber(),
+                                                                    item.second > 0 ? "INTEREST" : "FEE", amount, date, time));
+                    }
+                    // 撤销时同样发布，备库上被联机交易带过去的未确认余额随之恢复
+                    if (replication) {
+                        replication->publishAccount(account);
+                    }
+                }
+            });
+        }
+        // 撤销后同样整表持久化一次，覆盖联机交易期间可能已写出的未确认余额
+        if (result.postings > 0) {
+            persistAllAccounts();
+        }
+        result.persistMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        return durable ? OP_OK : OP_FAILED;
+    }
+    
+    // 后台批处理：不校验密码，直接把会话绑定到账户
+    OpStatus attachAccount(Session& session, const string& accountNumber) {
+        Account* account = findAccount(accountNumber);
+        if (!account) {
+            return OP_NO_ACCOUNT;
+        }
+        session.currentAccount = account;
+        session.isLoggedIn = true;
+        return OP_OK;
+    }
+    
+    void beginBatch(Session& session) {
+        session.batchMode = true;
+        session.batchDeltas.clear();
+        session.batchTransactions.clear();
+        session.lastSeq = 0;
+    }
+    
+    // 确认批处理：先等批内最后一条交易记录落盘，再发布到复制流并一次性持久化改动过的账户
+    // 未能落盘时倒序撤销整批的余额变动，持久化撤销后的余额（覆盖其他会话期间可能写出的未确认余额），返回 OP_FAILED
+    OpStatus commitBatch(Session& session) {
+        bool durable = FileManager::waitTransactionDurable(session.lastSeq);
+        vector<Account*> dirty;
+        dirty.reserve(session.batchDeltas.size());
+        for (auto it = session.batchDeltas.rbegin(); it != session.batchDeltas.rend(); ++it) {
+            dirty.push_back(it->first);
+            if (!durable) {
+                AccountLocks::WriteGuard guard(locks, it->first);
+                if (!revertDelta(*it->first, it->second)) {
+                    cerr << "Cannot revert batch change on account " << it->first->getAccountNumber() << endl;
+                }
+            }
+        }
+        sort(dirty.begin(), dirty.end());
+        dirty.erase(unique(dirty.begin(), dirty.end()), dirty.end());
+        
+        if (replication) {
+            if (durable) {
+                for (const Transaction& trans : session.batchTransactions) {
+                    replication->publishTransaction(trans);
+                }
+            }
+            // 撤销时同样发布，备库上被其他会话带过去的未确认余额随之恢复
+            for (Account* account : dirty) {
+                lock_guard<mutex> stripe(locks.stripeMutex(account));
+                replication->publishAccount(*account);
+            }
+        }
+        
+        if (storageMode == STORAGE_CSV) {
+            if (shards.size() > 0) {
+                for (Account* account : dirty) {
+                    shards.markDirty(shards.shardOf(account->getAccountNumber()));
+                }
+            }
+            if (!dirty.empty()) {
+                saveAllAccounts();
+            }
+        } else if (storageMode == STORAGE_LAZY) {
+            AccountLocks::AllGuard all(locks);
+            lock_guard<mutex> lock(tableMutex);
+            for (Account* account : dirty) {
+                lazyDirty.insert(account->getAccountNumber());
+            }
+            flushLazyDirty();
+        } else if (storageMode == STORAGE_JOURNAL) {
+            // 整批追加完只 fsync 一次
+            for (Account* account : dirty) {
+                lock_guard<mutex> stripe(locks.stripeMutex(account));
+                lock_guard<mutex> lock(persistMutex);
+                appendJournal(account);
+            }
+            lock_guard<mutex> lock(persistMutex);
+            journal.commit();
+        } else {
+            for (Account* account : dirty) {
+                AccountLocks::WriteGuard guard(locks, account);
+                persistAccounts(guard, account);
+            }
+            if (storageMode == STORAGE_BINARY) {
+                store.flush();
+            }
+        }
+        
+        session.batchMode = false;
+        session.batchDeltas.clear();
+        session.batchTransactions.clear();
+        session.lastSeq = 0;
+        return durable ? OP_OK : OP_FAILED;
+    }
+    
+    // 读取当前账户信息的副本
+    Account snapshot(Session& session) {
+        if (!session.currentAccount) {
+            return Account();
+        }
+        lock_guard<mutex> lock(locks.stripeMutex(session.currentAccount));
+        return *session.currentAccount;
+    }
+    
+    // 已加载账户的余额合计；锁住全部条带，读到的是没有转账进行到一半的一致快照
+    Money totalBalance() {
+        AccountLocks::AllGuard all(locks);
+        lock_guard<mutex> lock(tableMutex);
+        Money total;
+        for (const Account& account : accounts) {
+            total.checkedAdd(account.getBalance(), total);
+        }
+        return total;
+    }
+    
+private:
+    OpStatus doLogin(Session& session, const string& accountNumber, const string& password) {
+        Account* account = findAccount(accountNumber);
+        if (!account) {
+            return OP_NO_ACCOUNT;
+        }
+        if (FileManager::isAccountLocked(accountNumber)) {
+            return OP_ACCOUNT_LOCKED;
+        }
+        
+        bool matched;
+        {
+            lock_guard<mutex> lock(locks.stripeMutex(account));
+            matched = account->verifyPassword(password);
+        }
+        // 锁定和计数都在 attemptsMutex 内判断：并发连接中比锁定晚一步的登录不论密码对错都被拒绝
+        lock_guard<mutex> lock(attemptsMutex);
+        if (FileManager::isAccountLocked(accountNumber)) {
+            return OP_ACCOUNT_LOCKED;
+        }
+        auto it = loginFailures.find(accountNumber);
+        if (it != loginFailures.end() && it->second >= MAX_LOGIN_ATTEMPTS) {
+            // 计数停在上限而账户已不在锁定表中，说明管理员已解锁，重新计数
+            loginFailures.erase(it);
+        }
+        if (matched) {
+            loginFailures.erase(accountNumber);
+            session.currentAccount = account;
+            session.isLoggedIn = true;
+            return OP_OK;
+        }
+        
+        // 错误次数记在账号上，换终端或重新连接都不会清零；锁定后停在上限，直到管理员解锁
+        if (++loginFailures[accountNumber] >= MAX_LOGIN_ATTEMPTS) {
+            FileManager::lockAccount(accountNumber);
+            return OP_TOO_MANY_ATTEMPTS;
+        }
+        return OP_WRONG_PASSWORD;
+    }
+    
+    OpStatus doWithdraw(Session& session, Money amount) {
+        if (!session.isLoggedIn || !session.currentAccount) {
+            return OP_NOT_LOGGED_IN;
+        }
+        if (!amount.isPositive()) {
+            return OP_INVALID_AMOUNT;
+        }
+        if (amount.toFen() % Money::fromYuan(WITHDRAWAL_MULTIPLE).toFen() != 0) {
+            return OP_NOT_MULTIPLE;
+        }
+        if (amount > SINGLE_WITHDRAWAL_LIMIT) {
+            return OP_SINGLE_LIMIT;
+        }
+        if (!FileManager::transactionLogHealthy()) {
+            return OP_FAILED;
+        }
+        
+        Account* account = session.currentAccount;
+        AccountLocks::WriteGuard guard(locks, account);
+        Money todayTotal = FileManager::getTodayWithdrawalTotal(account->getAccountNumber());
+        Money newTotal;
+        if (!todayTotal.checkedAdd(amount, newTotal) || newTotal > DAILY_WITHDRAWAL_LIMIT) {
+            return OP_DAILY_LIMIT;
+        }
+        if (amount > account->getBalance()) {
+            return OP_INSUFFICIENT_BALANCE;
+        }
+        if (!account->withdraw(amount)) {
+            return OP_FAILED;
+        }
+        
+        return commitMutation(session, guard, newTransaction(session, "WITHDRAWAL", amount), -amount.toFen(), account);
+    }
+    
+    OpStatus doTransfer(Session& session, const string& targetAccountNumber, Money amount) {
+        OpStatus status = checkTransferTarget(session, targetAccountNumber);
+        if (status != OP_OK) {
+            return status;
+        }
+        if (!amount.isPositive()) {
+            return OP_INVALID_AMOUNT;
+        }
+        if (!FileManager::transactionLogHealthy()) {
+            return OP_FAILED;
+        }
+        
+        Account* source = session.currentAccount;
+        Account* target = findAccount(targetAccountNumber);
+        AccountLocks::WriteGuard guard(locks, source, target);
+        if (amount > source->getBalance()) {
+            return OP_INSUFFICIENT_BALANCE;
+        }
+        if (!source->transfer(amount, *target)) {
+            return OP_FAILED;
+        }
+        
+        return commitMutation(session, guard, newTransaction(session, "TRANSFER", amount, targetAccountNumber),
+                              -amount.toFen(), source, target);
+    }
+    
+    // 打开二进制账户文件，不存在时从 CSV 账户文件转换生成
+    void openBinaryStore() {
+        if (store.open(ACCOUNTS_BINARY_FILE)) {
+            return;
+        }
+        
+        accounts = FileManager::loadAccounts();
+        if (accounts.empty()) {
+            createSampleAccounts();
+        }
+        if (!MappedAccountStore::write(ACCOUNTS_BINARY_FILE, accounts)) {
+            throw runtime_error("cannot write " + ACCOUNTS_BINARY_FILE);
+        }
+        accounts.clear();
+        
+        if (!store.open(ACCOUNTS_BINARY_FILE)) {
+            throw runtime_error("cannot open " + ACCOUNTS_BINARY_FILE);
+        }
+    }
+    
+    // 打开分片账户文件，没有分片清单时从 accounts.dat 迁移；预写日志中残留的变更先写回对应分片
+    void openShards(size_t shardCount) {
+        if (shards.open(shardCount)) {
+            if (!shards.load(accounts)) {
+                throw runtime_error("cannot read account shards listed in " + ACCOUNTS_SHARD_MANIFEST);
+            }
+        } else {
+            FileManager::readAccountsFile(ACCOUNTS_FILE, accounts);
+            if (accounts.empty()) {
+                createSampleAccounts();
+            }
+            if (!shards.create(accounts)) {
+                throw runtime_error("cannot create account shards");
+            }
+        }
+        
+        AccountJournal pending;
+        AccountTable replayed;
+        AccountJournal::replay(pending.getRotatedFileName(), replayed);
+        AccountJournal::replay(pending.getFileName(), replayed);
+        for (const Account& account : replayed) {
+            accounts.upsert(account);
+        }
+        shards.attach(accounts);
+        if (!replayed.empty()) {
+            for (const Account& account : replayed) {
+                shards.markDirty(shards.shardOf(account.getAccountNumber()));
+            }
+            if (flushDirtyShards()) {
+                pending.finishCheckpoint();
+                remove(pending.getFileName().c_str());
+            }
+        }
+    }
+    
+    // 写出一个脏分片：逐个锁住成员账户的条带取副本，调用方不能持有任何条带锁
+    // 锁顺序为分片写锁 → 条带锁；标记之后已被其他线程写出时直接返回
+    bool flushShard(size_t shard) {
+        lock_guard<mutex> lock(shards.writeMutex(shard));
+        if (!shards.takeDirty(shard)) {
+            return true;
+        }
+        const vector<Account*>& members = shards.members(shard);
+        vector<Account> snapshot;
+        snapshot.reserve(members.size());
+        for (Account* account : members) {
+            lock_guard<mutex> stripe(locks.stripeMutex(account));
+            snapshot.push_back(*account);
+        }
+        
+        MetricTimer timer(METRIC_SAVE_ACCOUNTS);
+        if (timer.finish(AccountShards::write(shard, snapshot) ? OP_OK : OP_FAILED) != OP_OK) {
+            shards.markDirty(shard);
+            return false;
+        }
+        return true;
+    }
+    
+    // 并行写出全部脏分片
+    bool flushDirtyShards() {
+        atomic<bool> ok(true);
+        forEachRange(shards.size(), thread::hardware_concurrency(), [&](size_t, size_t from, size_t to) {
+            for (size_t shard = from; shard < to; shard++) {
+                if (!flushShard(shard)) {
+                    ok = false;
+                }
+            }
+        });
+        return ok;
+    }
+    
+    // 建立账户文件索引；预写日志中残留未合并的变更时，先作为脏账户写回
+    void openLazyFile() {
+        lazyFile.open();
+        
+        AccountJournal pending;
+        AccountTable replayed;
+        AccountJournal::replay(pending.getRotatedFileName(), replayed);
+        AccountJournal::replay(pending.getFileName(), replayed);
+        if (!replayed.empty()) {
+            for (const Account& account : replayed) {
+                accounts.upsert(account);
+                lazyDirty.insert(account.getAccountNumber());
+            }
+            if (flushLazyDirty()) {
+                pending.finishCheckpoint();
+                remove(pending.getFileName().c_str());
+            }
+        }
+        
+        if (lazyFile.empty() && accounts.empty()) {
+            createSampleAccounts();
+        }
+    }
+    
+    // 写回脏账户，调用方需锁住全部条带和 tableMutex（构造和析构时除外）
+    bool flushLazyDirty() {
+        if (lazyDirty.empty()) {
+            return true;
+        }
+        if (!lazyFile.save(accounts, lazyDirty)) {
+            return false;
+        }
+        lazyDirty.clear();
+        return true;
+    }
+    
+    // 逐个锁住账户所在条带复制账户，调用方不能持有任何条带锁
+    void copyAccounts(const vector<Account*>& found, vector<Account>& result) {
+        result.reserve(result.size() + found.size());
+        for (Account* account : found) {
+            lock_guard<mutex> stripe(locks.stripeMutex(account));
+            result.push_back(*account);
+        }
+    }
+    
+    // 按账号查找账户，不存在返回 nullptr（不会插入空账户）
+    // 其余模式的账户表在构造后不再变化，查找不加锁；按需加载的模式查找可能插入，需持有 tableMutex
+    Account* findAccount(const string& accountNumber) {
+        if (storageMode != STORAGE_BINARY && storageMode != STORAGE_LAZY) {
+            return accounts.find(accountNumber);
+        }
+        
+        lock_guard<mutex> lock(tableMutex);
+        Account* account = accounts.find(accountNumber);
+        if (account) {
+            return account;
+        }
+        
+        if (storageMode == STORAGE_BINARY) {
+            AccountRecord* record = store.find(accountNumber);
+            if (record) {
+                return &accounts.upsert(MappedAccountStore::toAccount(*record));
+            }
+        } else if (storageMode == STORAGE_LAZY) {
+            Account loaded;
+            if (lazyFile.read(accountNumber, loaded)) {
+                return &accounts.upsert(loaded);
+            }
+        }
+        return nullptr;
+    }
+    
+    // 余额变动后的提交：交易记录落盘后才发布到复制流并持久化，未能落盘时撤销内存中的变动并返回 OP_FAILED，
+    // 失败的操作不会写进账户文件，也不会发给备库。deltaFen 为 account 的余额变动，other 的变动与之相反
+    // 普通会话等待落盘期间一直持有条带锁，其他会话写不出这笔未确认的余额；批处理会话只记下变动，由 commitBatch 确认
+    // 进入时持有 guard，返回时已释放
+    OpStatus commitMutation(Session& session, AccountLocks::WriteGuard& guard, const Transaction& trans,
+                            int64_t deltaFen, Account* account, Account* other = nullptr) {
+        // 内存中的余额已改完，之后的等待和落盘期间余额查询不必重读
+        guard.endWrite();
+        uint64_t seq = FileManager::logTransaction(trans);
+        if (session.batchMode) {
+            session.batchDeltas.emplace_back(account, deltaFen);
+            if (other) {
+                session.batchDeltas.emplace_back(other, -deltaFen);
+            }
+            if (replication) {
+                session.batchTransactions.push_back(trans);
+            }
+            session.lastSeq = seq;
+            guard.unlock();
+            return OP_OK;
+        }
+        
+        if (!FileManager::waitTransactionDurable(seq)) {
+            guard.beginWrite();
+            revertDelta(*account, deltaFen);
+            if (other) {
+                revertDelta(*other, -deltaFen);
+            }
+            guard.unlock();
+            return OP_FAILED;
+        }
+        
+        // 仍持有条带锁，同一账户的变更按提交顺序进入复制流
+        if (replication) {
+            replication->publishTransaction(trans);
+            replication->publishAccount(*account);
+            if (other) {
+                replication->publishAccount(*other);
+            }
+        }
+        persistAccounts(guard, account, other);
+        return OP_OK;
+    }
+    
+    // 撤销一笔未确认的余额变动，调用方持有账户的条带锁
+    static bool revertDelta(Account& account, int64_t deltaFen) {
+        Money amount = Money::fromFen(deltaFen > 0 ? deltaFen : -deltaFen);
+        return deltaFen > 0 ? account.withdraw(amount) : account.deposit(amount);
+    }
+    
+    // 持久化刚修改过的一个或两个账户；进入时持有它们的条带锁，返回时已释放，落盘前先结束写入标记
+    // 整表写出的模式（csv、lazy）要锁住全部条带，先释放自己持有的条带再加锁
+    void persistAccounts(AccountLocks::WriteGuard& guard, const Account* account, const Account* other = nullptr) {
+        guard.endWrite();
+        switch (storageMode) {
+            case STORAGE_JOURNAL: {
+                lock_guard<mutex> lock(persistMutex);
+                appendJournal(account, other);
+                journal.commit();
+                break;
+            }
+            case STORAGE_BINARY:
+                // 每个账户对应映射文件中独立的记录，持有条带锁即可原地更新
+                for (const Account* changed : {account, other}) {
+                    AccountRecord* record = changed ? store.find(changed->getAccountNumber()) : nullptr;
+                    if (record) {
+                        MappedAccountStore::update(*record, *changed);
+                    }
+                }
+                break;
+            case STORAGE_MEMORY:
+                break;
+            case STORAGE_LAZY: {
+                {
+                    lock_guard<mutex> lock(persistMutex);
+                    lazyDirty.insert(account->getAccountNumber());
+                    if (other) {
+                        lazyDirty.insert(other->getAccountNumber());
+                    }
+                }
+                guard.unlock();
+                AccountLocks::AllGuard all(locks);
+                lock_guard<mutex> lock(tableMutex);
+                flushLazyDirty();
+                break;
+            }
+            default:
+                if (shards.size() > 0) {
+                    // 只重写这一两个账户所在的分片，不锁整表
+                    size_t shard = shards.shardOf(account->getAccountNumber());
+                    size_t otherShard = other ? shards.shardOf(other->getAccountNumber()) : shard;
+                    shards.markDirty(shard);
+                    shards.markDirty(otherShard);
+                    guard.unlock();
+                    flushShard(shard);
+                    if (otherShard != shard) {
+                        flushShard(otherShard);
+                    }
+                    break;
+                }
+                guard.unlock();
+                saveAllAccounts();
+                break;
+        }
+        guard.unlock();
+    }
+    
+    // 把账户追加到预写日志，不 fsync；调用方持有它们的条带锁和 persistMutex
+    void appendJournal(const Account* account, const Account* other = nullptr) {
+        for (const Account* changed : {account, other}) {
+            if (!changed) {
+                continue;
+            }
+            journal.append(*changed);
+            // 分片存储时检查点只写出这些分片
+            if (shards.size() > 0) {
+                shards.markDirty(shards.shardOf(changed->getAccountNumber()));
+            }
+        }
+    }
+    
+    // 全部账户都有变动时整表持久化一次：CSV 模式整表写出，日志模式直接做检查点，分片全部重写
+    void persistAllAccounts() {
+        for (size_t shard = 0; shard < shards.size(); shard++) {
+            shards.markDirty(shard);
+        }
+        if (storageMode == STORAGE_CSV) {
+            saveAllAccounts();
+        } else if (storageMode == STORAGE_JOURNAL) {
+            checkpoint();
+        }
+    }
+    
+    // 整表写出账户文件（分片存储时并行写出脏分片），调用方不能持有任何条带锁
+    void saveAllAccounts() {
+        if (shards.size() > 0) {
+            flushDirtyShards();
+            return;
+        }
+        AccountLocks::AllGuard all(locks);
+        FileManager::saveAccounts(accounts);
+    }
+    
+    // 检查点：把预写日志合并进账户文件
+    void checkpoint() {
+        lock_guard<mutex> running(checkpointRunMutex);
+        if (shards.size() > 0) {
+            checkpointShards();
+            return;
+        }
+        AccountTable snapshot;
+        {
+            AccountLocks::AllGuard all(locks);
+            {
+                lock_guard<mutex> persistLock(persistMutex);
+                journal.rotate();
+            }
+            snapshot = accounts;
+        }
+        if (FileManager::saveAccounts(snapshot)) {
+            journal.finishCheckpoint();
+        }
+    }
+    
+    // 分片检查点：锁住全部条带轮换日志并复制脏分片的账户，之后各分片并行写出
+    // 有分片写失败时重新标记，保留 .old 日志，下次检查点重试
+    void checkpointShards() {
+        size_t count = shards.size();
+        vector<vector<Account>> snapshots(count);
+        vector<char> dirty(count, 0);
+        {
+            AccountLocks::AllGuard all(locks);
+            {
+                lock_guard<mutex> persistLock(persistMutex);
+                journal.rotate();
+            }
+            for (size_t shard = 0; shard < count; shard++) {
+                if (shards.takeDirty(shard)) {
+                    dirty[shard] = 1;
+                    for (const Account* account : shards.members(shard)) {
+                        snapshots[shard].push_back(*account);
+                    }
+                }
+            }
+        }
+        
+        atomic<bool> ok(true);
+        forEachRange(count, thread::hardware_concurrency(), [&](size_t, size_t from, size_t to) {
+            for (size_t shard = from; shard < to; shard++) {
+                if (!dirty[shard]) {
+                    continue;
+                }
+                MetricTimer timer(METRIC_SAVE_ACCOUNTS);
+                if (timer.finish(AccountShards::write(shard, snapshots[shard]) ? OP_OK : OP_FAILED) != OP_OK) {
+                    shards.markDirty(shard);
+                    ok = false;
+                }
+            }
+        });
+        if (ok) {
+            journal.finishCheckpoint();
+        }
+    }
+    
+    void checkpointLoop() {
+        unique_lock<mutex> lock(checkpointMutex);
+        while (!stopping) {
+            checkpointCv.wait_for(lock, chrono::seconds(CHECKPOINT_INTERVAL_SECONDS));
+            if (stopping) {
+                break;
+            }
+            size_t pending;
+            {
+                lock_guard<mutex> persistLock(persistMutex);
+                pending = journal.pending();
+            }
+            if (pending == 0) {
+                continue;
+            }
+            lock.unlock();
+            checkpoint();
+            lock.lock();
+        }
+    }
+    
+    // 当前账户的一条交易记录，时间取当前时刻
+    static Transaction newTransaction(Session& session, const string& type, Money amount, const string& targetAccount = "") {
+        return Transaction(session.currentAccount->getAccountNumber(), type, amount,
+                           currentDateString(), currentTimeString(), targetAccount);
+    }
+    
+    // 记录不涉及资金变动的交易（余额查询），立即发布到复制流；返回日志序号
+    uint64_t recordTransaction(Session& session, const string& type, Money amount, const string& targetAccount = "") {
+        Transaction trans = newTransaction(session, type, amount, targetAccount);
+        if (replication) {
+            replication->publishTransaction(trans);
+        }
+        return FileManager::logTransaction(trans);
+    }
+};
+
+// 控制台 ATM：负责交互式输入输出，业务逻辑交给 Bank
+// 出钞策略：张数最少，或尽量平均地从各钞箱出钞（单个钞箱出的张数最多者最少）
+enum DispensePolicy {
+    DISPENSE_FEWEST_NOTES,
+    DISPENSE_BALANCED,
+    DISPENSE_POLICY_COUNT
+};
+
+// 钞箱库存与出钞方案。每个可取金额（WITHDRAWAL_MULTIPLE 的倍数，不超过单笔限额）的全部面额组合
+// 启动时按两种策略各排好序；每个金额记录当前库存下第一个够出的组合。库存只减少时游标只会后移，
+// 出钞后只需检查各金额当前的组合是否仍然够出，查询是一次数组访问；补钞或切换策略时游标从头重找
+class CashDispenser {
+public:
+    typedef array<int, CASSETTE_COUNT> Notes;  // 各钞箱张数，顺序同 NOTE_DENOMINATIONS
+    
+private:
+    typedef array<uint16_t, CASSETTE_COUNT> Combination;
+    
+    // 各金额的组合在 combinations 中连续存放，[begin[k], begin[k + 1]) 为第 k 个金额的组合
+    struct Plans {
+        vector<Combination> combinations[DISPENSE_POLICY_COUNT];
+        vector<size_t> begin;
+    };
+    
+    Notes counts;
+    DispensePolicy policy;
+    vector<size_t> cursor;
+    string fileName;
+    
+    static size_t amountCount() {
+        return (size_t)(SINGLE_WITHDRAWAL_LIMIT.toFen() / Money::fromYuan(WITHDRAWAL_MULTIPLE).toFen());
+    }
+    
+    static int notesIn(const Combination& c) {
+        int total = 0;
+        for (uint16_t n : c) {
+            total += n;
+        }
+        return total;
+    }
+    
+    static int largestDraw(const Combination& c) {
+        return *max_element(c.begin(), c.end());
+    }
+    
+    // 策略相同时按大面额张数多者优先，保证顺序唯一
+    static bool better(DispensePolicy policy, const Combination& a, const Combination& b) {
+        if (policy == DISPENSE_BALANCED && largestDraw(a) != largestDraw(b)) {
+            return largestDraw(a) < largestDraw(b);
+        }
+        if (notesIn(a) != notesIn(b)) {
+            return notesIn(a) < notesIn(b);
+        }
+        return a > b;
+    }
+    
+    // 枚举凑出 remaining 元的全部组合，最小面额的张数由余数决定
+    template <typename Fn>
+    static void forEachCombination(int remaining, size_t cassette, Combination& c, Fn&& fn) {
+        if (cassette + 1 == CASSETTE_COUNT) {
+            if (remaining % NOTE_DENOMINATIONS[cassette] == 0) {
+                c[cassette] = (uint16_t)(remaining / NOTE_DENOMINATIONS[cassette]);
+                fn(c);
+            }
+            return;
+        }
+        for (int n = 0; n * NOTE_DENOMINATIONS[cassette] <= remaining; n++) {
+            c[cassette] = (uint16_t)n;
+            forEachCombination(remaining - n * NOTE_DENOMINATIONS[cassette], cassette + 1, c, fn);
+        }
+    }
+    
+    static const Plans& plans() {
+        static const Plans table = [] {
+            Plans built;
+            built.begin.push_back(0);
+            for (size_t k = 0; k < amountCount(); k++) {
+                vector<Combination> found;
+                Combination c{};
+                forEachCombination((int)(k + 1) * WITHDRAWAL_MULTIPLE, 0, c, [&](const Combination& combination) {
+                    found.push_back(combination);
+                });
+                for (int policy = 0; policy < DISPENSE_POLICY_COUNT; policy++) {
+                    sort(found.begin(), found.end(), [policy](const Combination& a, const Combination& b) {
+                        return better((DispensePolicy)policy, a, b);
+                    });
+                    built.combinations[policy].insert(built.combinations[policy].end(), found.begin(), found.end());
+                }
+                built.begin.push_back(built.combinations[0].size());
+            }
+            return built;
+        }();
+        return table;
+    }
+    
+    bool covers(const Combination& c) const {
+        for (size_t i = 0; i < CASSETTE_COUNT; i++) {
+            if (c[i] > counts[i]) {
+                return false;
+            }
+        }
+        return true;
+    }
+    
+    // 把各金额的游标后移到第一个库存够出的组合
+    void advanceCursors() {
+        const Plans& table = plans();
+        const vector<Combination>& combinations = table.combinations[policy];
+        for (size_t k = 0; k < cursor.size(); k++) {
+            while (cursor[k] < table.begin[k + 1] && !covers(combinations[cursor[k]])) {
+                cursor[k]++;
+            }
+        }
+    }
+    
+    void resetCursors() {
+        const Plans& table = plans();
+        cursor.assign(table.begin.begin(), table.begin.end() - 1);
+        advanceCursors();
+    }
+    
+    static OpStatus amountIndex(Money amount, size_t& index) {
+        if (!amount.isPositive()) {
+            return OP_INVALID_AMOUNT;
+        }
+        if (amount.toFen() % Money::fromYuan(WITHDRAWAL_MULTIPLE).toFen() != 0) {
+            return OP_NOT_MULTIPLE;
+        }
+        if (amount > SINGLE_WITHDRAWAL_LIMIT) {
+            return OP_SINGLE_LIMIT;
+        }
+        index = (size_t)(amount.toFen() / Money::fromYuan(WITHDRAWAL_MULTIPLE).toFen()) - 1;
+        return OP_OK;
+    }
+    
+    static Notes toNotes(const Combination& c) {
+        Notes notes;
+        for (size_t i = 0; i < CASSETTE_COUNT; i++) {
+            notes[i] = c[i];
+        }
+        return notes;
+    }
+    
+public:
+    // fileName 为空时不读写库存文件
+    explicit CashDispenser(const string& file = "", DispensePolicy p = DISPENSE_FEWEST_NOTES) : policy(p), fileName(file) {
+        counts.fill(DEFAULT_CASSETTE_NOTES);
+        if (!fileName.empty()) {
+            load();
+        }
+        resetCursors();
+    }
+    
+    const Notes& inventory() const {
+        return counts;
+    }
+    
+    DispensePolicy getPolicy() const {
+        return policy;
+    }
+    
+    Money totalCash() const {
+        int64_t total = 0;
+        for (size_t i = 0; i < CASSETTE_COUNT; i++) {
+            total += (int64_t)counts[i] * NOTE_DENOMINATIONS[i];
+        }
+        return Money::fromYuan(total);
+    }
+    
+    // 按当前库存和策略给出方案，不修改库存
+    OpStatus plan(Money amount, Notes& notes) const {
+        size_t k;
+        OpStatus status = amountIndex(amount, k);
+        if (status != OP_OK) {
+            return status;
+        }
+        if (cursor[k] == plans().begin[k + 1]) {
+            return OP_CANNOT_DISPENSE;
+        }
+        notes = toNotes(plans().combinations[policy][cursor[k]]);
+        return OP_OK;
+    }
+    
+    // 出钞后扣减库存并写回库存文件
+    void dispense(const Notes& notes) {
+        for (size_t i = 0; i < CASSETTE_COUNT; i++) {
+            counts[i] -= notes[i];
+        }
+        advanceCursors();
+        save();
+    }
+    
+    void refill(const Notes& notes) {
+        counts = notes;
+        resetCursors();
+        save();
+    }
+    
+    void setPolicy(DispensePolicy p) {
+        policy = p;
+        resetCursors();
+    }
+    
+    // 不查表，逐个枚举该金额的组合取最优者，用于性能对比和核对
+    static OpStatus search(Money amount, const Notes& counts, DispensePolicy policy, Notes& notes) {
+        size_t k;
+        OpStatus status = amountIndex(amount, k);
+        if (status != OP_OK) {
+            return status;
+        }
+        bool found = false;
+        Combination best{}, c{};
+        forEachCombination((int)(k + 1) * WITHDRAWAL_MULTIPLE, 0, c, [&](const Combination& combination) {
+            for (size_t i = 0; i < CASSETTE_COUNT; i++) {
+                if (combination[i] > counts[i]) {
+                    return;
+                }
+            }
+            if (!found || better(policy, combination, best)) {
+                best = combination;
+                found = true;
+            }
+        });
+        if (!found) {
+            return OP_CANNOT_DISPENSE;
+        }
+        notes = toNotes(best);
+        return OP_OK;
+    }
+    
+    // 每行 <面额>,<张数>，缺少的面额按默认张数
+    void load() {
+        ifstream file(fileName);
+        string line;
+        while (getline(file, line)) {
+            int denomination = 0, count = 0;
+            if (sscanf(line.c_str(), "%d,%d", &denomination, &count) != 2 || count < 0) {
+                continue;
+            }
+            for (size_t i = 0; i < CASSETTE_COUNT; i++) {
+                if (NOTE_DENOMINATIONS[i] == denomination) {
+                    counts[i] = count;
+                }
+            }
+        }
+    }
+    
+    bool save() const {
+        if (fileName.empty()) {
+            return true;
+        }
+        string tempFile = fileName + ".tmp";
+        ofstream file(tempFile);
+        if (!file.is_open()) {
+            return false;
+        }
+        for (size_t i = 0; i < CASSETTE_COUNT; i++) {
+            file << NOTE_DENOMINATIONS[i] << ',' << counts[i] << '\n';
+        }
+        file.close();
+        if (!file) {
+            return false;
+        }
+        // 直接改名覆盖，崩溃后不会因为库存文件缺失而按默认张数重新装载
+        return replaceFile(tempFile, fileName);
+    }
+    
+    static string describe(const Notes& notes) {
+        string text;
+        for (size_t i = 0; i < CASSETTE_COUNT; i++) {
+            if (notes[i] > 0) {
+                text += (text.empty() ? "" : " ") + to_string(NOTE_DENOMINATIONS[i]) + "x" + to_string(notes[i]);
+            }
+        }
+        return text;
+    }
+};
+
+class ATM {
+private:
+    Bank& bank;
+    Session session;
+    string metricsFile;
+    CashDispenser dispenser;
+    // 本次输入的账户因密码错误次数过多被锁定
+    bool lockedOut;
+    
+    // 读取金额，输入非法时清理输入流
+    bool readAmount(Money& amount) {
+        string text;
+        cin >> text;
+        if (cin.fail() || !Money::parse(text, amount) || !amount.isPositive()) {
+            cin.clear();
+            cin.ignore(numeric_limits<streamsize>::max(), '\n');
+            cout << "Invalid amount!" << endl;
+            return false;
+        }
+        return true;
+    }
+    
+public:
+    ATM(Bank& b, const string& metrics = METRICS_FILE, DispensePolicy policy = DISPENSE_FEWEST_NOTES)
+        : bank(b), metricsFile(metrics), dispenser(CASSETTES_FILE, policy), lockedOut(false) {}
+    
+    void showWelcome() {
+        cout << "\nWelcome to ATM Simulation System" << endl;
+        cout << "Please insert your card (enter account number), type 'admin' for the admin menu or 'exit' to quit" << endl;
+    }
+    
+    void printAccountList(OpStatus status, const vector<Account>& found) {
+        if (status != OP_OK) {
+            cout << opStatusMessage(status) << endl;
+            return;
+        }
+        for (const Account& account : found) {
+            cout << account.getAccountNumber() << "  " << account.getName() << "  " << account.getIdCard()
+                 << "  " << account.getBalance() << endl;
+        }
+        cout << found.size() << " account(s)" << endl;
+    }
+    
+    void showCassettes() {
+        const CashDispenser::Notes& counts = dispenser.inventory();
+        cout << "\nCash Cassettes ("
+             << (dispenser.getPolicy() == DISPENSE_BALANCED ? "balanced" : "fewest notes") << ")" << endl;
+        for (size_t i = 0; i < CASSETTE_COUNT; i++) {
+            cout << "¥" << NOTE_DENOMINATIONS[i] << " notes: " << counts[i] << endl;
+        }
+        cout << "Total cash: ¥" << dispenser.totalCash() << endl;
+    }
+    
+    // 补钞：依次输入各面额钞箱的张数
+    void refillCassettes() {
+        CashDispenser::Notes counts;
+        for (size_t i = 0; i < CASSETTE_COUNT; i++) {
+            cout << "Please enter number of ¥" << NOTE_DENOMINATIONS[i] << " notes: ";
+            if (!(cin >> counts[i]) || counts[i] < 0 || counts[i] > UINT16_MAX) {
+                cin.clear();
+                cin.ignore(numeric_limits<streamsize>::max(), '\n');
+                cout << "Invalid count!" << endl;
+                return;
+            }
+        }
+        dispenser.refill(counts);
+        showCassettes();
+    }
+    
+    // 管理菜单：查看运行指标摘要、立即写出指标文件，按身份证号、姓名查找账户，或查看、补充钞箱
+    void adminMenu() {
+        int choice = 0;
+        while (choice != 7) {
+            cout << "\nAdmin Menu" << endl;
+            cout << "1. Metrics Summary" << endl;
+            cout << "2. Write Metrics File (" << metricsFile << ")" << endl;
+            cout << "3. Find Accounts by ID Card" << endl;
+            cout << "4. Find Accounts by Name Prefix" << endl;
+            cout << "5. Cash Cassettes" << endl;
+            cout << "6. Refill Cassettes" << endl;
+            cout << "7. Back" << endl;
+            if (!(cin >> choice)) {
+                if (cin.eof()) {
+                    return;
+                }
+                cin.clear();
+                cin.ignore(numeric_limits<streamsize>::max(), '\n');
+                choice = 0;
+            }
+            
+            switch (choice) {
+                case 1:
+                    cout << endl;
+                    Metrics::printSummary(cout);
+                    break;
+                case 2:
+                    if (Metrics::writePrometheusFile(metricsFile)) {
+                        cout << "Metrics written to " << metricsFile << endl;
+                    } else {
+                        cout << "Cannot write " << metricsFile << endl;
+                    }
+                    break;
+                case 3: {
+                    string idCard;
+                    cout << "Please enter ID card number: ";
+                    cin >> idCard;
+                    vector<Account> found;
+                    printAccountList(bank.findAccountsByIdCard(idCard, found), found);
+                    break;
+                }
+                case 4: {
+                    // 姓名可以含空格，读取整行
+                    string prefix;
+                    cout << "Please enter name prefix: ";
+                    cin >> ws;
+                    getline(cin, prefix);
+                    vector<Account> found;
+                    printAccountList(bank.findAccountsByName(prefix, DEFAULT_NAME_SEARCH_LIMIT, found), found);
+                    break;
+                }
+                case 5:
+                    showCassettes();
+                    break;
+                case 6:
+                    refillCassettes();
+                    break;
+                case 7:
+                    break;
+                default:
+                    cout << "Invalid choice, please re-enter!" << endl;
+                    break;
+            }
+        }
+    }
+    
+    bool login() {
+        string accountNumber, password;
+        
+        cout << "\nPlease enter your 19-digit account number: ";
+        cin >> accountNumber;
+        
+        if (accountNumber == "exit") {
+            return false;
+        }
+        if (accountNumber == "admin") {
+            adminMenu();
+            return false;
+        }
+        
+        OpStatus status = bank.checkAccount(accountNumber);
+        if (status != OP_OK) {
+            cout << opStatusMessage(status) << endl;
+            return false;
+        }
+        
+        cout << "Please enter 6-digit password: ";
+        cin >> password;
+        
+        status = bank.login(session, accountNumber, password);
+        if (status == OP_OK) {
+            cout << "\nLogin successful! Welcome " << session.currentAccount->getName() << " !" << endl;
+            return true;
+        }
+        
+        if (status == OP_WRONG_PASSWORD) {
+            cout << "Wrong password! Remaining attempts: " << bank.remainingLoginAttempts(accountNumber) << endl;
+        } else if (status == OP_TOO_MANY_ATTEMPTS) {
+            lockedOut = true;
+            cout << "Wrong password! Remaining attempts: 0" << endl;
+        }
+        if (status != OP_WRONG_PASSWORD) {
+            cout << opStatusMessage(status) << endl;
+        }
+        return false;
+    }
+    
+    void showMainMenu() {
+        cout << "\nMain Menu" << endl;
+        cout << "1. Check Balance" << endl;
+        cout << "2. Withdraw" << endl;
+        cout << "3. Deposit" << endl;
+        cout << "4. Transfer" << endl;
+        cout << "5. Change Password" << endl;
+        cout << "6. Display Account Information" << endl;
+        cout << "7. Transaction History" << endl;
+        cout << "8. Exit/Logout" << endl;
+        cout << "Please choose operation (1-8): ";
+    }
+    
+    // 查询余额
+    void checkBalance() {
+        Money balance;
+        OpStatus status = bank.checkBalance(session, balance);
+        if (status != OP_OK) {
+            cout << opStatusMessage(status) << endl;
+            return;
+        }
+        
+        cout << "\nBalance Inquiry" << endl;
+        cout << "Current balance: ¥" << balance << endl;
+    }
+    
+    // 取款
+    void withdraw() {
+        if (!session.isLoggedIn) {
+            cout << opStatusMessage(OP_NOT_LOGGED_IN) << endl;
+            return;
+        }
+        
+        Money amount;
+        cout << "\nWithdrawal" << endl;
+        cout << "Single withdrawal limit: ¥" << SINGLE_WITHDRAWAL_LIMIT << endl;
+        cout << "Daily withdrawal limit: ¥" << DAILY_WITHDRAWAL_LIMIT << endl;
+        cout << "Withdrawal amount must be multiple of " << WITHDRAWAL_MULTIPLE << endl;
+        cout << "Today's withdrawals: ¥" << bank.todayWithdrawalTotal(session) << endl;
+        
+        cout << "Please enter withdrawal amount: ";
+        if (!readAmount(amount)) {
+            return;
+        }
+        
+        // 先确认钞箱能出这笔钱再记账，记账成功后才扣减库存
+        CashDispenser::Notes notes;
+        OpStatus status = dispenser.plan(amount, notes);
+        if (status == OP_OK) {
+            status = bank.withdraw(session, amount);
+        }
+        if (status == OP_OK) {
+            dispenser.dispense(notes);
+            cout << "Withdrawal successful! Withdrawn amount: ¥" << amount << endl;
+            cout << "Notes: " << CashDispenser::describe(notes) << endl;
+            cout << "Remaining balance: ¥" << bank.snapshot(session).getBalance() << endl;
+        } else {
+            cout << opStatusMessage(status) << endl;
+        }
+    }
+    
+    // 存款
+    void deposit() {
+        if (!session.isLoggedIn) {
+            cout << opStatusMessage(OP_NOT_LOGGED_IN) << endl;
+            return;
+        }
+        
+        Money amount;
+        cout << "\nDeposit" << endl;
+        cout << "Please enter deposit amount: ";
+        if (!readAmount(amount)) {
+            return;
+        }
+        
+        OpStatus status = bank.deposit(session, amount);
+        if (status == OP_OK) {
+            cout << "Deposit successful! Deposit amount: ¥" << amount << endl;
+            cout << "Current balance: ¥" << bank.snapshot(session).getBalance() << endl;
+        } else {
+            cout << opStatusMessage(status) << endl;
+        }
+    }
+    
+    // 转账
+    void transfer() {
+        if (!session.isLoggedIn) {
+            cout << opStatusMessage(OP_NOT_LOGGED_IN) << endl;
+            return;
+        }
+        
+        string targetAccountNumber, recipientName;
+        Money amount;
+        
+        cout << "\nTransfer" << endl;
+        cout << "Please enter target account number: ";
+        cin >> targetAccountNumber;
+        
+        OpStatus status = bank.checkTransferTarget(session, targetAccountNumber, &recipientName);
+        if (status != OP_OK) {
+            cout << opStatusMessage(status) << endl;
+            return;
+        }
+        
+        string confirmAccount;
+        cout << "Please re-enter target account number to confirm: ";
+        cin >> confirmAccount;
+        
+        if (targetAccountNumber != confirmAccount) {
+            cout << "Two account numbers do not match!" << endl;
+            return;
+        }
+        
+        cout << "Please enter transfer amount: ";
+        if (!readAmount(amount)) {
+            return;
+        }
+        
+        status = bank.transfer(session, targetAccountNumber, amount);
+        if (status == OP_OK) {
+            cout << "Transfer successful! Transfer amount: ¥" << amount << endl;
+            cout << "Remaining balance: ¥" << bank.snapshot(session).getBalance() << endl;
+            cout << "Recipient: " << recipientName << endl;
+        } else {
+            cout << opStatusMessage(status) << endl;
+        }
+    }
+    
+    // 修改密码
+    void changePassword() {
+        if (!session.isLoggedIn) {
+            cout << opStatusMessage(OP_NOT_LOGGED_IN) << endl;
+            return;
+        }
+        
+        string oldPassword, newPassword, confirmPassword;
+        
+        cout << "\nChange Password" << endl;
+        cout << "Please enter current password: ";
+        cin >> oldPassword;
+        
+        if (!bank.snapshot(session).verifyPassword(oldPassword)) {
+            cout << "Current password is incorrect!" << endl;
+            return;
+        }
+        
+        cout << "Please enter new password (6 digits): ";
+        cin >> newPassword;
+        
+        if (newPassword.length() != PASSWORD_LENGTH) {
+            cout << opStatusMessage(OP_INVALID_PASSWORD_LENGTH) << endl;
+            return;
+        }
+        
+        if (!all_of(newPassword.begin(), newPassword.end(), ::isdigit)) {
+            cout << opStatusMessage(OP_INVALID_PASSWORD_DIGITS) << endl;
+            return;
+        }
+        
+        cout << "Please re-enter new password to confirm: ";
+        cin >> confirmPassword;
+        
+        if (newPassword != confirmPassword) {
+            cout << "Two passwords do not match!" << endl;
+            return;
+        }
+        
+        OpStatus status = bank.changePassword(session, oldPassword, newPassword);
+        if (status == OP_OK) {
+            cout << "Password changed successfully!" << endl;
+        } else {
+            cout << opStatusMessage(status) << endl;
+        }
+    }
+    
+    // 显示账户信息
+    void displayAccountInfo() {
+        if (!session.isLoggedIn) {
+            cout << opStatusMessage(OP_NOT_LOGGED_IN) << endl;
+            return;
+        }
+        
+        bank.snapshot(session).display();
+    }
+    
+    // 交易历史：最近若干笔或按日期区间查询
+    void showHistory() {
+        cout << "\nTransaction History" << endl;
+        cout << "1. Recent " << HISTORY_RECENT_COUNT << " transactions" << endl;
+        cout << "2. By date range" << endl;
+        cout << "Please choose (1-2): ";
+        
+        int mode;
+        if (!(cin >> mode)) {
+            cin.clear();
+            cin.ignore(numeric_limits<streamsize>::max(), '\n');
+            mode = 0;
+        }
+        
+        vector<Transaction> records;
+        OpStatus status;
+        if (mode == 1) {
+            status = bank.recentTransactions(session, HISTORY_RECENT_COUNT, records);
+        } else if (mode == 2) {
+            string from, to;
+            cout << "Start date (YYYY-MM-DD): ";
+            cin >> from;
+            cout << "End date (YYYY-MM-DD): ";
+            cin >> to;
+            int fromKey = dateKey(from), toKey = dateKey(to);
+            if (fromKey < 0 || toKey < 0) {
+                cout << "Invalid date format!" << endl;
+                return;
+            }
+            status = bank.transactionsBetween(session, fromKey, toKey, records);
+        } else {
+            cout << "Invalid choice!" << endl;
+            return;
+        }
+        if (status != OP_OK) {
+            cout << opStatusMessage(status) << endl;
+            return;
+        }
+        
+        if (records.empty()) {
+            cout << "No transactions found." << endl;
+            return;
+        }
+        const string& self = session.currentAccount->getAccountNumber();
+        cout << left << setw(12) << "Date" << setw(10) << "Time" << setw(14) << "Type"
+             << right << setw(14) << "Amount" << "  Counterparty" << endl;
+        for (const auto& trans : records) {
+            bool incoming = trans.type == "TRANSFER" && trans.accountNumber != self;
+            string type = trans.type == "TRANSFER" ? (incoming ? "TRANSFER_IN" : "TRANSFER_OUT") : trans.type;
+            cout << left << setw(12) << trans.date << setw(10) << trans.time << setw(14) << type
+                 << right << setw(14) << trans.amount.toString() << "  "
+                 << (incoming ? trans.accountNumber : trans.targetAccount) << endl;
+        }
+        cout << left;
+    }
+    
+    void logout() {
+        if (session.isLoggedIn) {
+            cout << "\nThank you for using, welcome next time!" << endl;
+            bank.logout(session);
+        }
+    }
+    
+    void run() {
+        showWelcome();
+        
+        while (!session.isLoggedIn) {
+            if (!login()) {
+                if (lockedOut) {
+                    cout << "Too many login failures, program exits." << endl;
+                    return;
+                }
+                
+                char choice;
+                cout << "\nContinue to try login? (y/n): ";
+                
+                if (!(cin >> choice) || (choice != 'y' && choice != 'Y')) {
+                    return;
+                }
+            }
+        }
+        
+        int choice;
+        while (session.isLoggedIn) {
+            showMainMenu();
+            if (!(cin >> choice)) {
+                // 输入结束时退出，非法输入时清理后重新选择
+                if (cin.eof()) {
+                    logout();
+                    break;
+                }
+                cin.clear();
+                cin.ignore(numeric_limits<streamsize>::max(), '\n');
+                choice = 0;
+            }
+            
+            switch (choice) {
+                case 1: checkBalance(); break;
+                case 2: withdraw(); break;
+                case 3: deposit(); break;
+                case 4: transfer(); break;
+                case 5: changePassword(); break;
+                case 6: displayAccountInfo(); break;
+                case 7: showHistory(); break;
+                case 8: logout(); break;
+                default:
+                    cout << "Invalid choice, please re-enter!" << endl;
+                    break;
+            }
+            
+            if (choice != 8) {
+                cout << "\nPress any key to continue...";
+                cin.ignore();
+                cin.get();
+            }
+        }
+    }
+};
+
+// 执行一条行协议命令，返回响应行（不含换行）；closeSession 表示会话应结束
+// 服务器和压测回放共用
+string executeCommand(Bank& bank, Session& session, const string& line, bool& closeSession) {
+    stringstream ss(line);
+    string command, arg1, arg2;
+    ss >> command >> arg1 >> arg2;
+    transform(command.begin(), command.end(), command.begin(), ::toupper);
+    
+    OpStatus status = OP_FAILED;
+    Money amount;
+    
+    if (command == "LOGIN") {
+        status = bank.login(session, arg1, arg2);
+        if (status == OP_OK) {
+            return "OK " + session.currentAccount->getName();
+        }
+    } else if (command == "BALANCE") {
+        status = bank.checkBalance(session, amount);
+        if (status == OP_OK) {
+            return "OK " + amount.toString();
+        }
+    } else if (command == "WITHDRAW" || command == "DEPOSIT") {
+        if (!Money::parse(arg1, amount)) {
+            status = OP_INVALID_AMOUNT;
+        } else {
+            status = command == "WITHDRAW" ? bank.withdraw(session, amount) : bank.deposit(session, amount);
+        }
+        if (status == OP_OK) {
+            return "OK " + bank.snapshot(session).getBalance().toString();
+        }
+    } else if (command == "TRANSFER") {
+        if (!Money::parse(arg2, amount)) {
+            status = OP_INVALID_AMOUNT;
+        } else {
+            status = bank.transfer(session, arg1, amount);
+        }
+        if (status == OP_OK) {
+            return "OK " + bank.snapshot(session).getBalance().toString();
+        }
+    } else if (command == "PASSWORD") {
+        status = bank.changePassword(session, arg1, arg2);
+        if (status == OP_OK) {
+            return "OK";
+        }
+    } else if (command == "HISTORY") {
+        // HISTORY [n] 最近 n 笔；HISTORY <起始日期> <结束日期> 按区间；记录间以 ';' 分隔
+        vector<Transaction> records;
+        if (arg1.find('-') != string::npos) {
+            int fromKey = dateKey(arg1), toKey = dateKey(arg2.empty() ? arg1 : arg2);
+            status = fromKey < 0 || toKey < 0 ? OP_FAILED
+                                              : bank.transactionsBetween(session, fromKey, toKey, records);
+        } else {
+            size_t n = HISTORY_RECENT_COUNT;
+            if (!arg1.empty()) {
+                n = strtoul(arg1.c_str(), nullptr, 10);
+            }
+            status = bank.recentTransactions(session, min(n, HISTORY_MAX_RECORDS), records);
+        }
+        if (status == OP_OK) {
+            string response = "OK " + to_string(records.size());
+            for (size_t i = 0; i < records.size(); i++) {
+                const Transaction& trans = records[i];
+                response += i == 0 ? ' ' : ';';
+                response += trans.accountNumber + "," + trans.type + "," + trans.amount.toString() + "," +
+                            trans.date + "," + trans.time + "," + trans.targetAccount;
+            }
+            return response;
+        }
+    } else if (command == "LOGOUT") {
+        bank.logout(session);
+        return "OK";
+    } else if (command == "QUIT") {
+        bank.logout(session);
+        closeSession = true;
+        return "OK";
+    } else {
+        return "ERR Unknown command";
+    }
+    
+    // 密码连续错误后断开连接，与控制台行为一致
+    if (status == OP_TOO_MANY_ATTEMPTS) {
+        closeSession = true;
+    }
+    return string("ERR ") + opStatusMessage(status);
+}
+
+// 批量入账：逐行执行操作文件，校验规则与柜面操作相同，整批只持久化一次
+// 操作文件每行一条: DEPOSIT,<账号>,<金额> / WITHDRAW,<账号>,<金额> / TRANSFER,<转出账号>,<转入账号>,<金额>
+// 报告文件每行对应一条操作: <行号>,OK 或 <行号>,REJECTED,<原因>；整批确认后才写出，
+// 交易日志未能落盘时整批已被撤销，原本通过的行也报告为拒绝
+bool runBatch(Bank& bank, const string& opsFile, const string& reportFile, size_t& applied, size_t& rejected) {
+    ifstream in(opsFile);
+    ofstream report(reportFile);
+    if (!in.is_open() || !report.is_open()) {
+        return false;
+    }
+    
+    applied = rejected = 0;
+    Session session;
+    bank.beginBatch(session);
+    vector<pair<size_t, const char*>> results;  // 行号，拒绝原因（通过的行为 nullptr）
+    
+    string line;
+    size_t lineNo = 0;
+    while (getline(in, line)) {
+        lineNo++;
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        if (line.empty()) {
+            continue;
+        }
+        
+        string_view fields[4];
+        size_t count = 0;
+        string_view rest(line);
+        while (count < 4) {
+            size_t comma = rest.find(',');
+            fields[count++] = rest.substr(0, comma);
+            if (comma == string_view::npos) break;
+            rest.remove_prefix(comma + 1);
+        }
+        
+        string_view type = fields[0];
+        OpStatus status = OP_FAILED;
+        const char* error = nullptr;
+        Money amount;
+        
+        if ((type == "DEPOSIT" || type == "WITHDRAW") && count == 3) {
+            if (!Money::parse(fields[2], amount)) {
+                status = OP_INVALID_AMOUNT;
+            } else if ((status = bank.attachAccount(session, string(fields[1]))) == OP_OK) {
+                status = type == "DEPOSIT" ? bank.deposit(session, amount) : bank.withdraw(session, amount);
+            }
+        } else if (type == "TRANSFER" && count == 4) {
+            if (!Money::parse(fields[3], amount)) {
+                status = OP_INVALID_AMOUNT;
+            } else if ((status = bank.attachAccount(session, string(fields[1]))) == OP_OK) {
+                status = bank.transfer(session, string(fields[2]), amount);
+            }
+        } else {
+            error = "Malformed line";
+        }
+        
+        results.emplace_back(lineNo, error ? error : status == OP_OK ? nullptr : opStatusMessage(status));
+    }
+    
+    bool committed = bank.commitBatch(session) == OP_OK;
+    for (const auto& result : results) {
+        report << result.first;
+        if (!result.second && committed) {
+            report << ",OK\n";
+            applied++;
+        } else {
+            report << ",REJECTED," << (result.second ? result.second : opStatusMessage(OP_FAILED)) << '\n';
+            rejected++;
+        }
+    }
+    if (!committed) {
+        cerr << "交易日志无法落盘，批处理已撤销" << endl;
+        return false;
+    }
+    return true;
+}
+
+#ifndef _WIN32
+// 多终端会话服务器：固定数量的工作线程，每个线程一个 epoll 实例
+// 监听套接字以 EPOLLEXCLUSIVE 加入所有工作线程，连接由接受它的线程独占处理
+//
+// 行协议（每行一条命令，每条命令返回一行 OK/ERR 响应）:
+//   LOGIN <account> <password>    TRANSFER <target> <amount>
+//   BALANCE                        PASSWORD <old> <new>
+//   WITHDRAW <amount>              LOGOUT
+//   DEPOSIT <amount>               QUIT
+class ATMServer {
+private:
+    struct Connection {
+        Session session;
+        string input;
+        string output;
+        bool closing;
+        
+        Connection() : closing(false) {}
+    };
+    
+    Bank& bank;
+    int port;
+    int workerCount;
+    int listenFd;
+    
+    static atomic<bool>& stopFlag() {
+        static atomic<bool> flag(false);
+        return flag;
+    }
+    
+    static void handleSignal(int) {
+        stopFlag() = true;
+    }
+    
+    static bool setNonBlocking(int fd) {
+        int flags = fcntl(fd, F_GETFL, 0);
+        return flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+    }
+    
+    string execute(Connection& conn, const string& line) {
+        return executeCommand(bank, conn.session, line, conn.closing);
+    }
+    
+    // 尽量写出缓冲区，返回 false 表示连接已失效
+    static bool flushOutput(int fd, Connection& conn) {
+        while (!conn.output.empty()) {
+            ssize_t n = send(fd, conn.output.data(), conn.output.size(), MSG_NOSIGNAL);
+            if (n > 0) {
+                conn.output.erase(0, n);
+            } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                return true;
+            } else if (n < 0 && errno == EINTR) {
+                continue;
+            } else {
+                return false;
+            }
+        }
+        return true;
+    }
+    
+    // 读入数据并处理其中的完整命令行，返回 false 表示应关闭连接
+    bool handleInput(int fd, Connection& conn) {
+        char buffer[4096];
+        while (true) {
+            ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+            if (n > 0) {
+                conn.input.append(buffer, n);
+            } else if (n == 0) {
+                return false;
+            } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                break;
+            } else if (errno != EINTR) {
+                return false;
+            }
+        }
+        
+        size_t start = 0, newline;
+        while (!conn.closing && (newline = conn.input.find('\n', start)) != string::npos) {
+            string line = conn.input.substr(start, newline - start);
+            if (!line.empty() && line.back() == '\r') {
+                line.pop_back();
+            }
+            start = newline + 1;
+            if (!line.empty()) {
+                conn.output += execute(conn, line);
+                conn.output += '\n';
+            }
+        }
+        conn.input.erase(0, start);
+        return true;
+    }
+    
+    void workerLoop() {
+        int epollFd = epoll_create1(0);
+        epoll_event listenEvent = {};
+        listenEvent.events = EPOLLIN | EPOLLEXCLUSIVE;
+        listenEvent.data.fd = listenFd;
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, listenFd, &listenEvent);
+        
+        unordered_map<int, Connection> connections;
+        epoll_event events[64];
+        
+        while (!stopFlag()) {
+            int ready = epoll_wait(epollFd, events, 64, 200);
+            for (int i = 0; i < ready; i++) {
+                int fd = events[i].data.fd;
+                
+                if (fd == listenFd) {
+                    int clientFd;
+                    while ((clientFd = accept(listenFd, nullptr, nullptr)) >= 0) {
+                        setNonBlocking(clientFd);
+                        int one = 1;
+                        setsockopt(clientFd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+                        epoll_event ev = {};
+                        ev.events = EPOLLIN | EPOLLRDHUP;
+                        ev.data.fd = clientFd;
+                        epoll_ctl(epollFd, EPOLL_CTL_ADD, clientFd, &ev);
+                        connections[clientFd];
+                    }
+                    continue;
+                }
+                
+                auto it = connections.find(fd);
+                if (it == connections.end()) {
+                    continue;
+                }
+                Connection& conn = it->second;
+                
+                bool alive = true;
+                if (events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+                    alive = handleInput(fd, conn);
+                }
+                alive = flushOutput(fd, conn) && alive;
+                
+                if (!alive || (conn.closing && conn.output.empty())) {
+                    epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr);
+                    close(fd);
+                    connections.erase(it);
+                    continue;
+                }
+                
+                // 有未写完的响应时才关注可写事件
+                epoll_event ev = {};
+                ev.events = EPOLLIN | EPOLLRDHUP | (conn.output.empty() ? 0u : (uint32_t)EPOLLOUT);
+                ev.data.fd = fd;
+                epoll_ctl(epollFd, EPOLL_CTL_MOD, fd, &ev);
+            }
+        }
+        
+        for (auto& pair : connections) {
+            close(pair.first);
+        }
+        close(epollFd);
+    }
+    
+public:
+    ATMServer(Bank& b, int p = DEFAULT_SERVER_PORT, int workers = DEFAULT_SERVER_WORKERS)
+        : bank(b), port(p), workerCount(max(1, workers)), listenFd(-1) {}
+    
+    // 运行直到收到 SIGINT/SIGTERM
+    bool run() {
+        listenFd = socket(AF_INET, SOCK_STREAM, 0);
+        if (listenFd < 0) {
+            return false;
+        }
+        
+        int one = 1;
+        setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        
+        if (bind(listenFd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 ||
+            listen(listenFd, SOMAXCONN) != 0 || !setNonBlocking(listenFd)) {
+            close(listenFd);
+            return false;
+        }
+        
+        stopFlag() = false;
+        signal(SIGINT, handleSignal);
+        signal(SIGTERM, handleSignal);
+        
+        cout << "ATM server listening on 127.0.0.1:" << port << " with " << workerCount << " workers" << endl;
+        
+        vector<thread> workers;
+        for (int i = 0; i < workerCount; i++) {
+            workers.emplace_back(&ATMServer::workerLoop, this);
+        }
+        for (auto& worker : workers) {
+            worker.join();
+        }
+        
+        close(listenFd);
+        return true;
+    }
+};
+
+// 本地测试客户端：把标准输入的每一行发给服务器，并打印对应的响应行
+int runClient(int port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    
+    if (fd < 0 || connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+        cerr << "Cannot connect to 127.0.0.1:" << port << endl;
+        return 1;
+    }
+    
+    string line, pending;
+    char buffer[4096];
+    while (getline(cin, line)) {
+        line += '\n';
+        if (send(fd, line.data(), line.size(), MSG_NOSIGNAL) < 0) {
+            break;
+        }
+        
+        size_t newline;
+        while ((newline = pending.find('\n')) == string::npos) {
+            ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+            if (n <= 0) {
+                close(fd);
+                return 0;
+            }
+            pending.append(buffer, n);
+        }
+        cout << pending.substr(0, newline) << endl;
+        pending.erase(0, newline + 1);
+    }
+    
+    close(fd);
+    return 0;
+}
+
+// 复制服务器（主库）：每个备库一个线程，先发送账户快照，之后按序转发复制流中的消息
+// 没有新消息时每 REPLICATION_HEARTBEAT_MS 毫秒发一条心跳 "H <最新序号> <时刻>"，备库据此计算落后量
+class ReplicationServer {
+private:
+    Bank& bank;
+    ReplicationStream& stream;
+    int port;
+    int listenFd;
+    atomic<bool> stopping;
+    thread acceptThread;
+    mutex followersMutex;
+    vector<thread> followerThreads;
+    
+    static bool sendAll(int fd, const string& data) {
+        size_t sent = 0;
+        while (sent < data.size()) {
+            ssize_t n = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+            if (n > 0) {
+                sent += n;
+            } else if (n < 0 && errno == EINTR) {
+                continue;
+            } else {
+                return false;
+            }
+        }
+        return true;
+    }
+    
+    void updateGauges() {
+        Metrics::setGauge("replication_followers", (double)stream.followerCount());
+        Metrics::setGauge("replication_backlog", (double)stream.backlogSize());
+        Metrics::setGauge("replication_seq", (double)stream.sequence());
+    }
+    
+    void serveFollower(int fd) {
+        int followerId;
+        bool alive = sendAll(fd, bank.replicationSnapshot(stream, followerId));
+        updateGauges();
+        while (alive && !stopping) {
+            string batch;
+            uint64_t latest = 0;
+            if (!stream.waitBatch(followerId, batch, latest, REPLICATION_HEARTBEAT_MS)) {
+                break;
+            }
+            if (batch.empty()) {
+                batch = "H " + to_string(latest) + ' ' + to_string(ReplicationStream::currentMicros()) + '\n';
+            }
+            alive = sendAll(fd, batch);
+            updateGauges();
+        }
+        stream.detach(followerId);
+        close(fd);
+        updateGauges();
+    }
+    
+    void acceptLoop() {
+        while (!stopping) {
+            pollfd pfd = {listenFd, POLLIN, 0};
+            if (poll(&pfd, 1, 200) <= 0) {
+                continue;
+            }
+            int fd = accept(listenFd, nullptr, nullptr);
+            if (fd < 0) {
+                continue;
+            }
+            int one = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+            // 备库停止读取时发送最多阻塞 1 秒，之后断开，避免拖住停止流程
+            timeval timeout = {1, 0};
+            setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+            lock_guard<mutex> lock(followersMutex);
+            followerThreads.emplace_back(&ReplicationServer::serveFollower, this, fd);
+        }
+    }
+    
+public:
+    ReplicationServer(Bank& b, ReplicationStream& s, int p = DEFAULT_REPLICATION_PORT)
+        : bank(b), stream(s), port(p), listenFd(-1), stopping(false) {}
+    
+    ~ReplicationServer() {
+        stop();
+    }
+    
+    ReplicationServer(const ReplicationServer&) = delete;
+    ReplicationServer& operator=(const ReplicationServer&) = delete;
+    
+    bool start() {
+        listenFd = socket(AF_INET, SOCK_STREAM, 0);
+        if (listenFd < 0) {
+            return false;
+        }
+        
+        int one = 1;
+        setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        
+        if (bind(listenFd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 ||
+            listen(listenFd, SOMAXCONN) != 0) {
+            close(listenFd);
+            listenFd = -1;
+            return false;
+        }
+        
+        bank.setReplication(&stream);
+        acceptThread = thread(&ReplicationServer::acceptLoop, this);
+        cout << "Replication listening on 127.0.0.1:" << port << endl;
+        return true;
+    }
+    
+    void stop() {
+        if (!acceptThread.joinable()) {
+            return;
+        }
+        stopping = true;
+        acceptThread.join();
+        for (auto& follower : followerThreads) {
+            follower.join();
+        }
+        followerThreads.clear();
+        close(listenFd);
+        listenFd = -1;
+        bank.setReplication(nullptr);
+    }
+};
+
+// 复制客户端（备库）：连接主库的复制端口，按序应用快照、账户记录和交易记录
+// 断线后每 REPLICATION_RETRY_MS 毫秒重连一次，重连时重新取快照
+class ReplicationFollower {
+public:
+    struct Status {
+        bool connected;
+        uint64_t appliedSeq;   // 已应用的最后序号
+        uint64_t primarySeq;   // 主库已知的最新序号
+        uint64_t applied;      // 已应用的消息数
+        uint64_t snapshots;    // 已应用的快照数
+        double lagSeconds;     // 最近一条消息从主库提交到本地应用的耗时，已追平时为 0
+        double maxLagSeconds;
+        
+        Status() : connected(false), appliedSeq(0), primarySeq(0), applied(0), snapshots(0),
+                   lagSeconds(0), maxLagSeconds(0) {}
+    };
+    
+private:
+    Bank& bank;
+    int port;
+    atomic<bool> stopping;
+    thread worker;
+    mutex statusMutex;
+    Status status;
+    
+    // 快照接收中：剩余的账户行数及已收到的账户
+    size_t snapshotRemaining;
+    vector<Account> snapshot;
+    
+    void updateGauges(const Status& current) {
+        Metrics::setGauge("replication_connected", current.connected ? 1 : 0);
+        Metrics::setGauge("replication_applied_seq", (double)current.appliedSeq);
+        Metrics::setGauge("replication_primary_seq", (double)current.primarySeq);
+        Metrics::setGauge("replication_lag_seconds", current.lagSeconds);
+    }
+    
+    void setConnected(bool connected) {
+        lock_guard<mutex> lock(statusMutex);
+        status.connected = connected;
+        updateGauges(status);
+    }
+    
+    // 处理一行消息，格式错误返回 false（断开重连）
+    bool handleLine(string_view line) {
+        if (snapshotRemaining > 0) {
+            snapshot.push_back(Account::fromFileString(line));
+            if (--snapshotRemaining == 0) {
+                bank.applyReplicaSnapshot(snapshot);
+                vector<Account>().swap(snapshot);
+                lock_guard<mutex> lock(statusMutex);
+                status.snapshots++;
+            }
+            return true;
+        }
         
-        if (FileManager::isAccountLocked(accountNumber)) {
-            cout << "Account is locked, please contact bank customer service!" << endl;
+        // 前三个字段为类型、序号、提交时刻，其余为内容
+        string_view fields[3];
+        for (int i = 0; i < 3; i++) {
+            size_t space = line.find(' ');
+            fields[i] = line.substr(0, space);
+            line.remove_prefix(space == string_view::npos ? line.size() : space + 1);
+        }
+        if (fields[0].size() != 1 || fields[1].empty() || fields[2].empty()) {
             return false;
         }
+        uint64_t seq = strtoull(string(fields[1]).c_str(), nullptr, 10);
+        int64_t committedMicros = strtoll(string(fields[2]).c_str(), nullptr, 10);
         
-        cout << "Please enter 6-digit password: ";
-        cin >> password;
-        
-        Account& account = accounts[accountNumber];
+        switch (fields[0][0]) {
+            case 'S':
+                snapshotRemaining = strtoull(string(line).c_str(), nullptr, 10);
+                if (snapshotRemaining == 0) {
+                    lock_guard<mutex> lock(statusMutex);
+                    status.snapshots++;
+                }
+                break;
+            case 'A':
+                bank.applyReplicaAccount(Account::fromFileString(line));
+                break;
+            case 'T': {
+                Transaction trans;
+                if (!Transaction::fromLogLine(line, trans)) {
+                    return false;
+                }
+                FileManager::logTransaction(trans);
+                break;
+            }
+            case 'H':
+                break;
+            default:
+                return false;
+        }
         
-        if (account.verifyPassword(password)) {
-            currentAccount = &account;
-            loginAttempts = 0;
-            isLoggedIn = true;
-            cout << "\nLogin successful! Welcome " << account.getName() << " !" << endl;
-            return true;
+        lock_guard<mutex> lock(statusMutex);
+        status.primarySeq = max(status.primarySeq, seq);
+        if (fields[0][0] == 'A' || fields[0][0] == 'T') {
+            int64_t lagMicros = max<int64_t>(0, ReplicationStream::currentMicros() - committedMicros);
+            Metrics::record(METRIC_REPLICATION_LAG, OP_OK, (uint64_t)lagMicros * 1000);
+            status.appliedSeq = seq;
+            status.applied++;
+            status.lagSeconds = lagMicros / 1e6;
+            status.maxLagSeconds = max(status.maxLagSeconds, status.lagSeconds);
         } else {
-            loginAttempts++;
-            cout << "Wrong password! Remaining attempts: " << MAX_LOGIN_ATTEMPTS - loginAttempts << endl;
+            // 快照和心跳携带的是主库当前的序号，本地已应用到该序号
+            status.appliedSeq = seq;
+            status.lagSeconds = 0;
+        }
+        updateGauges(status);
+        return true;
+    }
+    
+    // 接收并应用直到连接断开或停止
+    void receive(int fd) {
+        string pending;
+        char buffer[65536];
+        while (!stopping) {
+            pollfd pfd = {fd, POLLIN, 0};
+            if (poll(&pfd, 1, 200) <= 0) {
+                continue;
+            }
+            ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                return;
+            }
+            pending.append(buffer, n);
+            
+            size_t start = 0, newline;
+            while ((newline = pending.find('\n', start)) != string::npos) {
+                if (!handleLine(string_view(pending).substr(start, newline - start))) {
+                    return;
+                }
+                start = newline + 1;
+            }
+            pending.erase(0, start);
+        }
+    }
+    
+    void loop() {
+        while (!stopping) {
+            int fd = socket(AF_INET, SOCK_STREAM, 0);
+            sockaddr_in addr = {};
+            addr.sin_family = AF_INET;
+            addr.sin_port = htons(port);
+            addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
             
-            if (loginAttempts >= MAX_LOGIN_ATTEMPTS) {
-                cout << "Too many wrong password attempts, account has been locked!" << endl;
-                FileManager::lockAccount(accountNumber);
+            if (fd >= 0 && connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0) {
+                snapshotRemaining = 0;
+                snapshot.clear();
+                setConnected(true);
+                receive(fd);
+                setConnected(false);
+            }
+            if (fd >= 0) {
+                close(fd);
             }
             
-            return false;
+            for (int waited = 0; waited < REPLICATION_RETRY_MS && !stopping; waited += 100) {
+                this_thread::sleep_for(chrono::milliseconds(100));
+            }
         }
     }
     
-    void showMainMenu() {
-        cout << "\nMain Menu" << endl;
-        cout << "1. Check Balance" << endl;
-        cout << "2. Withdraw" << endl;
-        cout << "3. Deposit" << endl;
-        cout << "4. Transfer" << endl;
-        cout << "5. Change Password" << endl;
-        cout << "6. Display Account Information" << endl;
-        cout << "7. Exit/Logout" << endl;
-        cout << "Please choose operation (1-7): ";
+public:
+    ReplicationFollower(Bank& b, int p = DEFAULT_REPLICATION_PORT)
+        : bank(b), port(p), stopping(false), snapshotRemaining(0) {}
+    
+    ~ReplicationFollower() {
+        stop();
     }
     
-    // 查询余额
-    void checkBalance() {
-        if (!isLoggedIn || !currentAccount) {
-            cout << "Please login first!" << endl;
+    ReplicationFollower(const ReplicationFollower&) = delete;
+    ReplicationFollower& operator=(const ReplicationFollower&) = delete;
+    
+    void start() {
+        stopping = false;
+        worker = thread(&ReplicationFollower::loop, this);
+    }
+    
+    // 停止复制，已收到的消息都已应用；提升为主库前调用
+    void stop() {
+        if (!worker.joinable()) {
             return;
         }
+        stopping = true;
+        worker.join();
+    }
+    
+    Status currentStatus() {
+        lock_guard<mutex> lock(statusMutex);
+        return status;
+    }
+    
+    void printStatus(ostream& out) {
+        Status current = currentStatus();
+        out << "connected=" << (current.connected ? "yes" : "no")
+            << " applied_seq=" << current.appliedSeq
+            << " primary_seq=" << current.primarySeq
+            << " behind=" << (current.primarySeq > current.appliedSeq ? current.primarySeq - current.appliedSeq : 0)
+            << " lag=" << fixed << setprecision(6) << current.lagSeconds << "s"
+            << " max_lag=" << current.maxLagSeconds << "s" << defaultfloat
+            << " applied=" << current.applied
+            << " snapshots=" << current.snapshots << endl;
+    }
+};
+
+// 备库收到的信号：SIGUSR2 请求提升，SIGINT/SIGTERM 请求退出
+atomic<int>& followerSignal() {
+    static atomic<int> received(0);
+    return received;
+}
+
+void handleFollowerSignal(int sig) {
+    followerSignal() = sig;
+}
+
+// 备库控制台：复制在后台进行，标准输入逐字节读取命令，不多读提升后 ATM 要用的输入
+// 返回 true 表示已提升为主库，调用方继续按命令行参数运行；false 表示退出
+bool runFollower(Bank& bank, int port) {
+    ReplicationFollower follower(bank, port);
+    followerSignal() = 0;
+    signal(SIGUSR2, handleFollowerSignal);
+    signal(SIGINT, handleFollowerSignal);
+    signal(SIGTERM, handleFollowerSignal);
+    follower.start();
+    cout << "Following primary at 127.0.0.1:" << port << " (commands: status, promote, quit)" << endl;
+    
+    bool inputOpen = true;
+    bool interrupted = false;
+    string line;
+    while (followerSignal() != SIGUSR2) {
+        if (followerSignal() != 0) {
+            interrupted = true;
+            break;
+        }
+        if (!inputOpen) {
+            this_thread::sleep_for(chrono::milliseconds(200));
+            continue;
+        }
+        pollfd pfd = {STDIN_FILENO, POLLIN, 0};
+        if (poll(&pfd, 1, 200) <= 0) {
+            continue;
+        }
+        char c;
+        ssize_t n = read(STDIN_FILENO, &c, 1);
+        if (n <= 0) {
+            // 标准输入关闭后只能通过 SIGUSR2 提升
+            inputOpen = false;
+            continue;
+        }
+        if (c != '\n') {
+            line += c;
+            continue;
+        }
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        if (line == "status") {
+            follower.printStatus(cout);
+        } else if (line == "promote") {
+            break;
+        } else if (line == "quit") {
+            interrupted = true;
+            break;
+        } else if (!line.empty()) {
+            cout << "Unknown command: " << line << endl;
+        }
+        line.clear();
+    }
+    
+    follower.stop();
+    signal(SIGINT, SIG_DFL);
+    signal(SIGTERM, SIG_DFL);
+    follower.printStatus(cout);
+    if (interrupted) {
+        return false;
+    }
+    cout << "Promoted to primary" << endl;
+    return true;
+}
+#endif
+
+// ====================== 性能测试 ======================
+// 第 i 个测试账号：10^18 + i * 质数 (mod 9 * 10^18)，保证互不相同且都是 19 位
+string benchmarkAccountNumber(uint64_t i) {
+    const uint64_t base = 1000000000000000000ULL;
+    const uint64_t range = 9000000000000000000ULL;
+    unsigned __int128 offset = (unsigned __int128)i * 1000000007ULL % range;
+    return to_string(base + (uint64_t)offset);
+}
+
+double elapsedMs(chrono::steady_clock::time_point start) {
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+// 账户表与 std::map 的建表和随机查找耗时对比
+void runTableBenchmark(const vector<size_t>& sizes) {
+    const size_t LOOKUPS = 1000000;
+    
+    cout << "accounts    container      build(ms)   lookup(ns/op)" << endl;
+    for (size_t n : sizes) {
+        mt19937_64 rng(n);
+        vector<string> probes;
+        probes.reserve(LOOKUPS);
+        for (size_t i = 0; i < LOOKUPS; i++) {
+            probes.push_back(benchmarkAccountNumber(rng() % n));
+        }
         
-        cout << "\nBalance Inquiry" << endl;
-        cout << "Current balance: ¥" << fixed << setprecision(2) << currentAccount->getBalance() << endl;
+        size_t found = 0;
+        {
+            map<string, Account> accounts;
+            auto start = chrono::steady_clock::now();
+            for (size_t i = 0; i < n; i++) {
+                string number = benchmarkAccountNumber(i);
+                accounts[number] = Account(number, "", "", "", INITIAL_BALANCE);
+            }
+            double buildMs = elapsedMs(start);
+            
+            start = chrono::steady_clock::now();
+            for (const string& probe : probes) {
+                found += accounts.find(probe) != accounts.end();
+            }
+            double lookupNs = elapsedMs(start) * 1e6 / LOOKUPS;
+            printf("%-11zu %-14s %9.0f %15.1f\n", n, "std::map", buildMs, lookupNs);
+        }
+        {
+            AccountTable accounts;
+            auto start = chrono::steady_clock::now();
+            for (size_t i = 0; i < n; i++) {
+                accounts.upsert(Account(benchmarkAccountNumber(i), "", "", "", INITIAL_BALANCE));
+            }
+            double buildMs = elapsedMs(start);
+            
+            start = chrono::steady_clock::now();
+            for (const string& probe : probes) {
+                found += accounts.find(probe) != nullptr;
+            }
+            double lookupNs = elapsedMs(start) * 1e6 / LOOKUPS;
+            printf("%-11zu %-14s %9.0f %15.1f\n", n, "AccountTable", buildMs, lookupNs);
+        }
+        
+        if (found != 2 * LOOKUPS) {
+            cerr << "benchmark lookup mismatch: " << found << endl;
+        }
+    }
+}
+
+// 压测用的姓名：姓加两个音节的名，约 3 万种，重名很多
+string benchmarkName(mt19937_64& rng) {
+    static const char* const surnames[] = {
+        "Zhang", "Wang", "Li", "Zhao", "Chen", "Liu", "Yang", "Huang", "Zhou", "Wu", "Xu", "Sun", "Hu", "Zhu", "Gao", "Lin",
+        "He", "Guo", "Ma", "Luo", "Liang", "Song", "Zheng", "Xie", "Han", "Tang", "Feng", "Yu", "Dong", "Xiao", "Cheng", "Cao"
+    };
+    static const char* const syllables[] = {
+        "an", "bo", "chen", "dong", "fang", "gang", "hua", "jie", "jun", "kai", "lei", "li", "ming", "na", "ning", "peng",
+        "qiang", "rui", "shan", "tao", "ting", "wei", "xia", "xin", "yan", "yang", "yi", "ying", "yu", "yun", "zhen", "zhi"
+    };
+    string name = surnames[rng() % 32];
+    name += ' ';
+    name += syllables[rng() % 32];
+    name += syllables[rng() % 32];
+    name[name.find(' ') + 1] -= 'a' - 'A';
+    return name;
+}
+
+// 压测用的身份证号：第 person 个人，17 位本体加按国标加权算出的校验位，平均每人两个账户
+string benchmarkIdCard(uint64_t person) {
+    static const int weights[17] = {7, 9, 10, 5, 8, 4, 2, 1, 6, 3, 7, 9, 10, 5, 8, 4, 2};
+    char digits[32];
+    snprintf(digits, sizeof(digits), "%017llu", (unsigned long long)(11010119000000000ULL + person));
+    int sum = 0;
+    for (int i = 0; i < 17; i++) {
+        sum += (digits[i] - '0') * weights[i];
+    }
+    string idCard(digits, 17);
+    idCard += "10X98765432"[sum % 11];
+    return idCard;
+}
+
+// 二级索引与逐个扫描账户表的查找耗时对比；扫描太慢，只做少量查询，并核对两者结果一致
+void runIndexBenchmark(const vector<size_t>& sizes) {
+    const size_t LOOKUPS = 1000000;
+    const size_t SCANS = 10;
+    
+    cout << "threads=" << max(1u, thread::hardware_concurrency()) << endl;
+    cout << "accounts    build(ms)  idcard-index(ns/op)  idcard-scan(ms/op)  name-index(ns/op)  name-scan(ms/op)" << endl;
+    for (size_t n : sizes) {
+        mt19937_64 rng(n);
+        AccountTable accounts;
+        accounts.reserve(n);
+        for (size_t i = 0; i < n; i++) {
+            accounts.upsert(Account(benchmarkAccountNumber(i), benchmarkName(rng), benchmarkIdCard(i / 2), "123456",
+                                    INITIAL_BALANCE));
+        }
+        
+        AccountIndex index;
+        auto start = chrono::steady_clock::now();
+        index.build(accounts);
+        double buildMs = elapsedMs(start);
+        
+        vector<string> idProbes, nameProbes;
+        for (size_t i = 0; i < LOOKUPS; i++) {
+            idProbes.push_back(benchmarkIdCard(rng() % (n / 2 + 1)));
+            // 前缀长度 3 到 12 个字节，加少量完整姓名
+            string name = benchmarkName(rng);
+            nameProbes.push_back(i % 8 == 0 ? name : name.substr(0, 3 + rng() % 10));
+        }
+        
+        size_t idFound = 0, nameFound = 0;
+        vector<Account*> result;
+        start = chrono::steady_clock::now();
+        for (const string& probe : idProbes) {
+            result.clear();
+            index.findByIdCard(probe, result);
+            idFound += result.size();
+        }
+        double idIndexNs = elapsedMs(start) * 1e6 / LOOKUPS;
+        
+        start = chrono::steady_clock::now();
+        for (const string& probe : nameProbes) {
+            result.clear();
+            index.findByNamePrefix(probe, DEFAULT_NAME_SEARCH_LIMIT, result);
+            nameFound += result.size();
+        }
+        double nameIndexNs = elapsedMs(start) * 1e6 / LOOKUPS;
+        
+        // 逐个扫描：身份证号精确匹配；姓名前缀匹配后排序取前 limit 个，与索引的结果逐项核对
+        size_t mismatches = 0;
+        start = chrono::steady_clock::now();
+        for (size_t i = 0; i < SCANS; i++) {
+            vector<Account*> scanned, indexed;
+            for (Account& account : accounts) {
+                if (account.getIdCard() == idProbes[i]) {
+                    scanned.push_back(&account);
+                }
+            }
+            index.findByIdCard(idProbes[i], indexed);
+            sort(scanned.begin(), scanned.end());
+            sort(indexed.begin(), indexed.end());
+            mismatches += scanned != indexed;
+        }
+        double idScanMs = elapsedMs(start) / SCANS;
+        
+        start = chrono::steady_clock::now();
+        for (size_t i = 0; i < SCANS; i++) {
+            const string& prefix = nameProbes[i];
+            vector<string> scanned, indexed;
+            for (Account& account : accounts) {
+                const string& name = account.getName();
+                if (name.size() >= prefix.size() && equal(prefix.begin(), prefix.end(), name.begin(),
+                        [](char a, char b) { return tolower((unsigned char)a) == tolower((unsigned char)b); })) {
+                    scanned.push_back(name);
+                }
+            }
+            sort(scanned.begin(), scanned.end());
+            if (scanned.size() > DEFAULT_NAME_SEARCH_LIMIT) {
+                scanned.resize(DEFAULT_NAME_SEARCH_LIMIT);
+            }
+            vector<Account*> found;
+            index.findByNamePrefix(prefix, DEFAULT_NAME_SEARCH_LIMIT, found);
+            for (Account* account : found) {
+                indexed.push_back(account->getName());
+            }
+            mismatches += scanned != indexed;
+        }
+        double nameScanMs = elapsedMs(start) / SCANS;
+        
+        printf("%-11zu %9.0f %20.1f %19.1f %18.1f %17.1f\n", n, buildMs, idIndexNs, idScanMs, nameIndexNs, nameScanMs);
+        if (mismatches > 0 || idFound < LOOKUPS || nameFound == 0) {
+            cerr << "index result mismatch: " << mismatches << " queries differ from scan" << endl;
+        }
+    }
+}
+
+// 账户文件和交易文件的串行加载与并行分段加载耗时对比，文件生成在 atm_bench/ 目录
+void runLoadBenchmark(const vector<size_t>& sizes, const string& directory) {
+    filesystem::create_directories(directory);
+    string accountsFile = (filesystem::path(directory) / ACCOUNTS_FILE).string();
+    string transactionsFile = (filesystem::path(directory) / TRANSACTIONS_FILE).string();
+    string today = currentDateString();
+    const char* types[] = {"WITHDRAWAL", "DEPOSIT", "TRANSFER", "BALANCE_QUERY"};
+    
+    cout << "threads=" << max(1u, thread::hardware_concurrency()) << endl;
+    cout << "lines       file              size(MB)   serial(ms)  parallel(ms)  serial(MB/s)  parallel(MB/s)" << endl;
+    for (size_t n : sizes) {
+        {
+            ofstream accounts(accountsFile);
+            ofstream transactions(transactionsFile);
+            mt19937_64 rng(n);
+            for (size_t i = 0; i < n; i++) {
+                accounts << benchmarkAccountNumber(i) << ",Bench,000000000000000000,123456,"
+                         << Money::fromFen(rng() % 100000000) << '\n';
+                const char* type = types[rng() % 4];
+                transactions << benchmarkAccountNumber(rng() % n) << ',' << type << ','
+                             << Money::fromYuan(100 * (1 + rng() % 20)) << ',' << today << ",12:00:00,";
+                if (type == types[2]) {
+                    transactions << benchmarkAccountNumber(rng() % n);
+                }
+                transactions << '\n';
+            }
+        }
+        
+        auto report = [n](const char* name, const string& fileName, double serialMs, double parallelMs) {
+            double megabytes = filesystem::file_size(fileName) / 1048576.0;
+            printf("%-11zu %-17s %9.1f %12.0f %13.0f %13.0f %15.0f\n", n, name, megabytes, serialMs, parallelMs,
+                   megabytes * 1000 / serialMs, megabytes * 1000 / parallelMs);
+        };
+        
+        double serialMs, parallelMs;
+        size_t serialCount, parallelCount;
+        {
+            AccountTable accounts;
+            auto start = chrono::steady_clock::now();
+            FileManager::readAccountsFileSerial(accountsFile, accounts);
+            serialMs = elapsedMs(start);
+            serialCount = accounts.size();
+        }
+        {
+            AccountTable accounts;
+            auto start = chrono::steady_clock::now();
+            FileManager::readAccountsFile(accountsFile, accounts);
+            parallelMs = elapsedMs(start);
+            parallelCount = accounts.size();
+        }
+        report(ACCOUNTS_FILE.c_str(), accountsFile, serialMs, parallelMs);
+        if (serialCount != parallelCount) {
+            cerr << "benchmark account count mismatch: " << serialCount << " vs " << parallelCount << endl;
+        }
+        
+        {
+            WithdrawalIndex withdrawals;
+            TransactionHistoryIndex history;
+            withdrawals.reset();
+            history.reset();
+            auto start = chrono::steady_clock::now();
+            FileManager::scanTransactionsFileSerial(transactionsFile, withdrawals, history);
+            serialMs = elapsedMs(start);
+        }
+        {
+            WithdrawalIndex withdrawals;
+            TransactionHistoryIndex history;
+            withdrawals.reset();
+            history.reset();
+            auto start = chrono::steady_clock::now();
+            FileManager::scanTransactionsFile(transactionsFile, withdrawals, history);
+            parallelMs = elapsedMs(start);
+        }
+        report(TRANSACTIONS_FILE.c_str(), transactionsFile, serialMs, parallelMs);
+    }
+    
+    remove(accountsFile.c_str());
+    remove(transactionsFile.c_str());
+}
+
+// 生成 n 条随机交易，同时写成 CSV 交易文件和二进制日志
+// 时间均匀分布在 [start, start + span) 秒内、按时间顺序排列，账户从 accounts 个测试账号中随机选取
+void writeBenchmarkTransactions(size_t n, size_t accounts, time_t start, int64_t span,
+                                const string& csvFile, const string& binaryFile) {
+    const char* types[] = {"WITHDRAWAL", "DEPOSIT", "TRANSFER", "BALANCE_QUERY"};
+    ofstream csv(csvFile, ios::binary);
+    ofstream binary(binaryFile, ios::binary);
+    mt19937_64 rng(n);
+    string csvBuffer, binaryBuffer;
+    TransactionLogCodec::appendHeader(binaryBuffer);
+    for (size_t i = 0; i < n; i++) {
+        tm localTime = localTimeOf(start + (time_t)((double)i * span / n));
+        const char* type = types[rng() % 4];
+        Transaction trans(benchmarkAccountNumber(rng() % accounts), type,
+                          type == types[3] ? Money() : Money::fromYuan(100 * (1 + rng() % 20)),
+                          formatDate(localTime), formatTime(localTime),
+                          type == types[2] ? benchmarkAccountNumber(rng() % accounts) : "");
+        trans.appendLogLine(csvBuffer);
+        TransactionLogCodec::encode(binaryBuffer, trans);
+        if (csvBuffer.size() >= (1 << 20)) {
+            csv.write(csvBuffer.data(), csvBuffer.size());
+            binary.write(binaryBuffer.data(), binaryBuffer.size());
+            csvBuffer.clear();
+            binaryBuffer.clear();
+        }
+    }
+    csv.write(csvBuffer.data(), csvBuffer.size());
+    binary.write(binaryBuffer.data(), binaryBuffer.size());
+}
+
+// CSV 与二进制交易日志的体积和建索引扫描耗时对比，文件生成在 atm_bench/ 目录
+void runLogBenchmark(const vector<size_t>& sizes, const string& directory) {
+    filesystem::create_directories(directory);
+    string csvFile = (filesystem::path(directory) / TRANSACTIONS_FILE).string();
+    string binaryFile = (filesystem::path(directory) / TRANSACTIONS_BINARY_FILE).string();
+    cout << "records     format      size(MB)  bytes/rec   serial(ms)  parallel(ms)" << endl;
+    for (size_t n : sizes) {
+        writeBenchmarkTransactions(n, n, time(0) - 86400, 86400, csvFile, binaryFile);
+        
+        auto scanMs = [](auto scan) {
+            WithdrawalIndex withdrawals;
+            TransactionHistoryIndex history;
+            withdrawals.reset();
+            history.reset();
+            auto start = chrono::steady_clock::now();
+            scan(withdrawals, history);
+            return elapsedMs(start);
+        };
+        double csvSerialMs = scanMs([&](WithdrawalIndex& w, TransactionHistoryIndex& h) {
+            FileManager::scanTransactionsFileSerial(csvFile, w, h);
+        });
+        double csvParallelMs = scanMs([&](WithdrawalIndex& w, TransactionHistoryIndex& h) {
+            FileManager::scanTransactionsFile(csvFile, w, h);
+        });
+        double binaryMs = scanMs([&](WithdrawalIndex& w, TransactionHistoryIndex& h) {
+            FileManager::scanBinaryTransactionsFile(binaryFile, w, h);
+        });
+        
+        // 只解码不建索引，单看格式本身的扫描开销
+        auto start = chrono::steady_clock::now();
+        size_t decoded = 0;
+        int64_t checksum = 0;
+        {
+            TransactionLogReader reader;
+            reader.open(binaryFile);
+            TransactionLogEntry entry;
+            uint64_t offset;
+            while (reader.next(entry, offset)) {
+                decoded++;
+                checksum += entry.amountFen;
+            }
+        }
+        double decodeMs = elapsedMs(start);
+        start = chrono::steady_clock::now();
+        size_t parsed = 0;
+        {
+            ifstream in(csvFile, ios::binary);
+            string line;
+            Transaction trans;
+            while (getline(in, line)) {
+                if (Transaction::fromLogLine(line, trans)) {
+                    parsed++;
+                    checksum -= trans.amount.toFen();
+                }
+            }
+        }
+        double parseMs = elapsedMs(start);
+        
+        double csvBytes = filesystem::file_size(csvFile);
+        double binaryBytes = filesystem::file_size(binaryFile);
+        printf("%-11zu %-10s %9.1f %10.1f %12.0f %13.0f\n", n, "csv", csvBytes / 1048576, csvBytes / n,
+               csvSerialMs, csvParallelMs);
+        printf("%-11zu %-10s %9.1f %10.1f %12.0f %13s\n", n, "binary", binaryBytes / 1048576, binaryBytes / n,
+               binaryMs, "-");
+        printf("            %.1fx smaller, index scan %.1fx faster than serial csv; "
+               "decode only: csv %.0f ms, binary %.0f ms (%.1fx)\n",
+               csvBytes / binaryBytes, csvSerialMs / max(binaryMs, 1e-9), parseMs, decodeMs,
+               parseMs / max(decodeMs, 1e-9));
+        if (decoded != parsed || checksum != 0) {
+            cerr << "benchmark record mismatch: " << parsed << " csv vs " << decoded << " binary" << endl;
+        }
+    }
+    
+    remove(csvFile.c_str());
+    remove(binaryFile.c_str());
+}
+
+// 交易报表：把交易文件载入列式数组，并行汇总按日、按小时的各类交易和交易额最大的账户
+// 参数: file=<交易文件>（默认按 --log-format） from=YYYY-MM-DD to=YYYY-MM-DD top=N hours=day|all out=<文件>
+// 报表写到 out（默认标准输出），载入和汇总耗时写到标准错误
+int runReport(const vector<string>& args) {
+    string fileName = FileManager::transactionLogFile();
+    string outFile;
+    int fromKey = -1, toKey = -1;
+    size_t top = REPORT_TOP_ACCOUNTS;
+    bool allHours = false;
+    for (const string& arg : args) {
+        size_t eq = arg.find('=');
+        string key = arg.substr(0, eq);
+        string value = eq == string::npos ? "" : arg.substr(eq + 1);
+        
+        if (key == "file") {
+            fileName = value;
+        } else if (key == "from" || key == "to") {
+            int date = dateKey(value);
+            if (date < 0) {
+                cerr << "Invalid date: " << arg << endl;
+                return 1;
+            }
+            (key == "from" ? fromKey : toKey) = date;
+        } else if (key == "top") {
+            top = strtoull(value.c_str(), nullptr, 10);
+        } else if (key == "hours") {
+            allHours = value == "all";
+        } else if (key == "out") {
+            outFile = value;
+        } else {
+            cerr << "Unknown report option: " << arg << endl;
+            return 1;
+        }
+    }
+    
+    auto start = chrono::steady_clock::now();
+    TransactionColumns columns;
+    size_t loadParts = columns.load(fileName);
+    if (loadParts == 0) {
+        cerr << "Cannot open " << fileName << endl;
+        return 1;
+    }
+    double loadMs = elapsedMs(start);
+    start = chrono::steady_clock::now();
+    TransactionReport report = TransactionReport::build(columns, fromKey, toKey, top);
+    double aggregateMs = elapsedMs(start);
+    
+    ofstream file;
+    if (!outFile.empty()) {
+        file.open(outFile);
+        if (!file.is_open()) {
+            cerr << "Cannot write " << outFile << endl;
+            return 1;
+        }
+    }
+    report.print(outFile.empty() ? cout : file, columns, allHours);
+    fprintf(stderr, "loaded %zu records in %.0f ms (%zu parts), aggregated in %.0f ms (%zu parts)\n",
+            columns.size(), loadMs, loadParts, aggregateMs, report.parts);
+    return 0;
+}
+
+// 账本核对，参数 key=value：file=<交易文件> baseline=<基线账户文件> accounts=<账户文件> since=<日期[T时间]>
+// rebuild=<输出账户文件> out=<报告文件>。账户文件默认为 accounts.dat，已分片时为全部分片文件
+// 有账户对不上时返回 1
+int runReconcile(const vector<string>& args) {
+    string fileName = FileManager::transactionLogFile();
+    string outFile, rebuildFile;
+    vector<string> baselineFiles, accountFiles;
+    int64_t sinceLocal = INT64_MIN;
+    for (const string& arg : args) {
+        size_t eq = arg.find('=');
+        string key = arg.substr(0, eq);
+        string value = eq == string::npos ? "" : arg.substr(eq + 1);
+        
+        if (key == "file") {
+            fileName = value;
+        } else if (key == "baseline") {
+            baselineFiles.push_back(value);
+        } else if (key == "accounts") {
+            accountFiles.push_back(value);
+        } else if (key == "since") {
+            size_t separator = value.find('T');
+            int date = dateKey(string_view(value).substr(0, separator));
+            int seconds = separator == string::npos ? 0 : secondsOfDay(string_view(value).substr(separator + 1));
+            if (date < 0 || seconds < 0) {
+                cerr << "Invalid time: " << arg << endl;
+                return 1;
+            }
+            sinceLocal = daysFromCivil(date / 10000, date / 100 % 100, date % 100) * 86400 + seconds;
+        } else if (key == "rebuild") {
+            rebuildFile = value;
+        } else if (key == "out") {
+            outFile = value;
+        } else {
+            cerr << "Unknown reconcile option: " << arg << endl;
+            return 1;
+        }
+    }
+    if (accountFiles.empty()) {
+        size_t shardCount = AccountShards::readManifest();
+        for (size_t i = 0; i < shardCount; i++) {
+            accountFiles.push_back(AccountShards::fileName(i));
+        }
+        if (shardCount == 0) {
+            accountFiles.push_back(ACCOUNTS_FILE);
+        }
+    }
+    
+    auto start = chrono::steady_clock::now();
+    TransactionColumns columns;
+    if (columns.load(fileName) == 0) {
+        cerr << "Cannot open " << fileName << endl;
+        return 1;
+    }
+    double loadMs = elapsedMs(start);
+    start = chrono::steady_clock::now();
+    LedgerReconciler reconciler;
+    if (!reconciler.run(columns, baselineFiles, accountFiles, sinceLocal)) {
+        cerr << "Cannot open account files" << endl;
+        return 1;
+    }
+    double replayMs = elapsedMs(start);
+    
+    ofstream file;
+    if (!outFile.empty()) {
+        file.open(outFile);
+        if (!file.is_open()) {
+            cerr << "Cannot write " << outFile << endl;
+            return 1;
+        }
+    }
+    reconciler.print(outFile.empty() ? cout : file, columns);
+    fprintf(stderr, "loaded %zu records in %.0f ms, replayed and compared in %.0f ms (%zu parts)\n",
+            columns.size(), loadMs, replayMs, reconciler.parts);
+    
+    if (!rebuildFile.empty()) {
+        start = chrono::steady_clock::now();
+        if (!reconciler.rebuild(rebuildFile, columns, baselineFiles, accountFiles)) {
+            cerr << "Cannot write " << rebuildFile << endl;
+            return 1;
+        }
+        fprintf(stderr, "rebuilt %s in %.0f ms\n", rebuildFile.c_str(), elapsedMs(start));
+    }
+    return reconciler.mismatches.empty() ? 0 : 1;
+}
+
+// 报表耗时对比：逐行 getline 解析后用 map 分组（相当于临时脚本的做法）vs 列式载入加并行汇总
+// 交易分布在过去一年内，文件生成在 atm_bench/ 目录
+void runReportBenchmark(const vector<size_t>& sizes, const string& directory) {
+    filesystem::create_directories(directory);
+    string csvFile = (filesystem::path(directory) / TRANSACTIONS_FILE).string();
+    string binaryFile = (filesystem::path(directory) / TRANSACTIONS_BINARY_FILE).string();
+    
+    cout << "records     method            load(ms)  aggregate(ms)  total(ms)" << endl;
+    for (size_t n : sizes) {
+        writeBenchmarkTransactions(n, max<size_t>(1, n / 100), time(0) - 365 * 86400, 365 * 86400, csvFile,
+                                   binaryFile);
+        
+        // 基准：每行解析成 Transaction，按 (日期, 小时) 和账号用标准容器累加
+        auto start = chrono::steady_clock::now();
+        map<pair<int, int>, TransactionReport::Totals> naiveHours;
+        unordered_map<string, int64_t> naiveVolumes;
+        {
+            ifstream in(csvFile, ios::binary);
+            string line;
+            Transaction trans;
+            while (getline(in, line)) {
+                if (!Transaction::fromLogLine(line, trans)) {
+                    continue;
+                }
+                TransactionType type = transactionTypeOf(trans.type);
+                TransactionReport::Totals& bucket = naiveHours[{dateKey(trans.date), secondsOfDay(trans.time) / 3600}];
+                bucket.count[type]++;
+                bucket.amountFen[type] += trans.amount.toFen();
+                if (type != TXN_BALANCE_QUERY) {
+                    naiveVolumes[trans.accountNumber] += trans.amount.toFen();
+                    if (!trans.targetAccount.empty()) {
+                        naiveVolumes[trans.targetAccount] += trans.amount.toFen();
+                    }
+                }
+            }
+        }
+        vector<pair<int64_t, string>> naiveTop;
+        for (const auto& item : naiveVolumes) {
+            naiveTop.emplace_back(-item.second, item.first);
+        }
+        size_t top = min(REPORT_TOP_ACCOUNTS, naiveTop.size());
+        partial_sort(naiveTop.begin(), naiveTop.begin() + top, naiveTop.end());
+        double naiveMs = elapsedMs(start);
+        printf("%-11zu %-16s %10s %14s %10.0f\n", n, "getline+map", "-", "-", naiveMs);
+        
+        int64_t naiveSum = 0;
+        for (const auto& item : naiveHours) {
+            naiveSum += item.second.amountFen[TXN_WITHDRAWAL] + item.second.amountFen[TXN_TRANSFER];
+        }
+        for (const string& fileName : {csvFile, binaryFile}) {
+            start = chrono::steady_clock::now();
+            TransactionColumns columns;
+            columns.load(fileName);
+            double loadMs = elapsedMs(start);
+            start = chrono::steady_clock::now();
+            TransactionReport report = TransactionReport::build(columns, -1, -1, REPORT_TOP_ACCOUNTS);
+            double aggregateMs = elapsedMs(start);
+            printf("%-11zu %-16s %10.0f %14.1f %10.0f\n", n, fileName == csvFile ? "columnar csv" : "columnar binary",
+                   loadMs, aggregateMs, loadMs + aggregateMs);
+            
+            int64_t sum = 0;
+            for (const TransactionReport::Totals& totals : report.hours) {
+                sum += totals.amountFen[TXN_WITHDRAWAL] + totals.amountFen[TXN_TRANSFER];
+            }
+            if (sum != naiveSum || report.topAccounts.size() != top ||
+                (top > 0 && report.topAccounts[0].amountFen != -naiveTop[0].first)) {
+                cerr << "benchmark report mismatch for " << fileName << endl;
+            }
+        }
+    }
+    
+    remove(csvFile.c_str());
+    remove(binaryFile.c_str());
+}
+
+// 账本核对耗时对比：逐行 getline 解析交易和账户文件、用 unordered_map 重放 vs 列式载入加分区并行重放
+// 交易分布在过去一年内，平均每个账户 100 笔；账户文件按重放结果生成后改动 3 个账户的余额，两种方法都应报告 3 个不符
+void runReconcileBenchmark(const vector<size_t>& sizes, const string& directory) {
+    const size_t ALTERED_ACCOUNTS = 3;
+    filesystem::create_directories(directory);
+    string csvFile = (filesystem::path(directory) / TRANSACTIONS_FILE).string();
+    string binaryFile = (filesystem::path(directory) / TRANSACTIONS_BINARY_FILE).string();
+    string accountsFile = (filesystem::path(directory) / ACCOUNTS_FILE).string();
+    string rebuiltFile = accountsFile + ".rebuilt";
+    
+    cout << "records     accounts    method            load(ms)  replay(ms)  total(ms)  mismatches" << endl;
+    for (size_t n : sizes) {
+        size_t accountCount = max<size_t>(ALTERED_ACCOUNTS, n / 100);
+        writeBenchmarkTransactions(n, accountCount, time(0) - 365 * 86400, 365 * 86400, csvFile, binaryFile);
+        
+        // 基准：逐行解析成 Transaction，按账号字符串累加余额，再逐行读账户文件比对
+        auto replayNaive = [&]() {
+            unordered_map<string, int64_t> balances;
+            ifstream in(csvFile, ios::binary);
+            string line;
+            Transaction trans;
+            while (getline(in, line)) {
+                if (!Transaction::fromLogLine(line, trans)) {
+                    continue;
+                }
+                TransactionType type = transactionTypeOf(trans.type);
+                if (type == TXN_BALANCE_QUERY) {
+                    continue;
+                }
+                auto account = balances.emplace(trans.accountNumber, INITIAL_BALANCE.toFen()).first;
+                bool credit = type == TXN_DEPOSIT || type == TXN_INTEREST;
+                account->second += credit ? trans.amount.toFen() : -trans.amount.toFen();
+                if (type == TXN_TRANSFER && !trans.targetAccount.empty()) {
+                    balances.emplace(trans.targetAccount, INITIAL_BALANCE.toFen()).first->second += trans.amount.toFen();
+                }
+            }
+            return balances;
+        };
+        {
+            unordered_map<string, int64_t> balances = replayNaive();
+            ofstream out(accountsFile, ios::binary);
+            string buffer;
+            for (size_t i = 0; i < accountCount; i++) {
+                string accountNumber = benchmarkAccountNumber(i);
+                auto it = balances.find(accountNumber);
+                int64_t fen = (it == balances.end() ? INITIAL_BALANCE.toFen() : it->second) + (i < ALTERED_ACCOUNTS ? 100 : 0);
+                buffer += Account(accountNumber, "Bench", "000000000000000000", "123456", Money::fromFen(fen)).toFileString();
+                buffer += '\n';
+            }
+            out.write(buffer.data(), buffer.size());
+        }
+        
+        auto start = chrono::steady_clock::now();
+        unordered_map<string, int64_t> balances = replayNaive();
+        size_t naiveMismatches = 0;
+        {
+            ifstream in(accountsFile, ios::binary);
+            string line;
+            while (getline(in, line)) {
+                Account account = Account::fromFileString(line);
+                auto it = balances.find(account.getAccountNumber());
+                int64_t expected = it == balances.end() ? INITIAL_BALANCE.toFen() : it->second;
+                naiveMismatches += account.getBalance().toFen() != expected;
+            }
+        }
+        double naiveMs = elapsedMs(start);
+        printf("%-11zu %-11zu %-16s %10s %11s %10.0f %11zu\n", n, accountCount, "getline+map", "-", "-", naiveMs,
+               naiveMismatches);
         
-        recordTransaction("BALANCE_QUERY", 0.0);
+        for (const string& fileName : {csvFile, binaryFile}) {
+            start = chrono::steady_clock::now();
+            TransactionColumns columns;
+            columns.load(fileName);
+            double loadMs = elapsedMs(start);
+            start = chrono::steady_clock::now();
+            LedgerReconciler reconciler;
+            reconciler.run(columns, {}, {accountsFile}, INT64_MIN);
+            double replayMs = elapsedMs(start);
+            printf("%-11zu %-11zu %-16s %10.0f %11.0f %10.0f %11zu\n", n, accountCount,
+                   fileName == csvFile ? "parallel csv" : "parallel binary", loadMs, replayMs, loadMs + replayMs,
+                   reconciler.mismatches.size());
+            if (reconciler.mismatches.size() != naiveMismatches) {
+                cerr << "benchmark reconcile mismatch for " << fileName << endl;
+            }
+            if (fileName != csvFile) {
+                continue;
+            }
+            
+            // 重建的账户文件再核对一次应当全部相符
+            start = chrono::steady_clock::now();
+            reconciler.rebuild(rebuiltFile, columns, {}, {accountsFile});
+            double rebuildMs = elapsedMs(start);
+            LedgerReconciler check;
+            check.run(columns, {}, {rebuiltFile}, INT64_MIN);
+            printf("%-11zu %-11zu %-16s %10s %11s %10.0f %11zu\n", n, accountCount, "rebuild", "-", "-", rebuildMs,
+                   check.mismatches.size());
+        }
+    }
+    
+    for (const string& fileName : {csvFile, binaryFile, accountsFile, rebuiltFile}) {
+        remove(fileName.c_str());
+    }
+}
+
+// 压测的操作类型
+enum WorkloadOp { WL_LOGIN, WL_BALANCE, WL_WITHDRAW, WL_DEPOSIT, WL_TRANSFER, WL_OP_COUNT };
+const char* const WORKLOAD_OP_NAMES[WL_OP_COUNT] = {"login", "balance", "withdraw", "deposit", "transfer"};
+
+struct WorkloadConfig {
+    size_t accounts;
+    size_t operations;
+    size_t sessions;
+    int mix[WL_OP_COUNT];
+    StorageMode storage;
+    size_t shards;
+    string replayFile;
+    string directory;
+    uint64_t seed;
+    
+    WorkloadConfig()
+        : accounts(10000), operations(100000), sessions(64), mix{5, 40, 20, 20, 15},
+          storage(STORAGE_MEMORY), shards(0), directory("atm_bench"), seed(1) {}
+};
+
+// 每类操作的耗时（纳秒）和成功次数
+struct WorkloadStats {
+    vector<uint64_t> latencies[WL_OP_COUNT];
+    size_t succeeded[WL_OP_COUNT] = {};
+    
+    void record(int op, chrono::steady_clock::time_point start, bool ok) {
+        latencies[op].push_back(chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count());
+        succeeded[op] += ok;
+    }
+};
+
+double percentileUs(const vector<uint64_t>& sorted, double p) {
+    if (sorted.empty()) {
+        return 0.0;
+    }
+    size_t index = min(sorted.size() - 1, (size_t)(p * sorted.size()));
+    return sorted[index] / 1000.0;
+}
+
+void printWorkloadReport(WorkloadStats& stats, double totalMs) {
+    size_t total = 0;
+    for (int op = 0; op < WL_OP_COUNT; op++) {
+        total += stats.latencies[op].size();
+    }
+    printf("total %zu ops in %.1f ms, %.0f ops/s\n", total, totalMs, total * 1000.0 / max(totalMs, 1e-9));
+    printf("%-10s %10s %10s %10s %10s %10s\n", "op", "count", "ok", "p50(us)", "p99(us)", "p999(us)");
+    for (int op = 0; op < WL_OP_COUNT; op++) {
+        vector<uint64_t>& samples = stats.latencies[op];
+        sort(samples.begin(), samples.end());
+        printf("%-10s %10zu %10zu %10.1f %10.1f %10.1f\n", WORKLOAD_OP_NAMES[op], samples.size(), stats.succeeded[op],
+               percentileUs(samples, 0.50), percentileUs(samples, 0.99), percentileUs(samples, 0.999));
+    }
+}
+
+// 按配置的比例随机生成操作
+void runGeneratedWorkload(Bank& bank, const WorkloadConfig& config, WorkloadStats& stats) {
+    mt19937_64 rng(config.seed);
+    int totalWeight = 0;
+    for (int weight : config.mix) {
+        totalWeight += weight;
+    }
+    if (totalWeight <= 0) {
+        return;
+    }
+    
+    // 预先登录一批会话，其余操作随机落在这些会话上
+    vector<Session> sessions(max<size_t>(1, config.sessions));
+    for (Session& session : sessions) {
+        bank.login(session, benchmarkAccountNumber(rng() % config.accounts), "123456");
     }
     
-    // 取款
-    void withdraw() {
-        if (!isLoggedIn || !currentAccount) {
-            cout << "Please login first!" << endl;
-            return;
-        }
-        
-        double amount;
-        cout << "\nWithdrawal" << endl;
-        cout << "Single withdrawal limit: ¥" << SINGLE_WITHDRAWAL_LIMIT << endl;
-        cout << "Daily withdrawal limit: ¥" << DAILY_WITHDRAWAL_LIMIT << endl;
-        cout << "Withdrawal amount must be multiple of " << WITHDRAWAL_MULTIPLE << endl;
-        
-        double todayTotal = FileManager::getTodayWithdrawalTotal(currentAccount->getAccountNumber());
-        cout << "Today's withdrawals: ¥" << todayTotal << endl;
-        
-        cout << "Please enter withdrawal amount: ";
-        cin >> amount;
-        
-        if (cin.fail() || amount <= 0) {
-            cin.clear();
-            cin.ignore(numeric_limits<streamsize>::max(), '\n');
-            cout << "Invalid amount!" << endl;
-            return;
+    for (size_t i = 0; i < config.operations; i++) {
+        int pick = rng() % totalWeight;
+        int op = 0;
+        while (pick >= config.mix[op]) {
+            pick -= config.mix[op];
+            op++;
         }
         
-        if (fmod(amount, WITHDRAWAL_MULTIPLE) != 0) {
-            cout << "Withdrawal amount must be multiple of " << WITHDRAWAL_MULTIPLE << "!" << endl;
-            return;
-        }
+        Session& session = sessions[rng() % sessions.size()];
+        string account = benchmarkAccountNumber(rng() % config.accounts);
+        Money amount = Money::fromYuan(WITHDRAWAL_MULTIPLE * (1 + rng() % 5));
+        Money balance;
         
-        if (amount > SINGLE_WITHDRAWAL_LIMIT) {
-            cout << "Exceeds single withdrawal limit!" << endl;
-            return;
+        auto start = chrono::steady_clock::now();
+        OpStatus status = OP_FAILED;
+        switch (op) {
+            case WL_LOGIN: status = bank.login(session, account, "123456"); break;
+            case WL_BALANCE: status = bank.checkBalance(session, balance); break;
+            case WL_WITHDRAW: status = bank.withdraw(session, amount); break;
+            case WL_DEPOSIT: status = bank.deposit(session, amount); break;
+            case WL_TRANSFER: status = bank.transfer(session, account, amount); break;
         }
+        stats.record(op, start, status == OP_OK);
+    }
+}
+
+// 回放行协议命令文件，QUIT 之后开始新会话
+void runReplayWorkload(Bank& bank, const string& fileName, WorkloadStats& stats) {
+    ifstream in(fileName);
+    if (!in.is_open()) {
+        cerr << "Cannot open workload file: " << fileName << endl;
+        return;
+    }
+    
+    Session session;
+    string line;
+    while (getline(in, line)) {
+        string command = line.substr(0, line.find(' '));
+        transform(command.begin(), command.end(), command.begin(), ::toupper);
+        int op = command == "LOGIN" ? WL_LOGIN : command == "BALANCE" ? WL_BALANCE :
+                 command == "WITHDRAW" ? WL_WITHDRAW : command == "DEPOSIT" ? WL_DEPOSIT :
+                 command == "TRANSFER" ? WL_TRANSFER : -1;
         
-        if (todayTotal + amount > DAILY_WITHDRAWAL_LIMIT) {
-            cout << "Exceeds daily withdrawal limit!" << endl;
-            return;
+        bool closeSession = false;
+        auto start = chrono::steady_clock::now();
+        string response = executeCommand(bank, session, line, closeSession);
+        if (op >= 0) {
+            stats.record(op, start, response.compare(0, 2, "OK") == 0);
         }
-        
-        if (amount > currentAccount->getBalance()) {
-            cout << "Insufficient balance!" << endl;
-            return;
+        if (closeSession) {
+            session = Session();
         }
+    }
+}
+
+// 非交互压测：在独立目录中生成 N 个账户，按比例生成或回放操作，统计吞吐和延迟分位数
+// 参数: accounts=N operations=N sessions=N mix=login,balance,withdraw,deposit,transfer
+//       storage=memory|csv|journal|binary shards=N replay=<file> dir=<dir> seed=N metrics=on|off
+int runWorkloadBenchmark(const vector<string>& args) {
+    WorkloadConfig config;
+    for (const string& arg : args) {
+        size_t eq = arg.find('=');
+        string key = arg.substr(0, eq);
+        string value = eq == string::npos ? "" : arg.substr(eq + 1);
         
-        if (currentAccount->withdraw(amount)) {
-            cout << "Withdrawal successful! Withdrawn amount: ¥" << amount << endl;
-            cout << "Remaining balance: ¥" << currentAccount->getBalance() << endl;
-            
-            recordTransaction("WITHDRAWAL", amount);
-            
-            FileManager::saveAccounts(accounts);
+        if (key == "accounts") {
+            config.accounts = max<size_t>(2, strtoull(value.c_str(), nullptr, 10));
+        } else if (key == "operations") {
+            config.operations = strtoull(value.c_str(), nullptr, 10);
+        } else if (key == "sessions") {
+            config.sessions = strtoull(value.c_str(), nullptr, 10);
+        } else if (key == "mix") {
+            stringstream ss(value);
+            string weight;
+            for (int op = 0; op < WL_OP_COUNT; op++) {
+                config.mix[op] = getline(ss, weight, ',') ? max(0, atoi(weight.c_str())) : 0;
+            }
+        } else if (key == "storage") {
+            config.storage = value == "csv" ? STORAGE_CSV : value == "journal" ? STORAGE_JOURNAL :
+                             value == "binary" ? STORAGE_BINARY : value == "lazy" ? STORAGE_LAZY : STORAGE_MEMORY;
+        } else if (key == "shards") {
+            config.shards = strtoull(value.c_str(), nullptr, 10);
+        } else if (key == "replay") {
+            config.replayFile = filesystem::absolute(value).string();
+        } else if (key == "dir") {
+            config.directory = value;
+        } else if (key == "seed") {
+            config.seed = strtoull(value.c_str(), nullptr, 10);
+        } else if (key == "metrics") {
+            Metrics::setEnabled(value != "off");
         } else {
-            cout << "Withdrawal failed!" << endl;
+            cerr << "Unknown benchmark option: " << arg << endl;
+            return 1;
         }
     }
     
-    // 存款
-    void deposit() {
-        if (!isLoggedIn || !currentAccount) {
-            cout << "Please login first!" << endl;
-            return;
-        }
-        
-        double amount;
-        cout << "\nDeposit" << endl;
-        cout << "Please enter deposit amount: ";
-        cin >> amount;
-        
-        if (cin.fail() || amount <= 0) {
-            cin.clear();
-            cin.ignore(numeric_limits<streamsize>::max(), '\n');
-            cout << "Invalid amount!" << endl;
-            return;
+    // 在独立目录中运行，避免覆盖真实数据
+    filesystem::create_directories(config.directory);
+    filesystem::current_path(config.directory);
+    for (const string& name : {ACCOUNTS_FILE, ACCOUNTS_BINARY_FILE, ACCOUNTS_JOURNAL_FILE,
+                               ACCOUNTS_JOURNAL_FILE + ".old", TRANSACTIONS_FILE,
+                               TRANSACTIONS_BINARY_FILE, LOCKED_ACCOUNTS_FILE}) {
+        remove(name.c_str());
+    }
+    AccountShards::removeFiles();
+    
+    AccountTable accounts;
+    accounts.reserve(config.accounts);
+    for (size_t i = 0; i < config.accounts; i++) {
+        accounts.upsert(Account(benchmarkAccountNumber(i), "Bench", "000000000000000000", "123456",
+                                Money::fromYuan(1000000)));
+    }
+    FileManager::saveAccounts(accounts);
+    accounts.clear();
+    
+    const char* storageNames[] = {"csv", "journal", "binary", "memory", "lazy"};
+    cout << "storage=" << storageNames[config.storage] << " accounts=" << config.accounts
+         << " shards=" << config.shards << " metrics=" << (Metrics::isEnabled() ? "on" : "off");
+    if (config.replayFile.empty()) {
+        cout << " operations=" << config.operations << " sessions=" << config.sessions;
+    } else {
+        cout << " replay=" << config.replayFile;
+    }
+    cout << endl;
+    
+    WorkloadStats stats;
+    {
+        Bank bank(config.storage, config.shards);
+        auto start = chrono::steady_clock::now();
+        if (config.replayFile.empty()) {
+            runGeneratedWorkload(bank, config, stats);
+        } else {
+            runReplayWorkload(bank, config.replayFile, stats);
         }
+        printWorkloadReport(stats, elapsedMs(start));
+    }
+    return 0;
+}
+
+// 并发转账压力测试：多个线程在内存模式下随机转账和查询余额，另一个线程不断核对总额
+// 检查资金守恒（任何时刻的一致快照和结束时的总额都等于初始总额），并输出各线程数下的吞吐
+// 参数: accounts=N operations=N（每轮总操作数） threads=1,2,4,... storage=memory|csv|journal|binary|lazy
+//       shards=N dir=<dir> seed=N
+int runTransferStress(const vector<string>& args) {
+    StorageMode storage = STORAGE_MEMORY;
+    size_t shardCount = 0;
+    size_t accountCount = 1000;
+    size_t operations = 1000000;
+    vector<size_t> threadCounts;
+    string directory = "atm_bench";
+    uint64_t seed = 1;
+    for (const string& arg : args) {
+        size_t eq = arg.find('=');
+        string key = arg.substr(0, eq);
+        string value = eq == string::npos ? "" : arg.substr(eq + 1);
         
-        if (currentAccount->deposit(amount)) {
-            cout << "Deposit successful! Deposit amount: ¥" << amount << endl;
-            cout << "Current balance: ¥" << currentAccount->getBalance() << endl;
-            
-            recordTransaction("DEPOSIT", amount);
-            
-            FileManager::saveAccounts(accounts);
+        if (key == "accounts") {
+            accountCount = max<size_t>(2, strtoull(value.c_str(), nullptr, 10));
+        } else if (key == "operations") {
+            operations = strtoull(value.c_str(), nullptr, 10);
+        } else if (key == "threads") {
+            stringstream ss(value);
+            string count;
+            while (getline(ss, count, ',')) {
+                threadCounts.push_back(max<size_t>(1, strtoull(count.c_str(), nullptr, 10)));
+            }
+        } else if (key == "storage") {
+            storage = value == "csv" ? STORAGE_CSV : value == "journal" ? STORAGE_JOURNAL :
+                      value == "binary" ? STORAGE_BINARY : value == "lazy" ? STORAGE_LAZY : STORAGE_MEMORY;
+        } else if (key == "shards") {
+            shardCount = strtoull(value.c_str(), nullptr, 10);
+        } else if (key == "dir") {
+            directory = value;
+        } else if (key == "seed") {
+            seed = strtoull(value.c_str(), nullptr, 10);
         } else {
-            cout << "Deposit failed!" << endl;
+            cerr << "Unknown stress option: " << arg << endl;
+            return 1;
         }
     }
-    
-    // 转账
-    void transfer() {
-        if (!isLoggedIn || !currentAccount) {
-            cout << "Please login first!" << endl;
-            return;
+    if (threadCounts.empty()) {
+        size_t cores = max(1u, thread::hardware_concurrency());
+        for (size_t n = 1; n < cores; n *= 2) {
+            threadCounts.push_back(n);
         }
-        
-        string targetAccountNumber;
-        double amount;
-        
-        cout << "\nTransfer" << endl;
-        cout << "Please enter target account number: ";
-        cin >> targetAccountNumber;
-        
-        if (accounts.find(targetAccountNumber) == accounts.end()) {
-            cout << "Target account does not exist!" << endl;
-            return;
+        threadCounts.push_back(cores);
+    }
+    
+    filesystem::create_directories(directory);
+    filesystem::current_path(directory);
+    AccountTable accounts;
+    accounts.reserve(accountCount);
+    for (size_t i = 0; i < accountCount; i++) {
+        accounts.upsert(Account(benchmarkAccountNumber(i), "Bench", "000000000000000000", "123456",
+                                Money::fromYuan(1000)));
+    }
+    Money expected = Money::fromYuan(1000 * (int64_t)accountCount);
+    
+    const char* storageNames[] = {"csv", "journal", "binary", "memory", "lazy"};
+    cout << "storage=" << storageNames[storage] << " accounts=" << accountCount << " shards=" << shardCount
+         << " operations=" << operations << " cores=" << max(1u, thread::hardware_concurrency()) << endl;
+    printf("%-8s %12s %12s %12s %10s %10s\n", "threads", "ops/s", "transfers", "checks", "speedup", "total");
+    bool conserved = true;
+    double baseline = 0;
+    for (size_t threadCount : threadCounts) {
+        // 每轮从相同的初始账户文件开始
+        for (const string& name : {ACCOUNTS_FILE, ACCOUNTS_BINARY_FILE, ACCOUNTS_JOURNAL_FILE,
+                                   ACCOUNTS_JOURNAL_FILE + ".old", TRANSACTIONS_FILE,
+                                   TRANSACTIONS_BINARY_FILE, LOCKED_ACCOUNTS_FILE}) {
+            remove(name.c_str());
         }
+        AccountShards::removeFiles();
+        FileManager::saveAccounts(accounts);
         
-        if (targetAccountNumber == currentAccount->getAccountNumber()) {
-            cout << "Cannot transfer to yourself!" << endl;
-            return;
+        Bank bank(storage, shardCount);
+        // 按需加载的模式先把全部账户载入，核对的总额才覆盖所有账户
+        for (size_t i = 0; i < accountCount; i++) {
+            bank.checkAccount(benchmarkAccountNumber(i));
         }
+        atomic<bool> done(false);
+        atomic<size_t> transfers(0);
+        size_t checks = 0;
+        bool snapshotsOk = true;
         
-        string confirmAccount;
-        cout << "Please re-enter target account number to confirm: ";
-        cin >> confirmAccount;
+        // 核对线程：锁住全部条带取一致快照，总额必须始终不变
+        thread checker([&] {
+            while (!done.load()) {
+                snapshotsOk = snapshotsOk && bank.totalBalance() == expected;
+                checks++;
+                this_thread::sleep_for(chrono::milliseconds(1));
+            }
+        });
         
-        if (targetAccountNumber != confirmAccount) {
-            cout << "Two account numbers do not match!" << endl;
-            return;
+        auto start = chrono::steady_clock::now();
+        vector<thread> workers;
+        for (size_t t = 0; t < threadCount; t++) {
+            size_t quota = operations / threadCount + (t < operations % threadCount ? 1 : 0);
+            workers.emplace_back([&, t, quota] {
+                mt19937_64 rng(seed * 1000003 + t);
+                Session session;
+                size_t succeeded = 0;
+                for (size_t i = 0; i < quota; i++) {
+                    // 偶尔换一个账户登录，使多个线程的源账户互相交叉
+                    if (!session.isLoggedIn || rng() % 64 == 0) {
+                        bank.login(session, benchmarkAccountNumber(rng() % accountCount), "123456");
+                    }
+                    if (rng() % 4 == 0) {
+                        Money balance;
+                        bank.checkBalance(session, balance);
+                        continue;
+                    }
+                    string target = benchmarkAccountNumber(rng() % accountCount);
+                    Money amount = Money::fromFen(1 + rng() % 10000);
+                    succeeded += bank.transfer(session, target, amount) == OP_OK;
+                }
+                transfers += succeeded;
+            });
         }
-        
-        cout << "Please enter transfer amount: ";
-        cin >> amount;
-        
-        if (cin.fail() || amount <= 0) {
-            cin.clear();
-            cin.ignore(numeric_limits<streamsize>::max(), '\n');
-            cout << "Invalid amount!" << endl;
-            return;
+        for (thread& worker : workers) {
+            worker.join();
         }
+        double ms = elapsedMs(start);
+        done = true;
+        checker.join();
         
-        if (amount > currentAccount->getBalance()) {
-            cout << "Insufficient balance!" << endl;
-            return;
+        Money total = bank.totalBalance();
+        bool ok = snapshotsOk && total == expected;
+        conserved = conserved && ok;
+        double throughput = operations * 1000.0 / max(ms, 1e-9);
+        if (baseline == 0) {
+            baseline = throughput;
         }
-        
-        Account& targetAccount = accounts[targetAccountNumber];
-        
-        if (currentAccount->transfer(amount, targetAccount)) {
-            cout << "Transfer successful! Transfer amount: ¥" << amount << endl;
-            cout << "Remaining balance: ¥" << currentAccount->getBalance() << endl;
-            cout << "Recipient: " << targetAccount.getName() << endl;
-            
-            recordTransaction("TRANSFER", amount, targetAccountNumber);
-            
-            FileManager::saveAccounts(accounts);
+        printf("%-8zu %12.0f %12zu %12zu %9.2fx %10s\n", threadCount, throughput, transfers.load(), checks,
+               throughput / baseline, ok ? "ok" : "MISMATCH");
+        if (!ok) {
+            cerr << "money not conserved: expected " << expected << ", got " << total << endl;
+        }
+    }
+    return conserved ? 0 : 1;
+}
+
+// ====================== 主函数 ======================
+// 解析日终作业参数: interest rate=<年利率%> | fee amount=<金额> below=<余额门槛> | dormant days=<天数>
+bool parseEodJob(const vector<string>& args, EodJob& job, string& outputFile) {
+    if (args.empty()) {
+        return false;
+    }
+    const string& name = args[0];
+    if (name == "interest") {
+        job.type = EOD_INTEREST;
+    } else if (name == "fee") {
+        job.type = EOD_FEE;
+    } else if (name == "dormant") {
+        job.type = EOD_DORMANT;
+    } else {
+        return false;
+    }
+    
+    outputFile = DORMANT_ACCOUNTS_FILE;
+    bool rateSet = false, feeSet = false;
+    for (size_t i = 1; i < args.size(); i++) {
+        size_t eq = args[i].find('=');
+        string key = args[i].substr(0, eq);
+        string value = eq == string::npos ? "" : args[i].substr(eq + 1);
+        if (key == "rate") {
+            job.rateBasisPoints = llround(strtod(value.c_str(), nullptr) * 100);
+            rateSet = job.rateBasisPoints > 0;
+        } else if (key == "amount") {
+            feeSet = Money::parse(value, job.fee) && job.fee.isPositive();
+        } else if (key == "below") {
+            if (!Money::parse(value, job.below)) {
+                return false;
+            }
+        } else if (key == "days") {
+            job.dormantDays = max(1, atoi(value.c_str()));
+        } else if (key == "out") {
+            outputFile = value;
         } else {
-            cout << "Transfer failed!" << endl;
+            cerr << "Unknown end-of-day option: " << args[i] << endl;
+            return false;
         }
     }
+    return job.type == EOD_INTEREST ? rateSet : job.type == EOD_FEE ? feeSet : true;
+}
+
+// 运行日终作业：每隔 EOD_PROGRESS_INTERVAL_MS 毫秒在标准错误输出进度，结束后输出汇总
+// 休眠账户作业把结果写入 out 文件，每行 <账号>,<最后交易日期 或 never>
+int runEndOfDay(Bank& bank, const vector<string>& args) {
+    EodJob job;
+    string outputFile;
+    if (!parseEodJob(args, job, outputFile)) {
+        cerr << "用法: --eod interest rate=<年利率%> | fee amount=<金额> [below=<余额>] | dormant [days=N] [out=<文件>]" << endl;
+        return 1;
+    }
     
-    // 修改密码
-    void changePassword() {
-        if (!isLoggedIn || !currentAccount) {
-            cout << "Please login first!" << endl;
-            return;
+    EodResult result;
+    atomic<bool> finished(false);
+    thread reporter([&] {
+        auto start = chrono::steady_clock::now();
+        auto nextReport = start + chrono::milliseconds(EOD_PROGRESS_INTERVAL_MS);
+        while (!finished) {
+            this_thread::sleep_for(chrono::milliseconds(100));
+            if (finished || chrono::steady_clock::now() < nextReport) {
+                continue;
+            }
+            nextReport += chrono::milliseconds(EOD_PROGRESS_INTERVAL_MS);
+            size_t processed = result.processed;
+            size_t total = result.total;
+            cerr << "  " << processed << " / " << total << " accounts (" << processed * 100 / max<size_t>(1, total)
+                 << "%), " << (long long)(processed / (elapsedMs(start) / 1000)) << " accounts/s" << endl;
         }
-        
-        string oldPassword, newPassword, confirmPassword;
-        
-        cout << "\nChange Password" << endl;
-        cout << "Please enter current password: ";
-        cin >> oldPassword;
-        
-        if (!currentAccount->verifyPassword(oldPassword)) {
-            cout << "Current password is incorrect!" << endl;
-            return;
+    });
+    OpStatus status = bank.runEndOfDay(job, result);
+    finished = true;
+    reporter.join();
+    if (status != OP_OK) {
+        cerr << (FileManager::transactionLogHealthy() ? "日终作业仅支持 CSV、日志和内存模式" : "交易日志无法落盘，日终作业已撤销")
+             << endl;
+        return 1;
+    }
+    
+    if (job.type == EOD_DORMANT) {
+        ofstream out(outputFile);
+        if (!out.is_open()) {
+            cerr << "无法写入 " << outputFile << endl;
+            return 1;
         }
-        
-        cout << "Please enter new password (6 digits): ";
-        cin >> newPassword;
-        
-        if (newPassword.length() != PASSWORD_LENGTH) {
-            cout << "Password must be 6 digits!" << endl;
-            return;
+        for (const auto& item : result.dormant) {
+            out << item.first << ',';
+            if (item.second > 0) {
+                out << item.second / 10000 << '-' << setw(2) << setfill('0') << item.second / 100 % 100 << '-'
+                    << setw(2) << item.second % 100 << setfill(' ');
+            } else {
+                out << "never";
+            }
+            out << '\n';
         }
-        
-        if (!all_of(newPassword.begin(), newPassword.end(), ::isdigit)) {
-            cout << "Password must be numeric!" << endl;
-            return;
+    }
+    
+    double totalMs = result.applyMs + result.persistMs;
+    cout << "日终作业 " << args[0] << ": 账户 " << result.total << " 个";
+    if (job.type == EOD_DORMANT) {
+        cout << ", 休眠 " << result.dormant.size() << " 个（" << outputFile << "）";
+    } else {
+        cout << ", 记账 " << result.postings << " 笔, 入账 " << Money::fromFen(result.creditedFen)
+             << ", 扣款 " << Money::fromFen(result.debitedFen);
+    }
+    cout << ", 处理 " << (long long)result.applyMs << " ms, 持久化 " << (long long)result.persistMs << " ms, "
+         << (long long)(result.total / max(1e-3, totalMs / 1000)) << " 账户/s" << endl;
+    return 0;
+}
+
+// 日终计息耗时对比：批处理会话逐个存入利息（单线程、逐条写日志，整批只保存一次）与日终作业（并行遍历、整块写日志）
+// 在 atm_bench/ 目录生成 n 个账户，CSV 模式；逐个存入的对照只在 n 不超过 EOD_BASELINE_MAX 时运行
+void runEodBenchmark(const vector<size_t>& sizes, const string& directory) {
+    const size_t EOD_BASELINE_MAX = 1000000;
+    filesystem::create_directories(directory);
+    filesystem::current_path(directory);
+    
+    EodJob job;
+    job.type = EOD_INTEREST;
+    job.rateBasisPoints = 35;
+    
+    cout << "threads=" << max(1u, thread::hardware_concurrency()) << " job=interest rate=0.35%" << endl;
+    cout << "accounts    method          apply(ms)  persist(ms)   total(ms)   accounts/s    postings" << endl;
+    for (size_t n : sizes) {
+        for (const string& name : {ACCOUNTS_FILE, ACCOUNTS_JOURNAL_FILE, ACCOUNTS_JOURNAL_FILE + ".old",
+                                   TRANSACTIONS_FILE, TRANSACTIONS_BINARY_FILE}) {
+            remove(name.c_str());
         }
-        
-        cout << "Please re-enter new password to confirm: ";
-        cin >> confirmPassword;
-        
-        if (newPassword != confirmPassword) {
-            cout << "Two passwords do not match!" << endl;
-            return;
+        AccountShards::removeFiles();
+        {
+            AccountTable accounts;
+            accounts.reserve(n);
+            mt19937_64 rng(n);
+            for (size_t i = 0; i < n; i++) {
+                accounts.upsert(Account(benchmarkAccountNumber(i), "Bench", "000000000000000000", "123456",
+                                        Money::fromFen(rng() % 100000000)));
+            }
+            FileManager::saveAccounts(accounts);
         }
         
-        currentAccount->setPassword(newPassword);
-        
-        FileManager::saveAccounts(accounts);
+        Bank bank(STORAGE_CSV);
+        if (n <= EOD_BASELINE_MAX) {
+            Session session;
+            size_t postings = 0;
+            auto start = chrono::steady_clock::now();
+            bank.beginBatch(session);
+            for (size_t i = 0; i < n; i++) {
+                if (bank.attachAccount(session, benchmarkAccountNumber(i)) != OP_OK) {
+                    continue;
+                }
+                int64_t fen = job.postingFen(bank.snapshot(session).getBalance().toFen());
+                if (fen > 0 && bank.deposit(session, Money::fromFen(fen)) == OP_OK) {
+                    postings++;
+                }
+            }
+            double applyMs = elapsedMs(start);
+            start = chrono::steady_clock::now();
+            bank.commitBatch(session);
+            double persistMs = elapsedMs(start);
+            printf("%-11zu %-14s %10.0f %12.0f %11.0f %12.0f %11zu\n", n, "batch-deposit", applyMs, persistMs,
+                   applyMs + persistMs, n / ((applyMs + persistMs) / 1000), postings);
+        }
         
-        cout << "Password changed successfully!" << endl;
+        EodResult result;
+        bank.runEndOfDay(job, result);
+        double totalMs = result.applyMs + result.persistMs;
+        printf("%-11zu %-14s %10.0f %12.0f %11.0f %12.0f %11zu\n", n, "end-of-day", result.applyMs, result.persistMs,
+               totalMs, n / (totalMs / 1000), result.postings);
     }
+}
+
+// 出钞方案：查预先排好序的组合表与每次枚举组合对比。钞箱从较少的库存开始随机取款，
+// 出不了时补钞，使各种缺钞情形都会出现；两种方法的方案必须一致
+void runDispenseBenchmark(size_t operations) {
+    const CashDispenser::Notes START = {DEFAULT_CASSETTE_NOTES, DEFAULT_CASSETTE_NOTES, DEFAULT_CASSETTE_NOTES, DEFAULT_CASSETTE_NOTES};
+    const uint64_t multiples = SINGLE_WITHDRAWAL_LIMIT.toFen() / Money::fromYuan(WITHDRAWAL_MULTIPLE).toFen();
     
-    // 显示账户信息
-    void displayAccountInfo() {
-        if (!isLoggedIn || !currentAccount) {
-            cout << "Please login first!" << endl;
-            return;
+    cout << "operations=" << operations << " start=" << CashDispenser::describe(START) << endl;
+    cout << "policy         method      ns/op     rejected   refills" << endl;
+    for (int p = 0; p < DISPENSE_POLICY_COUNT; p++) {
+        DispensePolicy policy = (DispensePolicy)p;
+        const char* name = policy == DISPENSE_BALANCED ? "balanced" : "fewest-notes";
+        mt19937_64 rng(operations);
+        vector<Money> amounts(operations);
+        for (Money& amount : amounts) {
+            amount = Money::fromFen(Money::fromYuan(WITHDRAWAL_MULTIPLE).toFen() * (1 + rng() % multiples));
         }
         
-        currentAccount->display();
-    }
-    
-    void logout() {
-        if (isLoggedIn) {
-            cout << "\nThank you for using, welcome next time!" << endl;
-            currentAccount = nullptr;
-            isLoggedIn = false;
+        vector<CashDispenser::Notes> tablePlans, searchPlans;
+        tablePlans.reserve(operations);
+        searchPlans.reserve(operations);
+        
+        // 连续 4 笔出不了就补钞
+        CashDispenser dispenser("", policy);
+        dispenser.refill(START);
+        size_t tableRejected = 0, tableRefills = 0, misses = 0;
+        auto start = chrono::steady_clock::now();
+        for (Money amount : amounts) {
+            CashDispenser::Notes notes;
+            if (dispenser.plan(amount, notes) == OP_OK) {
+                dispenser.dispense(notes);
+                misses = 0;
+            } else {
+                tableRejected++;
+                notes.fill(-1);
+                if (++misses == 4) {
+                    dispenser.refill(START);
+                    tableRefills++;
+                    misses = 0;
+                }
+            }
+            tablePlans.push_back(notes);
         }
-    }
-    
-    void run() {
-        showWelcome();
+        double tableNs = elapsedMs(start) * 1e6 / operations;
         
-        while (!isLoggedIn) {
-            if (!login()) {
-                if (loginAttempts >= MAX_LOGIN_ATTEMPTS) {
-                    cout << "Too many login failures, program exits." << endl;
-                    return;
+        CashDispenser::Notes counts = START;
+        size_t searchRejected = 0, searchRefills = 0;
+        misses = 0;
+        start = chrono::steady_clock::now();
+        for (Money amount : amounts) {
+            CashDispenser::Notes notes;
+            if (CashDispenser::search(amount, counts, policy, notes) == OP_OK) {
+                for (size_t i = 0; i < CASSETTE_COUNT; i++) {
+                    counts[i] -= notes[i];
                 }
-                
-                char choice;
-                cout << "\nContinue to try login? (y/n): ";
-                cin >> choice;
-                
-                if (choice != 'y' && choice != 'Y') {
-                    return;
+                misses = 0;
+            } else {
+                searchRejected++;
+                notes.fill(-1);
+                if (++misses == 4) {
+                    counts = START;
+                    searchRefills++;
+                    misses = 0;
                 }
             }
+            searchPlans.push_back(notes);
         }
+        double searchNs = elapsedMs(start) * 1e6 / operations;
         
-        int choice;
-        while (isLoggedIn) {
-            showMainMenu();
-            cin >> choice;
-            
-            switch (choice) {
-                case 1: checkBalance(); break;
-                case 2: withdraw(); break;
-                case 3: deposit(); break;
-                case 4: transfer(); break;
-                case 5: changePassword(); break;
-                case 6: displayAccountInfo(); break;
-                case 7: logout(); break;
-                default:
-                    cout << "Invalid choice, please re-enter!" << endl;
-                    break;
-            }
-            
-            if (choice != 7) {
-                cout << "\nPress any key to continue...";
-                cin.ignore();
-                cin.get();
-            }
+        printf("%-14s %-10s %7.0f %12zu %9zu\n", name, "table", tableNs, tableRejected, tableRefills);
+        printf("%-14s %-10s %7.0f %12zu %9zu\n", name, "search", searchNs, searchRejected, searchRefills);
+        if (tablePlans != searchPlans) {
+            cout << "结果不一致: " << name << endl;
         }
     }
-    
-private:
-    // 记录交易
-    void recordTransaction(const string& type, double amount, const string& targetAccount = "") {
-        // 获取当前日期和时间
-        time_t now = time(0);
-        tm* localTime = localtime(&now);
-        
-        string date = to_string(localTime->tm_year + 1900) + "-" +
-                     to_string(localTime->tm_mon + 1) + "-" +
-                     to_string(localTime->tm_mday);
-        
-        string time = to_string(localTime->tm_hour) + ":" +
-                     to_string(localTime->tm_min) + ":" +
-                     to_string(localTime->tm_sec);
-        
-        Transaction trans(currentAccount->getAccountNumber(), type, amount, date, time, targetAccount);
-        FileManager::logTransaction(trans);
+}
+
+// 读取基准测试选项后面的规模列表，推进 i 越过已读取的参数；没有给出时测 100 万和 1000 万
+vector<size_t> parseSizes(int argc, char* argv[], int& i) {
+    vector<size_t> sizes;
+    while (i + 1 < argc && isdigit(argv[i + 1][0])) {
+        sizes.push_back(strtoull(argv[++i], nullptr, 10));
     }
-};
+    if (sizes.empty()) {
+        sizes = {1000000, 10000000};
+    }
+    return sizes;
+}
 
-// ====================== 主函数 ======================
-int main() {
+int main(int argc, char* argv[]) {
     // 设置控制台为UTF-8编码（Windows）
     #ifdef _WIN32
         system("chcp 65001 > nul");
     #endif
     
-    ATM atm;
+    // --journal: 变更写预写日志，后台定期检查点
+    // --binary: 使用内存映射的二进制账户文件
+    // --lazy: 启动时只索引账户文件，账户按需加载，只写回改动过的账户
+    // --shards [n]: CSV 和日志模式改用 n 个分片账户文件（默认 16），只重写有变动的分片
+    // --convert-accounts [csv] [bin]: 将 CSV 账户文件转换为二进制格式
+    // --server [port] [workers]: 以多终端服务器模式运行
+    // --client [port]: 连接本地服务器的测试客户端
+    // --replication-port [port]: 作为主库，在该端口向备库推送账户变更和交易记录
+    // --follow [port]: 作为备库连接主库的复制端口，控制台命令 status / promote / quit，收到 SIGUSR2 也会提升
+    // --log-sync batch|interval[:ms]|none: 交易日志的 fsync 策略，默认每批 fsync
+    // --unlock <account>: 解除账户锁定
+    // --bench-table [n ...]: 账户表与 std::map 的性能对比，默认 1M 和 10M 个账户
+    // --bench-load [n ...]: 账户文件和交易文件串行与并行加载对比，默认 1M 和 10M 行
+    // --bench-index [n ...]: 身份证号和姓名二级索引与逐个扫描的查找对比，默认 1M 和 10M 个账户
+    // --bench-workload [key=value ...]: 非交互压测，见 runWorkloadBenchmark
+    // --stress-transfer [key=value ...]: 并发转账资金守恒压力测试，见 runTransferStress
+    // --log-format csv|binary: 交易日志格式，binary 写入 transactions.bin
+    // --export-log [bin] [csv]: 将二进制交易日志导出为 CSV 格式
+    // --convert-log [csv] [bin]: 将 CSV 交易文件转换为二进制日志
+    // --bench-log [n ...]: CSV 与二进制交易日志的体积和扫描耗时对比，默认 1M 和 10M 条
+    // --report [key=value ...]: 交易报表，见 runReport
+    // --bench-report [n ...]: 报表耗时对比，默认 1M 和 10M 条
+    // --reconcile [key=value ...]: 按交易日志核对账户余额、重建账户文件，见 runReconcile
+    // --bench-reconcile [n ...]: 账本核对耗时对比，默认 1M 和 10M 条
+    // --batch <ops-file> [report-file]: 批量入账，见 runBatch
+    // --eod <job> [key=value ...]: 日终作业（须放在最后），见 runEndOfDay
+    // --bench-eod [n ...]: 日终计息与逐个存入的耗时对比，默认 1M 和 10M 个账户
+    // --dispense fewest|balanced: 出钞策略，钞箱库存保存在 cassettes.dat
+    // --bench-dispense [n]: 查表与逐次枚举的出钞方案耗时对比，默认 1M 笔
+    // --metrics-file <file>: 运行指标写入该文件（Prometheus 文本格式），收到 SIGUSR1 和退出时写出
+    // --metrics-interval <seconds>: 另外每隔若干秒写一次指标文件
+    StorageMode mode = STORAGE_CSV;
+    size_t shardCount = 0;
+    string metricsFile = METRICS_FILE;
+    int metricsInterval = 0;
+    bool metricsDump = false;
+    bool serverMode = false;
+    string batchFile, batchReport;
+    vector<string> eodArgs;
+    int port = DEFAULT_SERVER_PORT;
+    int workers = DEFAULT_SERVER_WORKERS;
+    int replicationPort = 0;
+    int followPort = 0;
+    DispensePolicy dispensePolicy = DISPENSE_FEWEST_NOTES;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--journal") {
+            mode = STORAGE_JOURNAL;
+        } else if (arg == "--binary") {
+            mode = STORAGE_BINARY;
+        } else if (arg == "--lazy") {
+            mode = STORAGE_LAZY;
+        } else if (arg == "--shards") {
+            shardCount = DEFAULT_ACCOUNT_SHARDS;
+            if (i + 1 < argc && isdigit(argv[i + 1][0])) {
+                shardCount = max<size_t>(1, strtoull(argv[++i], nullptr, 10));
+            }
+        } else if (arg == "--convert-accounts") {
+            string csvFile = i + 1 < argc ? argv[i + 1] : ACCOUNTS_FILE;
+            string binaryFile = i + 2 < argc ? argv[i + 2] : ACCOUNTS_BINARY_FILE;
+            if (!MappedAccountStore::convertFromCsv(csvFile, binaryFile)) {
+                cerr << "转换失败: " << csvFile << " -> " << binaryFile << endl;
+                return 1;
+            }
+            cout << "已转换: " << csvFile << " -> " << binaryFile << endl;
+            return 0;
+        } else if (arg == "--unlock" && i + 1 < argc) {
+            string accountNumber = argv[++i];
+            if (!FileManager::unlockAccount(accountNumber)) {
+                cerr << "账户未被锁定: " << accountNumber << endl;
+                return 1;
+            }
+            cout << "已解锁: " << accountNumber << endl;
+            return 0;
+        } else if (arg == "--bench-table") {
+            runTableBenchmark(parseSizes(argc, argv, i));
+            return 0;
+        } else if (arg == "--bench-index") {
+            runIndexBenchmark(parseSizes(argc, argv, i));
+            return 0;
+        } else if (arg == "--bench-load") {
+            runLoadBenchmark(parseSizes(argc, argv, i), "atm_bench");
+            return 0;
+        } else if (arg == "--bench-log") {
+            runLogBenchmark(parseSizes(argc, argv, i), "atm_bench");
+            return 0;
+        } else if (arg == "--log-format" && i + 1 < argc) {
+            string format = argv[++i];
+            FileManager::setTransactionLogFormat(format == "binary" ? LOG_FORMAT_BINARY : LOG_FORMAT_CSV);
+        } else if (arg == "--export-log") {
+            string binaryFile = i + 1 < argc ? argv[i + 1] : TRANSACTIONS_BINARY_FILE;
+            string csvFile = i + 2 < argc ? argv[i + 2] : TRANSACTIONS_FILE;
+            if (!TransactionLogReader::exportToCsv(binaryFile, csvFile)) {
+                cerr << "导出失败: " << binaryFile << " -> " << csvFile << endl;
+                return 1;
+            }
+            cout << "已导出: " << binaryFile << " -> " << csvFile << endl;
+            return 0;
+        } else if (arg == "--convert-log") {
+            string csvFile = i + 1 < argc ? argv[i + 1] : TRANSACTIONS_FILE;
+            string binaryFile = i + 2 < argc ? argv[i + 2] : TRANSACTIONS_BINARY_FILE;
+            size_t skipped = 0;
+            if (!TransactionLogReader::convertFromCsv(csvFile, binaryFile, skipped)) {
+                cerr << "转换失败: " << csvFile << " -> " << binaryFile << endl;
+                return 1;
+            }
+            cout << "已转换: " << csvFile << " -> " << binaryFile;
+            if (skipped > 0) {
+                cout << "（跳过 " << skipped << " 条无法解析的记录）";
+            }
+            cout << endl;
+            return 0;
+        } else if (arg == "--report") {
+            return runReport(vector<string>(argv + i + 1, argv + argc));
+        } else if (arg == "--bench-report") {
+            runReportBenchmark(parseSizes(argc, argv, i), "atm_bench");
+            return 0;
+        } else if (arg == "--reconcile") {
+            return runReconcile(vector<string>(argv + i + 1, argv + argc));
+        } else if (arg == "--bench-reconcile") {
+            runReconcileBenchmark(parseSizes(argc, argv, i), "atm_bench");
+            return 0;
+        } else if (arg == "--bench-workload") {
+            return runWorkloadBenchmark(vector<string>(argv + i + 1, argv + argc));
+        } else if (arg == "--stress-transfer") {
+            return runTransferStress(vector<string>(argv + i + 1, argv + argc));
+        } else if (arg == "--eod") {
+            eodArgs.assign(argv + i + 1, argv + argc);
+            if (eodArgs.empty()) {
+                eodArgs.push_back("");
+            }
+            break;
+        } else if (arg == "--bench-eod") {
+            runEodBenchmark(parseSizes(argc, argv, i), "atm_bench");
+            return 0;
+        } else if (arg == "--dispense" && i + 1 < argc) {
+            string policy = argv[++i];
+            if (policy != "fewest" && policy != "balanced") {
+                cerr << "出钞策略只能是 fewest 或 balanced: " << policy << endl;
+                return 1;
+            }
+            dispensePolicy = policy == "balanced" ? DISPENSE_BALANCED : DISPENSE_FEWEST_NOTES;
+        } else if (arg == "--bench-dispense") {
+            size_t operations = 1000000;
+            if (i + 1 < argc && isdigit(argv[i + 1][0])) {
+                operations = strtoull(argv[++i], nullptr, 10);
+            }
+            runDispenseBenchmark(operations);
+            return 0;
+        } else if (arg == "--batch" && i + 1 < argc) {
+            batchFile = argv[++i];
+            batchReport = i + 1 < argc && argv[i + 1][0] != '-' ? argv[++i] : batchFile + ".report";
+        } else if (arg == "--metrics-file" && i + 1 < argc) {
+            metricsFile = argv[++i];
+            metricsDump = true;
+        } else if (arg == "--metrics-interval" && i + 1 < argc) {
+            metricsInterval = atoi(argv[++i]);
+            metricsDump = true;
+        } else if (arg == "--log-sync" && i + 1 < argc) {
+            string policy = argv[++i];
+            if (policy == "none") {
+                FileManager::setTransactionLogPolicy(DURABILITY_NONE);
+            } else if (policy.compare(0, 8, "interval") == 0) {
+                int intervalMs = policy.size() > 9 ? atoi(policy.c_str() + 9) : DEFAULT_LOG_SYNC_INTERVAL_MS;
+                FileManager::setTransactionLogPolicy(DURABILITY_INTERVAL, intervalMs);
+            } else {
+                FileManager::setTransactionLogPolicy(DURABILITY_BATCH);
+            }
+        } else if (arg == "--replication-port" || arg == "--follow") {
+            int value = DEFAULT_REPLICATION_PORT;
+            if (i + 1 < argc && isdigit(argv[i + 1][0])) {
+                value = atoi(argv[++i]);
+            }
+            (arg == "--follow" ? followPort : replicationPort) = value;
+        } else if (arg == "--server" || arg == "--client") {
+            if (i + 1 < argc && isdigit(argv[i + 1][0])) {
+                port = atoi(argv[++i]);
+            }
+            if (arg == "--server" && i + 1 < argc && isdigit(argv[i + 1][0])) {
+                workers = atoi(argv[++i]);
+            }
+            if (arg == "--client") {
+#ifndef _WIN32
+                return runClient(port);
+#else
+                cerr << "客户端模式仅支持 POSIX 系统" << endl;
+                return 1;
+#endif
+            }
+            serverMode = true;
+        }
+    }
+    
+    // 在 Bank 之前启动、之后停止，析构时的保存也计入最后一次输出
+    MetricsDumper metricsDumper;
+    if (metricsDump) {
+        metricsDumper.start(metricsFile, metricsInterval);
+    }
     
     try {
+        Bank bank(mode, shardCount);
+        
+#ifndef _WIN32
+        if ((replicationPort > 0 || followPort > 0) && !bank.supportsReplication()) {
+            cerr << "复制仅支持 CSV、日志和内存模式" << endl;
+            return 1;
+        }
+        if (followPort > 0 && !runFollower(bank, followPort)) {
+            return 0;
+        }
+        
+        // 在 Bank 之后构造、之前析构，停止时先断开备库
+        ReplicationStream replicationStream;
+        ReplicationServer replicationServer(bank, replicationStream, replicationPort);
+        if (replicationPort > 0 && !replicationServer.start()) {
+            cerr << "无法监听复制端口 " << replicationPort << endl;
+            return 1;
+        }
+#else
+        if (replicationPort > 0 || followPort > 0) {
+            cerr << "复制仅支持 POSIX 系统" << endl;
+            return 1;
+        }
+#endif
+        
+        if (!eodArgs.empty()) {
+            return runEndOfDay(bank, eodArgs);
+        }
+        
+        if (!batchFile.empty()) {
+            size_t applied = 0, rejected = 0;
+            auto start = chrono::steady_clock::now();
+            if (!runBatch(bank, batchFile, batchReport, applied, rejected)) {
+                cerr << "批处理失败: " << batchFile << " -> " << batchReport << endl;
+                return 1;
+            }
+            cout << "批处理完成: 成功 " << applied << " 条, 拒绝 " << rejected << " 条, 耗时 "
+                 << (long long)elapsedMs(start) << " ms, 报告 " << batchReport << endl;
+            return 0;
+        }
+        
+        if (serverMode) {
+#ifndef _WIN32
+            ATMServer server(bank, port, workers);
+            if (!server.run()) {
+                cerr << "无法监听端口 " << port << endl;
+                return 1;
+            }
+            return 0;
+#else
+            cerr << "服务器模式仅支持 POSIX 系统" << endl;
+            return 1;
+#endif
+        }
+        
+        ATM atm(bank, metricsFile, dispensePolicy);
         atm.run();
     } catch (const exception& e) {
         cerr << "发生错误: " << e.what() << endl;
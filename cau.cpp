@@ -8,8 +8,349 @@
 #include <vector>
 #include <string.h>
 #include <sstream>
+#include <algorithm>
+#include <thread>
+#include <chrono>
+#include <random>
+#include <atomic>
+#include <climits>
+#include <cstdint>
 using namespace std;
 
+const int PARALLEL_SORT_MIN = 1 << 16; //元素数不少于此值且有多个CPU核时分段并行排序
+
+class BigInt //任意精度整数：符号加绝对值，绝对值按2^32进制存放，低位在前，没有多余的高位0
+{
+public:
+    typedef vector<unsigned int> Digits;
+    friend BigInt operator+(const BigInt& a, const BigInt& b); //重载+运算符
+    friend BigInt operator-(const BigInt& a, const BigInt& b); //重载-运算符
+    friend BigInt operator*(const BigInt& a, const BigInt& b); //重载*运算符
+    friend BigInt operator/(const BigInt& a, const BigInt& b); //重载/运算符，向零取整
+    friend BigInt operator%(const BigInt& a, const BigInt& b); //重载%运算符，余数与被除数同号
+    friend int compareBigInt(const BigInt& a, const BigInt& b); //比较，小于、等于、大于分别返回-1、0、1
+    friend BigInt gcdBigInt(BigInt a, BigInt b);               //最大公约数，结果非负
+    BigInt();                                                   //无参构造函数，值为0
+    BigInt(long long v);                                        //由long long构造
+    bool isZero() const;                                        //是否为0
+    bool isNegative() const;                                    //是否为负数
+    bool fitsLongLong() const;                                  //绝对值不超过LLONG_MAX
+    long long toLongLong() const;                               //转为long long，fitsLongLong()为真时有效
+    BigInt operator-() const;                                   //取相反数
+    string toString() const;                                    //十进制字符串
+private:
+    bool negative;
+    Digits mag;
+    static void trim(Digits& d);                                        //去掉高位的0
+    static BigInt make(bool negative, Digits mag);                      //由符号和绝对值构造，0不带负号
+    static int compareMag(const Digits& a, const Digits& b);            //比较绝对值
+    static Digits addMag(const Digits& a, const Digits& b);             //绝对值相加
+    static Digits subMag(const Digits& a, const Digits& b);             //绝对值相减，要求a>=b
+    static Digits mulMag(const Digits& a, const Digits& b);             //绝对值相乘
+    static void divModMag(const Digits& a, const Digits& b, Digits& q, Digits& r); //绝对值相除，b不为0
+};
+
+BigInt::BigInt() //无参构造函数，值为0
+{
+    negative = false;
+}
+
+BigInt::BigInt(long long v) //由long long构造
+{
+    negative = v < 0;
+    unsigned long long m = negative ? 0ULL - (unsigned long long)v : (unsigned long long)v;
+    while (m != 0)
+    {
+        mag.push_back((unsigned int)m);
+        m >>= 32;
+    }
+}
+
+bool BigInt::isZero() const //是否为0
+{
+    return mag.empty();
+}
+bool BigInt::isNegative() const //是否为负数
+{
+    return negative;
+}
+bool BigInt::fitsLongLong() const //绝对值不超过LLONG_MAX
+{
+    return mag.size() <= 1 || (mag.size() == 2 && mag[1] < 0x80000000u);
+}
+long long BigInt::toLongLong() const //转为long long，fitsLongLong()为真时有效
+{
+    unsigned long long m = 0;
+    for (size_t i = mag.size(); i-- > 0;)
+    {
+        m = m << 32 | mag[i];
+    }
+    return negative ? -(long long)m : (long long)m;
+}
+BigInt BigInt::operator-() const //取相反数
+{
+    return make(!negative, mag);
+}
+string BigInt::toString() const //十进制字符串：反复除以10^9，每次得到9位
+{
+    if (mag.empty())
+    {
+        return "0";
+    }
+    Digits rest = mag;
+    vector<unsigned int> groups;
+    while (!rest.empty())
+    {
+        unsigned long long rem = 0;
+        for (size_t i = rest.size(); i-- > 0;)
+        {
+            unsigned long long cur = rem << 32 | rest[i];
+            rest[i] = (unsigned int)(cur / 1000000000);
+            rem = cur % 1000000000;
+        }
+        trim(rest);
+        groups.push_back((unsigned int)rem);
+    }
+    string text = negative ? "-" : "";
+    text += to_string(groups.back());
+    for (size_t i = groups.size() - 1; i-- > 0;)
+    {
+        char buffer[16];
+        snprintf(buffer, sizeof(buffer), "%09u", groups[i]);
+        text += buffer;
+    }
+    return text;
+}
+void BigInt::trim(Digits& d) //去掉高位的0
+{
+    while (!d.empty() && d.back() == 0)
+    {
+        d.pop_back();
+    }
+}
+BigInt BigInt::make(bool negative, Digits mag) //由符号和绝对值构造，0不带负号
+{
+    BigInt result;
+    trim(mag);
+    result.negative = negative && !mag.empty();
+    result.mag.swap(mag);
+    return result;
+}
+int BigInt::compareMag(const Digits& a, const Digits& b) //比较绝对值
+{
+    if (a.size() != b.size())
+    {
+        return a.size() < b.size() ? -1 : 1;
+    }
+    for (size_t i = a.size(); i-- > 0;)
+    {
+        if (a[i] != b[i])
+        {
+            return a[i] < b[i] ? -1 : 1;
+        }
+    }
+    return 0;
+}
+BigInt::Digits BigInt::addMag(const Digits& a, const Digits& b) //绝对值相加
+{
+    const Digits& longer = a.size() >= b.size() ? a : b;
+    const Digits& shorter = a.size() >= b.size() ? b : a;
+    Digits sum(longer.size() + 1);
+    unsigned long long carry = 0;
+    for (size_t i = 0; i < longer.size(); i++)
+    {
+        carry += (unsigned long long)longer[i] + (i < shorter.size() ? shorter[i] : 0);
+        sum[i] = (unsigned int)carry;
+        carry >>= 32;
+    }
+    sum[longer.size()] = (unsigned int)carry;
+    trim(sum);
+    return sum;
+}
+BigInt::Digits BigInt::subMag(const Digits& a, const Digits& b) //绝对值相减，要求a>=b
+{
+    Digits diff(a.size());
+    long long borrow = 0;
+    for (size_t i = 0; i < a.size(); i++)
+    {
+        long long t = (long long)a[i] - (i < b.size() ? b[i] : 0) - borrow;
+        borrow = t < 0;
+        diff[i] = (unsigned int)(t + (borrow << 32));
+    }
+    trim(diff);
+    return diff;
+}
+BigInt::Digits BigInt::mulMag(const Digits& a, const Digits& b) //绝对值相乘(竖式乘法)
+{
+    if (a.empty() || b.empty())
+    {
+        return Digits();
+    }
+    Digits product(a.size() + b.size());
+    for (size_t i = 0; i < a.size(); i++)
+    {
+        unsigned long long carry = 0;
+        for (size_t j = 0; j < b.size(); j++)
+        {
+            unsigned long long t = (unsigned long long)a[i] * b[j] + product[i + j] + carry;
+            product[i + j] = (unsigned int)t;
+            carry = t >> 32;
+        }
+        product[i + b.size()] = (unsigned int)carry;
+    }
+    trim(product);
+    return product;
+}
+void BigInt::divModMag(const Digits& a, const Digits& b, Digits& q, Digits& r) //绝对值相除(Knuth算法D)，b不为0
+{
+    if (compareMag(a, b) < 0)
+    {
+        q.clear();
+        r = a;
+        return;
+    }
+    if (b.size() == 1) //除数只有一位时逐位相除
+    {
+        q.assign(a.size(), 0);
+        unsigned long long rem = 0;
+        for (size_t i = a.size(); i-- > 0;)
+        {
+            unsigned long long cur = rem << 32 | a[i];
+            q[i] = (unsigned int)(cur / b[0]);
+            rem = cur % b[0];
+        }
+        trim(q);
+        r.clear();
+        if (rem != 0)
+        {
+            r.push_back((unsigned int)rem);
+        }
+        return;
+    }
+    //左移使除数最高位为1，这样每位试商最多偏大2
+    int s = __builtin_clz(b.back());
+    size_t n = b.size(), m = a.size() - n;
+    Digits vn(n), un(a.size() + 1);
+    for (size_t i = n - 1; i > 0; i--)
+    {
+        vn[i] = (b[i] << s) | (unsigned int)((unsigned long long)b[i - 1] >> (32 - s));
+    }
+    vn[0] = b[0] << s;
+    un[a.size()] = (unsigned int)((unsigned long long)a.back() >> (32 - s));
+    for (size_t i = a.size() - 1; i > 0; i--)
+    {
+        un[i] = (a[i] << s) | (unsigned int)((unsigned long long)a[i - 1] >> (32 - s));
+    }
+    un[0] = a[0] << s;
+
+    const unsigned long long base = 1ULL << 32;
+    q.assign(m + 1, 0);
+    for (size_t j = m + 1; j-- > 0;)
+    {
+        unsigned long long num = (unsigned long long)un[j + n] << 32 | un[j + n - 1];
+        unsigned long long qhat = num / vn[n - 1], rhat = num % vn[n - 1];
+        while (qhat >= base || qhat * vn[n - 2] > (rhat << 32 | un[j + n - 2]))
+        {
+            qhat--;
+            rhat += vn[n - 1];
+            if (rhat >= base)
+            {
+                break;
+            }
+        }
+        long long k = 0, t;
+        for (size_t i = 0; i < n; i++) //减去qhat倍的除数
+        {
+            unsigned long long p = qhat * vn[i];
+            t = (long long)un[i + j] - k - (long long)(p & 0xFFFFFFFFULL);
+            un[i + j] = (unsigned int)t;
+            k = (long long)(p >> 32) - (t >> 32);
+        }
+        t = (long long)un[j + n] - k;
+        un[j + n] = (unsigned int)t;
+        q[j] = (unsigned int)qhat;
+        if (t < 0) //试商偏大1，加回一倍除数
+        {
+            q[j]--;
+            unsigned long long carry = 0;
+            for (size_t i = 0; i < n; i++)
+            {
+                carry += (unsigned long long)un[i + j] + vn[i];
+                un[i + j] = (unsigned int)carry;
+                carry >>= 32;
+            }
+            un[j + n] += (unsigned int)carry;
+        }
+    }
+    r.assign(n, 0);
+    for (size_t i = 0; i < n; i++)
+    {
+        r[i] = (un[i] >> s) | (unsigned int)((unsigned long long)un[i + 1] << (32 - s));
+    }
+    trim(q);
+    trim(r);
+}
+BigInt operator+(const BigInt& a, const BigInt& b) //重载+运算符
+{
+    if (a.negative == b.negative)
+    {
+        return BigInt::make(a.negative, BigInt::addMag(a.mag, b.mag));
+    }
+    if (BigInt::compareMag(a.mag, b.mag) >= 0)
+    {
+        return BigInt::make(a.negative, BigInt::subMag(a.mag, b.mag));
+    }
+    return BigInt::make(b.negative, BigInt::subMag(b.mag, a.mag));
+}
+BigInt operator-(const BigInt& a, const BigInt& b) //重载-运算符
+{
+    return a + (-b);
+}
+BigInt operator*(const BigInt& a, const BigInt& b) //重载*运算符
+{
+    return BigInt::make(a.negative != b.negative, BigInt::mulMag(a.mag, b.mag));
+}
+BigInt operator/(const BigInt& a, const BigInt& b) //重载/运算符，向零取整
+{
+    BigInt::Digits q, r;
+    BigInt::divModMag(a.mag, b.mag, q, r);
+    return BigInt::make(a.negative != b.negative, q);
+}
+BigInt operator%(const BigInt& a, const BigInt& b) //重载%运算符，余数与被除数同号
+{
+    BigInt::Digits q, r;
+    BigInt::divModMag(a.mag, b.mag, q, r);
+    return BigInt::make(a.negative, r);
+}
+int compareBigInt(const BigInt& a, const BigInt& b) //比较，小于、等于、大于分别返回-1、0、1
+{
+    if (a.negative != b.negative)
+    {
+        return a.negative ? -1 : 1;
+    }
+    int result = BigInt::compareMag(a.mag, b.mag);
+    return a.negative ? -result : result;
+}
+BigInt gcdBigInt(BigInt a, BigInt b) //最大公约数(辗转相除)，结果非负
+{
+    a.negative = false;
+    b.negative = false;
+    while (!b.isZero())
+    {
+        BigInt r = a % b;
+        a = b;
+        b = r;
+    }
+    return a;
+}
+
+struct BigFraction //大数形式的分数，多个Fraction共享同一份只读数据
+{
+    atomic<int> refs; //引用计数
+    BigInt numer;     //分子
+    BigInt deno;      //分母，恒为正
+};
+
 class Fraction
 {
 public:
@@ -24,132 +365,391 @@ public:
     friend istream& operator>>(istream& in, Fraction& frac);                 //重载>>运算符
     friend void sortFraction1(Fraction* frac, int n);                        //对分数数组升序排序
     friend void sortFraction2(Fraction* frac, int n);                        //对分数数组降序排序
+    friend int compareFraction(const Fraction& frac1, const Fraction& frac2); //比较两个分数
     Fraction();                                                              //无参构造函数
-    Fraction(int n, int d);                                                  //带参构造函数
-    Fraction(const Fraction& f);                                             //复制构造函数
-    void setFraction(int n, int d);                                          //设置分数的分子和分母
-    int getNumer();                                                          //获取分数的分子
-    int getDeno();                                                           //获取分数的分母
+    Fraction(long long n, long long d);                                      //带参构造函数
+    Fraction(const Fraction& f);                                             //复制构造函数(大数形式只增加引用计数)
+    Fraction(Fraction&& f) noexcept;                                         //移动构造函数
+    ~Fraction();                                                             //析构函数
+    Fraction& operator=(const Fraction& f);                                  //复制赋值
+    Fraction& operator=(Fraction&& f) noexcept;                              //移动赋值
+    void setFraction(long long n, long long d);                              //设置分数的分子和分母
+    long long getNumer();                                                    //获取分数的分子(仅小值形式有效)
+    long long getDeno();                                                     //获取分数的分母(仅小值形式有效)
+    bool isBig() const;                                                      //分子或分母超出long long时为大数形式
+    BigInt getBigNumer() const;                                              //获取分数的分子(任意形式)
+    BigInt getBigDeno() const;                                               //获取分数的分母(任意形式)
     void RdcFrc();                                                           //当前分数约分
+    static long long bigAllocations();                                       //累计创建的大数形式个数
 private:
-    int numer; //分子
-    int deno;  //分母    
+    //小值形式：已约分，分母>0(分母为0表示除以零，分子为-1、0或1)，分子不为LLONG_MIN，取负不会溢出
+    //大数形式：分母为-1，分子中存放指向BigFraction的指针
+    long long numer; //分子
+    long long deno;  //分母
+    static atomic<long long> bigCount;
+    BigFraction* big() const;                                                //大数形式的数据
+    void release();                                                          //释放大数形式的数据
+    void assign(long long n, long long d);                                   //设置为n/d并约分，取负会溢出时转为大数形式
+    void assignBig(BigInt n, BigInt d);                                      //设置为n/d并约分，能放进long long时转回小值形式
+    static Fraction fromBig(const BigInt& n, const BigInt& d);               //由大数分子分母构造
+    static unsigned long long gcd(unsigned long long a, unsigned long long b); //最大公约数(二进制算法)
 };
 
+atomic<long long> Fraction::bigCount(0);
+
 Fraction::Fraction() //无参构造函数
 {
     numer = 0;
     deno = 1;
 }
 
-Fraction::Fraction(int n, int d) //带参构造函数
+Fraction::Fraction(long long n, long long d) //带参构造函数
+{
+    deno = 1;
+    assign(n, d);
+}
+
+Fraction::Fraction(const Fraction& f) //复制构造函数(大数形式只增加引用计数)
 {
-    numer = n;
-    deno = d;
-    RdcFrc();
+    numer = f.numer;
+    deno = f.deno;
+    if (deno < 0)
+    {
+        big()->refs++;
+    }
 }
 
-Fraction::Fraction(const Fraction& f) //复制构造函数
+Fraction::Fraction(Fraction&& f) noexcept //移动构造函数
 {
     numer = f.numer;
     deno = f.deno;
+    f.numer = 0;
+    f.deno = 1;
 }
 
-void Fraction::setFraction(int n, int d) //设置分数的分子和分母
+Fraction::~Fraction() //析构函数
 {
-    numer = n;
-    deno = d;
-    RdcFrc();
+    release();
 }
 
-int Fraction::getNumer() //获取分数的分子
+Fraction& Fraction::operator=(const Fraction& f) //复制赋值
+{
+    if (this != &f)
+    {
+        if (f.deno < 0)
+        {
+            f.big()->refs++;
+        }
+        release();
+        numer = f.numer;
+        deno = f.deno;
+    }
+    return *this;
+}
+
+Fraction& Fraction::operator=(Fraction&& f) noexcept //移动赋值
+{
+    if (this != &f)
+    {
+        release();
+        numer = f.numer;
+        deno = f.deno;
+        f.numer = 0;
+        f.deno = 1;
+    }
+    return *this;
+}
+
+void Fraction::setFraction(long long n, long long d) //设置分数的分子和分母
+{
+    assign(n, d);
+}
+
+long long Fraction::getNumer() //获取分数的分子(仅小值形式有效)
 {
     return numer;
 }
-int Fraction::getDeno() //获取分数的分母
+long long Fraction::getDeno() //获取分数的分母(仅小值形式有效)
 {
     return deno;
 }
-void Fraction::RdcFrc() //当前分数约分
+bool Fraction::isBig() const //分子或分母超出long long时为大数形式
 {
-    int a = numer, b = deno;
-    while (b != 0)
+    return deno < 0;
+}
+BigInt Fraction::getBigNumer() const //获取分数的分子(任意形式)
+{
+    return deno < 0 ? big()->numer : BigInt(numer);
+}
+BigInt Fraction::getBigDeno() const //获取分数的分母(任意形式)
+{
+    return deno < 0 ? big()->deno : BigInt(deno);
+}
+void Fraction::RdcFrc() //当前分数约分(构造和运算的结果都已约分，这里只为保持接口)
+{
+    if (deno >= 0)
     {
-        int t = a % b;
-        a = b;
-        b = t;
+        assign(numer, deno);
     }
-    numer /= a;
-    deno /= a;
 }
+long long Fraction::bigAllocations() //累计创建的大数形式个数
+{
+    return bigCount;
+}
+BigFraction* Fraction::big() const //大数形式的数据
+{
+    return reinterpret_cast<BigFraction*>((intptr_t)numer);
+}
+void Fraction::release() //释放大数形式的数据
+{
+    if (deno < 0 && --big()->refs == 0)
+    {
+        delete big();
+    }
+    numer = 0;
+    deno = 1;
+}
+unsigned long long Fraction::gcd(unsigned long long a, unsigned long long b) //最大公约数(二进制算法)
+{
+    if (a == 0 || b == 0)
+    {
+        return a | b;
+    }
+    int shift = __builtin_ctzll(a | b);
+    a >>= __builtin_ctzll(a);
+    while (b != 0) //min/max编译为条件传送，循环内没有难预测的分支
+    {
+        b >>= __builtin_ctzll(b);
+        unsigned long long low = min(a, b);
+        b = max(a, b) - low;
+        a = low;
+    }
+    return a << shift;
+}
+void Fraction::assign(long long n, long long d) //设置为n/d并约分，取负会溢出时转为大数形式
+{
+    if (n == LLONG_MIN || d == LLONG_MIN)
+    {
+        assignBig(BigInt(n), BigInt(d));
+        return;
+    }
+    release();
+    if (d < 0)
+    {
+        n = -n;
+        d = -d;
+    }
+    if (d == 0)
+    {
+        numer = (n > 0) - (n < 0);
+        deno = 0;
+        return;
+    }
+    long long g = (long long)gcd(n < 0 ? -n : n, d); //n为0时g为d，结果为0/1
+    numer = n / g;
+    deno = d / g;
+}
+void Fraction::assignBig(BigInt n, BigInt d) //设置为n/d并约分，能放进long long时转回小值形式
+{
+    if (d.isNegative())
+    {
+        n = -n;
+        d = -d;
+    }
+    if (d.isZero())
+    {
+        assign(n.isZero() ? 0 : (n.isNegative() ? -1 : 1), 0);
+        return;
+    }
+    BigInt g = gcdBigInt(n, d);
+    if (compareBigInt(g, BigInt(1)) != 0)
+    {
+        n = n / g;
+        d = d / g;
+    }
+    if (n.fitsLongLong() && d.fitsLongLong())
+    {
+        assign(n.toLongLong(), d.toLongLong());
+        return;
+    }
+    release();
+    BigFraction* value = new BigFraction();
+    value->refs = 1;
+    value->numer = n;
+    value->deno = d;
+    bigCount++;
+    numer = (long long)reinterpret_cast<intptr_t>(value);
+    deno = -1;
+}
+Fraction Fraction::fromBig(const BigInt& n, const BigInt& d) //由大数分子分母构造
+{
+    Fraction result;
+    result.assignBig(n, d);
+    return result;
+}
+//四则运算：两个都是小值形式时直接用long long计算，各步溢出标志按位或在一起，只在最后判断一次；
+//溢出或有大数形式时改用BigInt计算，结果能放进long long时仍回到小值形式
 Fraction operator+(const Fraction& frac1, const Fraction& frac2) //重载+运算符
 {
-    return Fraction(frac1.numer * frac2.deno + frac2.numer * frac1.deno, frac1.deno * frac2.deno);
+    if ((frac1.deno | frac2.deno) >= 0)
+    {
+        long long x, y, n, d;
+        bool overflow = __builtin_mul_overflow(frac1.numer, frac2.deno, &x) |
+                        __builtin_mul_overflow(frac2.numer, frac1.deno, &y) |
+                        __builtin_add_overflow(x, y, &n) |
+                        __builtin_mul_overflow(frac1.deno, frac2.deno, &d);
+        if (!overflow)
+        {
+            return Fraction(n, d);
+        }
+    }
+    return Fraction::fromBig(frac1.getBigNumer() * frac2.getBigDeno() + frac2.getBigNumer() * frac1.getBigDeno(),
+                             frac1.getBigDeno() * frac2.getBigDeno());
 }
 Fraction operator-(const Fraction& frac1, const Fraction& frac2) //重载-运算符
 {
-    return Fraction(frac1.numer * frac2.deno - frac2.numer * frac1.deno, frac1.deno * frac2.deno);
+    if ((frac1.deno | frac2.deno) >= 0)
+    {
+        long long x, y, n, d;
+        bool overflow = __builtin_mul_overflow(frac1.numer, frac2.deno, &x) |
+                        __builtin_mul_overflow(frac2.numer, frac1.deno, &y) |
+                        __builtin_sub_overflow(x, y, &n) |
+                        __builtin_mul_overflow(frac1.deno, frac2.deno, &d);
+        if (!overflow)
+        {
+            return Fraction(n, d);
+        }
+    }
+    return Fraction::fromBig(frac1.getBigNumer() * frac2.getBigDeno() - frac2.getBigNumer() * frac1.getBigDeno(),
+                             frac1.getBigDeno() * frac2.getBigDeno());
 }
 Fraction operator*(const Fraction& frac1, const Fraction& frac2) //重载*运算符
 {
-    return Fraction(frac1.numer * frac2.numer, frac1.deno * frac2.deno);
+    if ((frac1.deno | frac2.deno) >= 0)
+    {
+        long long n, d;
+        bool overflow = __builtin_mul_overflow(frac1.numer, frac2.numer, &n) |
+                        __builtin_mul_overflow(frac1.deno, frac2.deno, &d);
+        if (!overflow)
+        {
+            return Fraction(n, d);
+        }
+    }
+    return Fraction::fromBig(frac1.getBigNumer() * frac2.getBigNumer(), frac1.getBigDeno() * frac2.getBigDeno());
 }
 Fraction operator/(const Fraction& frac1, const Fraction& frac2) //重载/运算符
 {
-    return Fraction(frac1.numer * frac2.deno, frac1.deno * frac2.numer);
+    if ((frac1.deno | frac2.deno) >= 0)
+    {
+        long long n, d;
+        bool overflow = __builtin_mul_overflow(frac1.numer, frac2.deno, &n) |
+                        __builtin_mul_overflow(frac1.deno, frac2.numer, &d);
+        if (!overflow)
+        {
+            return Fraction(n, d);
+        }
+    }
+    return Fraction::fromBig(frac1.getBigNumer() * frac2.getBigDeno(), frac1.getBigDeno() * frac2.getBigNumer());
+}
+int compareFraction(const Fraction& frac1, const Fraction& frac2) //比较两个分数，小于、等于、大于分别返回-1、0、1
+{
+    //分母恒为非负；两个long long的积用128位整数保存不会溢出
+    if ((frac1.deno | frac2.deno) >= 0)
+    {
+        __int128 left = (__int128)frac1.numer * frac2.deno;
+        __int128 right = (__int128)frac2.numer * frac1.deno;
+        return (left > right) - (left < right);
+    }
+    return compareBigInt(frac1.getBigNumer() * frac2.getBigDeno(), frac2.getBigNumer() * frac1.getBigDeno());
 }
 bool operator==(Fraction frac1, Fraction frac2) //重载==运算符
 {
-    return frac1.numer * frac2.deno == frac2.numer * frac1.deno;
+    return compareFraction(frac1, frac2) == 0;
 }
 bool operator>(const Fraction& frac1, const Fraction& frac2) //重载>运算符
 {
-    return frac1.numer * frac2.deno > frac2.numer * frac1.deno;
+    return compareFraction(frac1, frac2) > 0;
 }
 bool operator<(const Fraction& frac1, const Fraction& frac2) //重载<运算符
 {
-    return frac1.numer * frac2.deno < frac2.numer * frac1.deno;
+    return compareFraction(frac1, frac2) < 0;
 }
 ostream& operator<<(ostream& out, const Fraction& frac) //重载<<运算符
 {
-    out << frac.numer << "/" << frac.deno;
+    if (frac.isBig())
+    {
+        out << frac.big()->numer.toString() << "/" << frac.big()->deno.toString();
+    }
+    else
+    {
+        out << frac.numer << "/" << frac.deno;
+    }
     return out;
 }
 istream& operator>>(istream& in, Fraction& frac) //重载>>运算符
 {
-    in >> frac.numer >> frac.deno;
-    frac.RdcFrc();
+    long long n, d;
+    if (in >> n >> d)
+    {
+        frac.setFraction(n, d);
+    }
     return in;
 }
-void sortFraction1(Fraction* frac, int n) //对分数数组升序排序
+bool fractionLess(const Fraction& frac1, const Fraction& frac2) //升序比较
 {
-    for (int i = 0; i < n - 1; i++)
+    return compareFraction(frac1, frac2) < 0;
+}
+bool fractionGreater(const Fraction& frac1, const Fraction& frac2) //降序比较
+{
+    return compareFraction(frac1, frac2) > 0;
+}
+void sortFractions(Fraction* frac, int n, bool (*comp)(const Fraction&, const Fraction&)) //稳定排序，相等的分数保持原顺序
+{
+    int parts = (int)thread::hardware_concurrency();
+    if (n < PARALLEL_SORT_MIN || parts <= 1)
     {
-        for (int j = 0; j < n - i - 1; j++)
+        stable_sort(frac, frac + n, comp);
+        return;
+    }
+    //分成parts段各自排序，再逐轮两两归并；前一段的元素在相等时排在前面，整体仍是稳定的
+    parts = min(parts, n / (PARALLEL_SORT_MIN / 2));
+    vector<int> bounds(parts + 1);
+    for (int i = 0; i <= parts; i++)
+    {
+        bounds[i] = (int)((long long)n * i / parts);
+    }
+    vector<thread> workers;
+    for (int i = 0; i < parts; i++)
+    {
+        workers.emplace_back([=]() { stable_sort(frac + bounds[i], frac + bounds[i + 1], comp); });
+    }
+    for (size_t i = 0; i < workers.size(); i++)
+    {
+        workers[i].join();
+    }
+    for (int width = 1; width < parts; width *= 2)
+    {
+        workers.clear();
+        for (int i = 0; i + width < parts; i += 2 * width)
         {
-            if (frac[j] > frac[j + 1])
-            {
-                Fraction temp = frac[j];
-                frac[j] = frac[j + 1];
-                frac[j + 1] = temp;
-            }
+            Fraction* first = frac + bounds[i];
+            Fraction* middle = frac + bounds[i + width];
+            Fraction* last = frac + bounds[min(i + 2 * width, parts)];
+            workers.emplace_back([=]() { inplace_merge(first, middle, last, comp); });
+        }
+        for (size_t i = 0; i < workers.size(); i++)
+        {
+            workers[i].join();
         }
     }
 }
+void sortFraction1(Fraction* frac, int n) //对分数数组升序排序
+{
+    sortFractions(frac, n, fractionLess);
+}
 void sortFraction2(Fraction* frac, int n) //对分数数组降序排序
 {
-    for (int i = 0; i < n - 1; i++)
-    {
-        for (int j = 0; j < n - i - 1; j++)
-        {
-            if (frac[j] < frac[j + 1])
-            {
-                Fraction temp = frac[j];
-                frac[j] = frac[j + 1];
-                frac[j + 1] = temp;
-            }
-        }
-    }
+    sortFractions(frac, n, fractionGreater);
 }
 vector<string> split(string& str, const string& delim)
 {
@@ -176,13 +776,162 @@ vector<string> split(string& str, const string& delim)
     return res;
 }
 
+void bubbleSortFraction(Fraction* frac, int n) //冒泡排序，仅作为性能测试的对照
+{
+    for (int i = 0; i < n - 1; i++)
+    {
+        for (int j = 0; j < n - i - 1; j++)
+        {
+            if (frac[j] > frac[j + 1])
+            {
+                swap(frac[j], frac[j + 1]);
+            }
+        }
+    }
+}
+
+double elapsedMs(chrono::steady_clock::time_point start) //距start经过的毫秒数
+{
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+void fillRandomFractions(vector<Fraction>& frac, long long n) //生成n个随机分数，种子固定，每次结果相同
+{
+    //分子、分母取接近int上限的随机数，旧的int交叉相乘在这里会溢出
+    mt19937 rng(1);
+    uniform_int_distribution<int> numerDist(-2000000000, 2000000000);
+    uniform_int_distribution<int> denoDist(1, 2000000000);
+    frac.resize(n);
+    for (long long i = 0; i < n; i++)
+    {
+        int numer = numerDist(rng);
+        frac[i].setFraction(numer, denoDist(rng));
+    }
+}
+
+unsigned long long orderHash(vector<Fraction>& frac) //与顺序相关的校验值，用于比较两次排序结果
+{
+    unsigned long long hash = 0;
+    for (size_t i = 0; i < frac.size(); i++)
+    {
+        hash = (hash * 1000003) ^ (unsigned long long)frac[i].getNumer();
+        hash = (hash * 1000003) ^ (unsigned long long)frac[i].getDeno();
+    }
+    return hash;
+}
+
+void benchmarkSort(int maxCount) //排序性能测试：规模从1000起每次乘10，直到maxCount
+{
+    //每轮重新生成数据而不保留副本，一亿个分数只占一份数组加归并缓冲区
+    printf("CPU核数: %u\n", thread::hardware_concurrency());
+    printf("%-12s %12s %14s %14s %14s\n", "规模", "冒泡(ms)", "串行(ms)", "升序(ms)", "降序(ms)");
+    vector<Fraction> work;
+    for (long long n = 1000; n <= maxCount; n *= 10)
+    {
+        char bubble[32] = "-";
+        if (n <= 10000) //冒泡排序在更大规模上耗时过长
+        {
+            fillRandomFractions(work, n);
+            auto start = chrono::steady_clock::now();
+            bubbleSortFraction(work.data(), (int)n);
+            snprintf(bubble, sizeof(bubble), "%.1f", elapsedMs(start));
+        }
+
+        fillRandomFractions(work, n);
+        auto start = chrono::steady_clock::now();
+        stable_sort(work.begin(), work.end(), fractionLess);
+        double serialMs = elapsedMs(start);
+        unsigned long long expected = orderHash(work);
+
+        fillRandomFractions(work, n);
+        start = chrono::steady_clock::now();
+        sortFraction1(work.data(), (int)n);
+        double ascendingMs = elapsedMs(start);
+        bool correct = orderHash(work) == expected;
+
+        fillRandomFractions(work, n);
+        start = chrono::steady_clock::now();
+        sortFraction2(work.data(), (int)n);
+        double descendingMs = elapsedMs(start);
+        correct = correct && is_sorted(work.begin(), work.end(), fractionGreater);
+
+        printf("%-12lld %12s %14.1f %14.1f %14.1f%s\n", n, bubble, serialMs, ascendingMs, descendingMs,
+               correct ? "" : "  结果错误!");
+    }
+}
+
+void benchmarkArithmetic(int count) //运算性能测试：小值快速路径的耗时，以及长链计算的精确性
+{
+    //小值：分子分母在±1000以内，结果都放得进long long，不应创建任何大数
+    mt19937 rng(1);
+    uniform_int_distribution<int> numerDist(-1000, 1000);
+    uniform_int_distribution<int> denoDist(1, 1000);
+    vector<Fraction> frac(1024);
+    for (size_t i = 0; i < frac.size(); i++)
+    {
+        int numer = numerDist(rng);
+        frac[i].setFraction(numer, denoDist(rng));
+    }
+    const char* names[] = {"加法", "乘法", "比较"};
+    printf("%-8s %12s %12s\n", "运算", "ns/次", "大数个数");
+    for (int kind = 0; kind < 3; kind++)
+    {
+        long long before = Fraction::bigAllocations();
+        volatile long long sink = 0; //防止循环被优化掉
+        auto start = chrono::steady_clock::now();
+        for (int i = 0; i < count; i++)
+        {
+            const Fraction& a = frac[i & 1023];
+            const Fraction& b = frac[(i * 7 + 3) & 1023];
+            if (kind == 0)
+            {
+                sink += (a + b).getDeno();
+            }
+            else if (kind == 1)
+            {
+                sink += (a * b).getDeno();
+            }
+            else
+            {
+                sink += compareFraction(a, b);
+            }
+        }
+        double ns = elapsedMs(start) * 1e6 / count;
+        printf("%-8s %12.1f %12lld\n", names[kind], ns, Fraction::bigAllocations() - before);
+    }
+
+    //长链：调和级数H(n)=1/1+1/2+...+1/n，正序和倒序累加的结果必须完全相同
+    const int terms = 1000;
+    auto start = chrono::steady_clock::now();
+    Fraction forward, backward;
+    int promoteAt = 0;
+    for (int k = 1; k <= terms; k++)
+    {
+        forward = forward + Fraction(1, k);
+        if (promoteAt == 0 && forward.isBig())
+        {
+            promoteAt = k;
+        }
+    }
+    for (int k = terms; k >= 1; k--)
+    {
+        backward = backward + Fraction(1, k);
+    }
+    double chainMs = elapsedMs(start);
+    printf("H(%d): 第%d项起转为大数, 分子%zu位, 分母%zu位, 正序倒序%s, 耗时%.1fms\n", terms, promoteAt,
+           forward.getBigNumer().toString().size(), forward.getBigDeno().toString().size(),
+           forward == backward ? "一致" : "不一致!", chainMs);
+}
+
 int main()
 {
     while (true)
     {
-        cout << "请选择功能：(键入1或者2)" << endl;
+        cout << "请选择功能：(键入1、2、3或者4)" << endl;
         cout << "1.分数计算" << endl;
         cout << "2.分数排序" << endl;
+        cout << "3.排序性能测试" << endl;
+        cout << "4.运算性能测试" << endl;
         cout << "——" << endl;
         int choice;
         cin >> choice;
@@ -199,9 +948,9 @@ int main()
                 {
                     break;
                 }
-                int numer1 = -1, deno1 = -1, numer2 = -1, deno2 = -1;
+                long long numer1 = -1, deno1 = -1, numer2 = -1, deno2 = -1;
                 char op;
-                sscanf(str.c_str(), "%d/%d%c%d/%d", &numer1, &deno1, &op, &numer2, &deno2);
+                sscanf(str.c_str(), "%lld/%lld%c%lld/%lld", &numer1, &deno1, &op, &numer2, &deno2);
                 if (numer1 == -1 || deno1 == -1 || numer2 == -1 || deno2 == -1)
                 {
                     cout << "输入错误!" << endl;
@@ -250,8 +999,8 @@ int main()
                 vector<Fraction> frac;
                 for (size_t i = 0; i < strs.size(); i++)
                 {
-                    int numer = -1, deno = -1;
-                    sscanf(strs[i].c_str(), "%d/%d", &numer, &deno);
+                    long long numer = -1, deno = -1;
+                    sscanf(strs[i].c_str(), "%lld/%lld", &numer, &deno);
                     if (numer == -1 || deno == -1)
                     {
                         cout << "输入错误!" << endl;
@@ -273,6 +1022,32 @@ int main()
                 cout << endl;
             }
         }
+        else if (choice == 3)
+        {
+            cout << "请输入最大规模(如100000000):" << endl;
+            int maxCount = 0;
+            cin >> maxCount;
+            cin.ignore();
+            if (maxCount < 1000)
+            {
+                cout << "输入错误!" << endl;
+                continue;
+            }
+            benchmarkSort(maxCount);
+        }
+        else if (choice == 4)
+        {
+            cout << "请输入每种运算的次数(如10000000):" << endl;
+            int count = 0;
+            cin >> count;
+            cin.ignore();
+            if (count < 1)
+            {
+                cout << "输入错误!" << endl;
+                continue;
+            }
+            benchmarkArithmetic(count);
+        }
         else
         {
             cout << "输入错误，请重新选择！" << endl;